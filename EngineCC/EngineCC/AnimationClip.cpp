@@ -0,0 +1,326 @@
+#include <cmath>
+#include <algorithm>
+
+#include "AnimationClip.h"
+#include "Trace.h"
+
+namespace {
+	// Maximum errors introduced by the removal of the keys
+	const float translation_tolerance = 1e-3f;
+	// Radians
+	const float rotation_tolerance = 1e-3f;
+	const float scaling_tolerance = 1e-4f;
+
+	// Ticks per second of the animations that do not specify it (assimp convention)
+	const float default_ticks_per_second = 25.f;
+
+	const float sqrt2 = 1.41421356f;
+	const uint64_t max_rotation_component = (1 << 15) - 1;
+	const float max_vector_component = 65535.f;
+
+	float vectorError(const aiVector3D& a, const aiVector3D& b) {
+		return std::max(std::fabs(a.x - b.x), std::max(std::fabs(a.y - b.y), std::fabs(a.z - b.z)));
+	}
+
+	aiVector3D lerpVector(const aiVector3D& a, const aiVector3D& b, float factor) {
+		return a * (1.f - factor) + b * factor;
+	}
+
+	// Angle between two rotations
+	float rotationError(const aiQuaternion& a, const aiQuaternion& b) {
+		float dot = std::fabs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+		return 2.f * std::acos(std::min(dot, 1.f));
+	}
+
+	aiQuaternion slerp(const aiQuaternion& a, const aiQuaternion& b, float factor) {
+		aiQuaternion result;
+		aiQuaternion::Interpolate(result, a, b, factor);
+		return result;
+	}
+
+	// Indexes of the keys to keep. A key is removed when the interpolation of the kept keys around it is within the tolerance
+	// of all the removed keys in between. A track whose keys are all equal keeps its first key
+	template<typename T, typename Lerp, typename Error>
+	std::vector<unsigned int> reduceKeys(const std::vector<float>& times, const std::vector<T>& values, float tolerance, Lerp lerp, Error error) {
+		std::vector<unsigned int> kept;
+		unsigned int num_keys = static_cast<unsigned int>(values.size());
+		if (num_keys == 0)
+			return kept;
+
+		kept.push_back(0);
+		for (unsigned int i = 1; i + 1 < num_keys; ++i) {
+			unsigned int first = kept.back();
+			float span = times[i + 1] - times[first];
+			bool removable = true;
+			for (unsigned int j = first + 1; j <= i && removable; ++j) {
+				float factor = (span > 0.f) ? (times[j] - times[first]) / span : 0.f;
+				removable = error(lerp(values[first], values[i + 1], factor), values[j]) <= tolerance;
+			}
+			if (!removable)
+				kept.push_back(i);
+		}
+		if (num_keys > 1)
+			kept.push_back(num_keys - 1);
+
+		if (kept.size() == 2 && error(values[kept[0]], values[kept[1]]) <= tolerance)
+			kept.pop_back();
+		return kept;
+	}
+}
+
+/// AnimationClip definitions
+AnimationClip::AnimationClip(const aiAnimation& animation) {
+	TRACE_SCOPE("AnimationClip::AnimationClip");
+	float ticks_per_second = (animation.mTicksPerSecond != 0.0) ? static_cast<float>(animation.mTicksPerSecond) : default_ticks_per_second;
+	m_duration = static_cast<float>(animation.mDuration) / ticks_per_second;
+
+	m_channels.resize(animation.mNumChannels);
+	for (unsigned int i = 0; i < animation.mNumChannels; ++i) {
+		const aiNodeAnim* node_animation = animation.mChannels[i];
+		Channel& channel = m_channels[i];
+		channel.node_name = node_animation->mNodeName.C_Str();
+		buildTrack(node_animation->mPositionKeys, node_animation->mNumPositionKeys, ticks_per_second, translation_tolerance, channel.translation);
+		buildTrack(node_animation->mRotationKeys, node_animation->mNumRotationKeys, ticks_per_second, rotation_tolerance, channel.rotation);
+		buildTrack(node_animation->mScalingKeys, node_animation->mNumScalingKeys, ticks_per_second, scaling_tolerance, channel.scaling);
+	}
+}
+
+AnimationClip::AnimationClip() : m_duration(0.f) {
+}
+
+AnimationClip::~AnimationClip() {
+}
+
+void AnimationClip::write(BinaryWriter& writer) const {
+	writer.writeValue(m_duration);
+	writer.writeValue<uint32_t>(static_cast<uint32_t>(m_channels.size()));
+	for (const Channel& channel : m_channels) {
+		writer.writeString(channel.node_name);
+		writeTrack(writer, channel.translation);
+		writeTrack(writer, channel.rotation);
+		writeTrack(writer, channel.scaling);
+	}
+}
+
+bool AnimationClip::read(BinaryReader& reader) {
+	uint32_t num_channels = 0;
+	if (!reader.readValue(m_duration) || !reader.readValue(num_channels))
+		return false;
+
+	m_channels.clear();
+	m_channels.reserve(num_channels);
+	for (uint32_t i = 0; i < num_channels; ++i) {
+		Channel channel;
+		if (!reader.readString(channel.node_name) || !readTrack(reader, channel.translation) ||
+			!readTrack(reader, channel.rotation) || !readTrack(reader, channel.scaling))
+			return false;
+		m_channels.push_back(channel);
+	}
+	return true;
+}
+
+float AnimationClip::getDuration() const {
+	return m_duration;
+}
+
+unsigned int AnimationClip::getNumChannels() const {
+	return static_cast<unsigned int>(m_channels.size());
+}
+
+int AnimationClip::findChannel(const char* node_name) const {
+	for (unsigned int i = 0; i < m_channels.size(); ++i) {
+		if (m_channels[i].node_name == node_name)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+
+void AnimationClip::resetCursor(Cursor& cursor) const {
+	cursor.keys.assign(3 * m_channels.size(), 0);
+}
+
+aiMatrix4x4 AnimationClip::sample(unsigned int channel_index, float time, Cursor& cursor) const {
+	const Channel& channel = m_channels[channel_index];
+	uint32_t* keys = &cursor.keys[3 * channel_index];
+
+	aiVector3D translation(0.f, 0.f, 0.f);
+	if (!channel.translation.values.empty()) {
+		const VectorTrack& track = channel.translation;
+		float factor = seek(track.times, time, keys[0]);
+		uint32_t next = std::min<uint32_t>(keys[0] + 1, static_cast<uint32_t>(track.values.size()) - 1);
+		translation = lerpVector(unpack(track.values[keys[0]], track.min, track.extent),
+								 unpack(track.values[next], track.min, track.extent),
+								 factor);
+	}
+
+	aiQuaternion rotation;
+	if (!channel.rotation.values.empty()) {
+		const RotationTrack& track = channel.rotation;
+		float factor = seek(track.times, time, keys[1]);
+		uint32_t next = std::min<uint32_t>(keys[1] + 1, static_cast<uint32_t>(track.values.size()) - 1);
+		rotation = slerp(unpack(track.values[keys[1]]), unpack(track.values[next]), factor);
+	}
+
+	aiVector3D scaling(1.f, 1.f, 1.f);
+	if (!channel.scaling.values.empty()) {
+		const VectorTrack& track = channel.scaling;
+		float factor = seek(track.times, time, keys[2]);
+		uint32_t next = std::min<uint32_t>(keys[2] + 1, static_cast<uint32_t>(track.values.size()) - 1);
+		scaling = lerpVector(unpack(track.values[keys[2]], track.min, track.extent),
+							 unpack(track.values[next], track.min, track.extent),
+							 factor);
+	}
+
+	// Translation * rotation * scaling
+	return aiMatrix4x4(scaling, rotation, translation);
+}
+
+size_t AnimationClip::getMemorySize() const {
+	size_t size = sizeof(AnimationClip) + m_channels.size() * sizeof(Channel);
+	for (const Channel& channel : m_channels) {
+		size += channel.node_name.size();
+		size += channel.translation.times.size() * (sizeof(float) + sizeof(PackedVector));
+		size += channel.rotation.times.size() * (sizeof(float) + sizeof(PackedQuaternion));
+		size += channel.scaling.times.size() * (sizeof(float) + sizeof(PackedVector));
+	}
+	return size;
+}
+
+void AnimationClip::writeTrack(BinaryWriter& writer, const VectorTrack& track) {
+	writer.writeArray(track.times);
+	writer.writeArray(track.values);
+	writer.writeValue(track.min);
+	writer.writeValue(track.extent);
+}
+
+void AnimationClip::writeTrack(BinaryWriter& writer, const RotationTrack& track) {
+	writer.writeArray(track.times);
+	writer.writeArray(track.values);
+}
+
+bool AnimationClip::readTrack(BinaryReader& reader, VectorTrack& track) {
+	return reader.readArray(track.times) && reader.readArray(track.values) &&
+		reader.readValue(track.min) && reader.readValue(track.extent) && track.times.size() == track.values.size();
+}
+
+bool AnimationClip::readTrack(BinaryReader& reader, RotationTrack& track) {
+	return reader.readArray(track.times) && reader.readArray(track.values) && track.times.size() == track.values.size();
+}
+
+float AnimationClip::seek(const std::vector<float>& times, float time, uint32_t& key) {
+	// The animation looped or went backward
+	if (key >= times.size() || times[key] > time)
+		key = 0;
+	while (key + 1 < times.size() && times[key + 1] <= time)
+		key++;
+
+	if (key + 1 >= times.size())
+		return 0.f;
+	float span = times[key + 1] - times[key];
+	return (span > 0.f) ? std::min(std::max((time - times[key]) / span, 0.f), 1.f) : 0.f;
+}
+
+AnimationClip::PackedQuaternion AnimationClip::pack(const aiQuaternion& rotation) {
+	aiQuaternion normalized = rotation;
+	normalized.Normalize();
+	float components[4] = { normalized.x, normalized.y, normalized.z, normalized.w };
+
+	unsigned int largest = 0;
+	for (unsigned int i = 1; i < 4; ++i) {
+		if (std::fabs(components[i]) > std::fabs(components[largest]))
+			largest = i;
+	}
+	// q and -q are the same rotation, the dropped component is made positive
+	float sign = (components[largest] < 0.f) ? -1.f : 1.f;
+
+	uint64_t bits = largest;
+	for (unsigned int i = 0; i < 4; ++i) {
+		if (i == largest)
+			continue;
+		float value = (sign * components[i] * sqrt2) * 0.5f + 0.5f;
+		uint64_t quantized = static_cast<uint64_t>(std::min(std::max(value, 0.f), 1.f) * max_rotation_component + 0.5f);
+		bits = (bits << 15) | quantized;
+	}
+
+	PackedQuaternion packed;
+	packed.data[0] = static_cast<uint16_t>(bits >> 32);
+	packed.data[1] = static_cast<uint16_t>(bits >> 16);
+	packed.data[2] = static_cast<uint16_t>(bits);
+	return packed;
+}
+
+aiQuaternion AnimationClip::unpack(const PackedQuaternion& packed) {
+	uint64_t bits = (static_cast<uint64_t>(packed.data[0]) << 32) | (static_cast<uint64_t>(packed.data[1]) << 16) | packed.data[2];
+	unsigned int largest = static_cast<unsigned int>(bits >> 45) & 3;
+
+	// The last component packed is in the lowest bits
+	float components[4];
+	float sum_squares = 0.f;
+	for (int i = 3; i >= 0; --i) {
+		if (i == static_cast<int>(largest))
+			continue;
+		float value = static_cast<float>(bits & max_rotation_component) / max_rotation_component;
+		components[i] = (value * 2.f - 1.f) / sqrt2;
+		sum_squares += components[i] * components[i];
+		bits >>= 15;
+	}
+	components[largest] = std::sqrt(std::max(1.f - sum_squares, 0.f));
+
+	return aiQuaternion(components[3], components[0], components[1], components[2]);
+}
+
+AnimationClip::PackedVector AnimationClip::pack(const aiVector3D& value, const aiVector3D& min, const aiVector3D& extent) {
+	PackedVector packed;
+	for (unsigned int i = 0; i < 3; ++i) {
+		float normalized = (extent[i] > 0.f) ? (value[i] - min[i]) / extent[i] : 0.f;
+		packed.data[i] = static_cast<uint16_t>(std::min(std::max(normalized, 0.f), 1.f) * max_vector_component + 0.5f);
+	}
+	return packed;
+}
+
+aiVector3D AnimationClip::unpack(const PackedVector& packed, const aiVector3D& min, const aiVector3D& extent) {
+	return aiVector3D(min.x + extent.x * (packed.data[0] / max_vector_component),
+					  min.y + extent.y * (packed.data[1] / max_vector_component),
+					  min.z + extent.z * (packed.data[2] / max_vector_component));
+}
+
+void AnimationClip::buildTrack(const aiVectorKey* keys, unsigned int num_keys, float ticks_per_second, float tolerance, VectorTrack& track) {
+	std::vector<float> times(num_keys);
+	std::vector<aiVector3D> values(num_keys);
+	for (unsigned int i = 0; i < num_keys; ++i) {
+		times[i] = static_cast<float>(keys[i].mTime) / ticks_per_second;
+		values[i] = keys[i].mValue;
+	}
+
+	const std::vector<unsigned int>& kept = reduceKeys(times, values, tolerance, lerpVector, vectorError);
+	if (kept.empty())
+		return;
+
+	aiVector3D max = values[kept[0]];
+	track.min = values[kept[0]];
+	for (unsigned int i : kept) {
+		track.min = aiVector3D(std::min(track.min.x, values[i].x), std::min(track.min.y, values[i].y), std::min(track.min.z, values[i].z));
+		max = aiVector3D(std::max(max.x, values[i].x), std::max(max.y, values[i].y), std::max(max.z, values[i].z));
+	}
+	track.extent = max - track.min;
+
+	for (unsigned int i : kept) {
+		track.times.push_back(times[i]);
+		track.values.push_back(pack(values[i], track.min, track.extent));
+	}
+}
+
+void AnimationClip::buildTrack(const aiQuatKey* keys, unsigned int num_keys, float ticks_per_second, float tolerance, RotationTrack& track) {
+	std::vector<float> times(num_keys);
+	std::vector<aiQuaternion> values(num_keys);
+	for (unsigned int i = 0; i < num_keys; ++i) {
+		times[i] = static_cast<float>(keys[i].mTime) / ticks_per_second;
+		values[i] = keys[i].mValue;
+	}
+
+	const std::vector<unsigned int>& kept = reduceKeys(times, values, tolerance, slerp, rotationError);
+	for (unsigned int i : kept) {
+		track.times.push_back(times[i]);
+		track.values.push_back(pack(values[i]));
+	}
+}
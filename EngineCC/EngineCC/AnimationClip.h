@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include <assimp/anim.h>
+#include <assimp/matrix4x4.h>
+
+#include "BinaryFile.h"
+
+/// Animation in a compact runtime format, built once from an assimp animation
+// Each channel (node moved by the animation) has a translation, a rotation and a scaling track.
+// The keys that can be interpolated from their neighbours within a tolerance are removed, a constant track keeps one key.
+// The remaining values are quantized :
+//  - the rotations with the smallest three method on 48 bits : the largest component of the unit quaternion is dropped,
+//    its index is kept on 2 bits and the three others, in [-1/sqrt(2), 1/sqrt(2)], on 15 bits each
+//  - the translations and scalings on 16 bits per component, in the range of their track
+// The key times are in seconds and may not be uniformly spaced.
+// A cursor keeps the last key used by an instance for each track. The next sample starts its search from there,
+// so playing the animation forward costs O(1) per track.
+class AnimationClip {
+public:
+	struct Cursor {
+		// Index of the current key of each track, 3 tracks per channel
+		std::vector<uint32_t> keys;
+	};
+
+	AnimationClip(const aiAnimation& animation);
+	// Empty clip, filled by read
+	AnimationClip();
+	~AnimationClip();
+
+	// The compressed tracks are stored as they are in the mesh cache (see ModelData)
+	void write(BinaryWriter& writer) const;
+	// Returns false if the data is truncated
+	bool read(BinaryReader& reader);
+
+	// Seconds
+	float getDuration() const;
+	unsigned int getNumChannels() const;
+	// Index of the channel moving a node, -1 if it is not animated
+	int findChannel(const char* node_name) const;
+
+	void resetCursor(Cursor& cursor) const;
+	// Local transform of the node of a channel at time, in [0, duration]
+	aiMatrix4x4 sample(unsigned int channel, float time, Cursor& cursor) const;
+
+	// Bytes used by the tracks
+	size_t getMemorySize() const;
+
+private:
+	struct PackedQuaternion {
+		uint16_t data[3];
+	};
+
+	struct PackedVector {
+		uint16_t data[3];
+	};
+
+	struct VectorTrack {
+		std::vector<float> times;
+		std::vector<PackedVector> values;
+		// Quantization range
+		aiVector3D min;
+		aiVector3D extent;
+	};
+
+	struct RotationTrack {
+		std::vector<float> times;
+		std::vector<PackedQuaternion> values;
+	};
+
+	struct Channel {
+		std::string node_name;
+		VectorTrack translation;
+		RotationTrack rotation;
+		VectorTrack scaling;
+	};
+
+	static PackedQuaternion pack(const aiQuaternion& rotation);
+	static aiQuaternion unpack(const PackedQuaternion& packed);
+	static PackedVector pack(const aiVector3D& value, const aiVector3D& min, const aiVector3D& extent);
+	static aiVector3D unpack(const PackedVector& packed, const aiVector3D& min, const aiVector3D& extent);
+
+	static void buildTrack(const aiVectorKey* keys, unsigned int num_keys, float ticks_per_second, float tolerance, VectorTrack& track);
+	static void buildTrack(const aiQuatKey* keys, unsigned int num_keys, float ticks_per_second, float tolerance, RotationTrack& track);
+
+	static void writeTrack(BinaryWriter& writer, const VectorTrack& track);
+	static void writeTrack(BinaryWriter& writer, const RotationTrack& track);
+	static bool readTrack(BinaryReader& reader, VectorTrack& track);
+	static bool readTrack(BinaryReader& reader, RotationTrack& track);
+
+	// Move the cursor to the last key before time and return the interpolation factor with the next key
+	static float seek(const std::vector<float>& times, float time, uint32_t& key);
+
+private:
+	float m_duration;
+	std::vector<Channel> m_channels;
+};
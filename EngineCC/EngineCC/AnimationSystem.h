@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
+
+#include <entityx/entityx.h>
+
+#include "Components.h"
+#include "Model.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+#include "Trace.h"
+
+// Rate at which the times of the animations are quantized to share the poses between the instances
+#define ANIMATION_SAMPLE_RATE 60.f
+
+/// AnimationSystem definition
+// Advances the animations of the animated models by the time step of the systems, and evaluates their poses
+// on the worker threads into one contiguous palette of bones transforms. The models that play the same clip at the
+// same quantized time share one evaluation. The renderables only read the palettes when they are submitted,
+// the system must be updated before the RenderSystem.
+class AnimationSystem : public entityx::System<AnimationSystem> {
+public:
+	AnimationSystem() : m_workers(WorkerPool::getShared()) {
+	}
+	~AnimationSystem() {
+	}
+
+	void update(entityx::EntityManager &es, entityx::EventManager &events, entityx::TimeDelta dt) override {
+		TRACE_SCOPE("AnimationSystem::update");
+		m_instances.clear();
+		m_poses.clear();
+		m_pose_indexes.clear();
+
+		// Group the models by clip and quantized time
+		unsigned int num_bones = 0;
+		es.each<Render>([this, dt, &num_bones](entityx::Entity entity, Render& render) {
+			Model* model = dynamic_cast<Model*>(&render->getPrimitive());
+			if (!model || !model->isAnimated())
+				return;
+
+			model->advance(static_cast<float>(dt));
+			uint32_t quantized_time = static_cast<uint32_t>(std::floor(model->getTime() * ANIMATION_SAMPLE_RATE));
+			PoseKey key(model->m_data.get(), quantized_time);
+
+			std::pair<std::unordered_map<PoseKey, uint32_t, PoseKeyHash>::iterator, bool> pose =
+				m_pose_indexes.emplace(key, static_cast<uint32_t>(m_poses.size()));
+			if (pose.second) {
+				Pose new_pose;
+				new_pose.model = model;
+				new_pose.time = quantized_time / ANIMATION_SAMPLE_RATE;
+				new_pose.first_bone = num_bones;
+				m_poses.push_back(new_pose);
+				num_bones += model->getNumBones();
+			}
+
+			Instance instance;
+			instance.model = model;
+			instance.pose = pose.first->second;
+			m_instances.push_back(instance);
+		});
+
+		// Each pose writes its own range of the palette
+		m_palette.resize(num_bones);
+		m_workers.parallelFor(m_poses.size(), 4, [this](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const Pose& pose = m_poses[i];
+				pose.model->evaluatePose(pose.time, m_palette.data() + pose.first_bone);
+			}
+		});
+
+		for (const Instance& instance : m_instances) {
+			instance.model->setPalette(m_palette.data() + m_poses[instance.pose].first_bone);
+		}
+
+		PROFILE_COUNTER("animated", m_instances.size());
+		PROFILE_COUNTER("poses", m_poses.size());
+	}
+
+private:
+	// Clip (shared data of the model file) and quantized time
+	typedef std::pair<const ModelData*, uint32_t> PoseKey;
+	struct PoseKeyHash {
+		size_t operator()(const PoseKey& key) const {
+			return std::hash<const ModelData*>()(key.first) ^ (std::hash<uint32_t>()(key.second) * 31);
+		}
+	};
+
+	struct Pose {
+		// Model evaluating the pose, its cursor follows the time of the pose
+		Model* model;
+		float time;
+		uint32_t first_bone;
+	};
+
+	struct Instance {
+		Model* model;
+		uint32_t pose;
+	};
+
+	std::vector<Instance> m_instances;
+	std::vector<Pose> m_poses;
+	std::unordered_map<PoseKey, uint32_t, PoseKeyHash> m_pose_indexes;
+
+	// Bones transforms of all the poses of the frame, read by the models until the next update
+	std::vector<aiMatrix4x4> m_palette;
+
+	// The game and the editor each have their system, both use the pool of the engine
+	WorkerPool& m_workers;
+};
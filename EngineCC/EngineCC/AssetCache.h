@@ -0,0 +1,85 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <cctype>
+
+/// Cache of the immutable assets shared between the renderables (geometries, textures, models)
+// Only weak references are kept : an asset is released with the last renderable using it
+// and is loaded again the next time it is requested.
+template<typename K, typename T>
+class AssetCache {
+public:
+	static AssetCache<K, T>& getInstance();
+
+	// Return the asset of the key if it is still alive, otherwise create it with load
+	template<typename Loader>
+	std::shared_ptr<T> get(const K& key, Loader load);
+
+	bool isThereAsset(const K& key) const;
+	void clear();
+
+private:
+	AssetCache();
+	~AssetCache();
+
+	static AssetCache<K, T> m_cache;
+
+	std::map<K, std::weak_ptr<T>> m_assets;
+};
+
+template<typename K, typename T>
+AssetCache<K, T> AssetCache<K, T>::m_cache = AssetCache<K, T>();
+
+template<typename K, typename T>
+AssetCache<K, T>::AssetCache() {}
+template<typename K, typename T>
+AssetCache<K, T>::~AssetCache() {}
+
+template<typename K, typename T>
+AssetCache<K, T>& AssetCache<K, T>::getInstance() {
+	return m_cache;
+}
+
+template<typename K, typename T>
+template<typename Loader>
+std::shared_ptr<T> AssetCache<K, T>::get(const K& key, Loader load) {
+	typename std::map<K, std::weak_ptr<T>>::iterator it = m_assets.find(key);
+	if (it != m_assets.end()) {
+		if (std::shared_ptr<T> asset = it->second.lock())
+			return asset;
+	}
+
+	std::shared_ptr<T> asset = load();
+	m_assets[key] = asset;
+	return asset;
+}
+
+template<typename K, typename T>
+bool AssetCache<K, T>::isThereAsset(const K& key) const {
+	typename std::map<K, std::weak_ptr<T>>::const_iterator it = m_assets.find(key);
+	return (it != m_assets.end() && !it->second.expired());
+}
+
+template<typename K, typename T>
+void AssetCache<K, T>::clear() {
+	m_assets.clear();
+}
+
+// Key of a file in the caches. The same file can be given with different separators or cases on Windows
+inline std::string getCanonicalPath(const std::string& path) {
+	std::string canonical = path;
+	std::replace(canonical.begin(), canonical.end(), '\\', '/');
+	std::transform(canonical.begin(), canonical.end(), canonical.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+
+	// Remove the "./" directories
+	size_t pos;
+	while ((pos = canonical.find("/./")) != std::string::npos)
+		canonical.erase(pos, 2);
+	while (canonical.compare(0, 2, "./") == 0)
+		canonical.erase(0, 2);
+	return canonical;
+}
@@ -0,0 +1,195 @@
+#include <chrono>
+#include <cstring>
+
+#include "AssetLoader.h"
+#include "Trace.h"
+
+/// AssetLoader definitions
+AssetLoader& AssetLoader::getInstance() {
+	static AssetLoader loader;
+	return loader;
+}
+
+AssetLoader::AssetLoader() : m_num_pending(0),
+							 m_num_decoding(0),
+							 m_stopped(false),
+							 m_synchronous(false),
+							 m_staging_buffer(0),
+							 m_workers(WorkerPool::getShared()) {
+}
+
+AssetLoader::~AssetLoader() {
+	// The pool is shared and outlives the loader, the decodes still running are waited for.
+	// The jobs and the staging buffer have been released by shutdown
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_stopped = true;
+	m_condition.wait(lock, [this]() { return m_num_decoding == 0; });
+}
+
+std::shared_ptr<AssetLoader::Job> AssetLoader::load(const std::function<void()>& decode, const std::function<bool()>& upload) {
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->decode = decode;
+	job->upload = upload;
+	job->decoded = false;
+	job->uploaded = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// The asset keeps its placeholder
+		if (m_stopped) {
+			job->decode = nullptr;
+			job->upload = nullptr;
+			job->decoded = true;
+			job->uploaded = true;
+			return job;
+		}
+		m_num_pending++;
+		if (!m_synchronous)
+			m_num_decoding++;
+	}
+
+	if (m_synchronous) {
+		{
+			TRACE_SCOPE("AssetLoader::decode");
+			job->decode();
+		}
+		job->decoded = true;
+		// The parameter hides the member function
+		while (!this->upload(*job)) {
+		}
+		return job;
+	}
+
+	m_workers.submit([this, job]() {
+		bool stopped;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			stopped = m_stopped;
+		}
+		if (!stopped) {
+			TRACE_SCOPE("AssetLoader::decode");
+			job->decode();
+		}
+		// Even skipped, the job goes back to the main thread which releases its captures
+		// Notified under the lock, the loader can be destroyed as soon as the lock is released
+		std::lock_guard<std::mutex> lock(m_mutex);
+		job->decoded = true;
+		m_decoded.push_back(job);
+		m_num_decoding--;
+		m_condition.notify_all();
+	});
+	return job;
+}
+
+bool AssetLoader::upload(Job& job) {
+	TRACE_SCOPE("AssetLoader::upload");
+	if (!job.upload())
+		return false;
+
+	job.uploaded = true;
+	// The captures of the decode and upload steps may hold large data
+	job.decode = nullptr;
+	job.upload = nullptr;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_num_pending--;
+	return true;
+}
+
+void AssetLoader::update(float budget_ms) {
+	TRACE_SCOPE("AssetLoader::update");
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	while (true) {
+		std::shared_ptr<Job> job;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stopped || m_decoded.empty())
+				return;
+			job = m_decoded.front();
+			m_decoded.pop_front();
+		}
+
+		// The job may have been finished earlier
+		while (!job->uploaded && !upload(*job)) {
+			float elapsed_ms = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(std::chrono::high_resolution_clock::now() - start).count();
+			if (elapsed_ms >= budget_ms) {
+				// Continued first the next frame
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_decoded.push_front(job);
+				return;
+			}
+		}
+
+		float elapsed_ms = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(std::chrono::high_resolution_clock::now() - start).count();
+		if (elapsed_ms >= budget_ms)
+			return;
+	}
+}
+
+void AssetLoader::finish(const std::shared_ptr<Job>& job) {
+	if (!job || job->uploaded)
+		return;
+
+	{
+		TRACE_SCOPE("AssetLoader::wait");
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [&job]() { return job->decoded; });
+		if (m_stopped)
+			return;
+	}
+	// The job stays in the queue of the decoded ones, update skips it
+	while (!upload(*job)) {
+	}
+}
+
+void AssetLoader::shutdown() {
+	TRACE_SCOPE("AssetLoader::shutdown");
+	std::deque<std::shared_ptr<Job>> decoded;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopped = true;
+		m_condition.wait(lock, [this]() { return m_num_decoding == 0; });
+		decoded.swap(m_decoded);
+		m_num_pending = 0;
+	}
+
+	// The captures are released here, on the main thread with the context current. The jobs kept by their assets
+	// (e.g. ModelData::m_job) would otherwise keep their captures, and the assets, alive
+	for (const std::shared_ptr<Job>& job : decoded) {
+		job->uploaded = true;
+		job->decode = nullptr;
+		job->upload = nullptr;
+	}
+	decoded.clear();
+
+	if (m_staging_buffer != 0) {
+		glDeleteBuffers(1, &m_staging_buffer);
+		m_staging_buffer = 0;
+	}
+}
+
+void AssetLoader::setSynchronous(bool synchronous) {
+	m_synchronous = synchronous;
+}
+
+size_t AssetLoader::getNumPending() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_num_pending;
+}
+
+void AssetLoader::beginPixelUpload(const void* data, size_t size) {
+	if (m_staging_buffer == 0)
+		glCreateBuffers(1, &m_staging_buffer);
+
+	// The buffer is orphaned so that the copies of the previous uploads still in flight are not waited for
+	glNamedBufferData(m_staging_buffer, size, NULL, GL_STREAM_DRAW);
+	void* staging = glMapNamedBufferRange(m_staging_buffer, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	std::memcpy(staging, data, size);
+	glUnmapNamedBuffer(m_staging_buffer);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_staging_buffer);
+}
+
+void AssetLoader::endPixelUpload() {
+	// The other uploads read their pixels from the client memory
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+#include "Dependencies\glew\glew.h"
+
+#include "WorkerPool.h"
+
+// Time given to the uploads of the loaded assets in a frame
+#define ASSET_UPLOAD_BUDGET_MS 2.f
+// Most bytes staged by one step of an upload, about a tenth of the budget
+#define ASSET_UPLOAD_STEP_BYTES (1024 * 1024)
+
+/// Asynchronous loading of the assets
+// An asset is loaded in two steps :
+//  - decode : file reading, parsing and conversion, run on the worker threads. It must not use OpenGL nor the asset caches
+//  - upload : creation of the OpenGL objects from the decoded data, run on the main thread by update. It is split in short steps
+//    (a mesh, a band of rows of a texture level) : upload returns false while steps remain and is called again
+// update is called once per frame and runs the upload steps of the decoded assets until the budget of the frame is spent,
+// a large asset is continued the next frames. Until then, the assets are drawn with placeholders (see the textures and the models).
+// The pixels of the textures are uploaded from a pixel buffer object, the driver copies them without stalling the frame.
+class AssetLoader {
+public:
+	struct Job {
+		std::function<void()> decode;
+		// Returns true once the asset is complete
+		std::function<bool()> upload;
+		// Set by the worker once decode has returned, guarded by the mutex of the loader
+		bool decoded;
+		// Main thread only
+		bool uploaded;
+	};
+
+	static AssetLoader& getInstance();
+
+	// Decode on a worker thread then upload on the main thread. The job can be finished earlier with finish
+	std::shared_ptr<Job> load(const std::function<void()>& decode, const std::function<bool()>& upload);
+	// Run the upload steps of the decoded assets for about budget_ms milliseconds, at least one step is run
+	void update(float budget_ms);
+	// Wait for the decode of the job and run all its upload steps now, used when an asset is needed immediately
+	void finish(const std::shared_ptr<Job>& job);
+
+	// Number of jobs not uploaded yet
+	size_t getNumPending() const;
+
+	// When set, load decodes and uploads the asset before returning. A replayed session must not depend on the time the loads take
+	// (e.g. the physics of a model is added once it is loaded), its assets are loaded synchronously
+	void setSynchronous(bool synchronous);
+
+	// Wait for the decodes running on the workers, drop the jobs not uploaded and delete the staging buffer.
+	// Called before the GL context is deleted : the captures of the jobs may own GL objects (e.g. the placeholder of a texture).
+	// The decodes not started yet are skipped, the loader does not load anything afterwards
+	void shutdown();
+
+	// Copy data in the staging pixel buffer and bind it to GL_PIXEL_UNPACK_BUFFER. The pixels given to
+	// glTexSubImage2D are then offsets in the staging buffer, until endPixelUpload unbinds it.
+	// The size is bounded by ASSET_UPLOAD_STEP_BYTES, the copy fits in the step
+	void beginPixelUpload(const void* data, size_t size);
+	void endPixelUpload();
+
+private:
+	AssetLoader();
+	~AssetLoader();
+
+	// Run the next step of the upload of the job, true once it is complete
+	bool upload(Job& job);
+
+private:
+	// Decoded jobs waiting for their upload
+	std::deque<std::shared_ptr<Job>> m_decoded;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	size_t m_num_pending;
+	// Jobs submitted to the workers and not in m_decoded yet
+	size_t m_num_decoding;
+	bool m_stopped;
+	// Main thread only
+	bool m_synchronous;
+
+	GLuint m_staging_buffer;
+
+	// Pool of the engine, created by the constructor so that it outlives the loader
+	WorkerPool& m_workers;
+};
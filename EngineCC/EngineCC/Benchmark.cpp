@@ -0,0 +1,610 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include "Dependencies\glew\glew.h"
+
+#include "Benchmark.h"
+
+#include "World.h"
+#include "Singleton.h"
+#include "Components.h"
+#include "Model.h"
+#include "BoundingBox.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "EntityHierarchy.h"
+#include "FiniteStateMachine.h"
+#include "RenderSystem.h"
+#include "Viewer.h"
+
+/// Allocation counter
+// The global operator new is replaced so that the heap allocations done while a case is measured are counted.
+// Out of the measures (the game, the editor, the setup of the cases) an allocation only checks the flag, the shared
+// counter is not touched. operator new[] and the other forms of delete forward to these ones by default.
+namespace {
+	std::atomic<bool> counting_allocations(false);
+	std::atomic<uint64_t> num_allocations(0);
+
+	// Count the allocations during its scope
+	struct AllocationCounting {
+		AllocationCounting() {
+			counting_allocations.store(true, std::memory_order_relaxed);
+		}
+		~AllocationCounting() {
+			counting_allocations.store(false, std::memory_order_relaxed);
+		}
+	};
+}
+
+void* operator new(std::size_t size) {
+	if (counting_allocations.load(std::memory_order_relaxed))
+		num_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+namespace {
+	using Clock = std::chrono::high_resolution_clock;
+
+	// Minimal duration of one sample and number of samples measured for each case
+	const double min_sample_time_ns = 20.0 * 1000.0 * 1000.0;
+	const unsigned int num_samples = 7;
+
+	double getElapsedNs(const Clock::time_point& start, const Clock::time_point& end) {
+		return std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start).count();
+	}
+
+	// Static rigid body whose collision shape is a unit box
+	Physics createBoxPhysics(const btVector3& origin) {
+		btBoxShape* shape = new btBoxShape(btVector3(0.5f, 0.5f, 0.5f));
+
+		btTransform tr;
+		tr.setIdentity();
+		tr.setOrigin(origin);
+
+		btVector3 local_inertia(0, 0, 0);
+		btDefaultMotionState* motion_state = new btDefaultMotionState(tr);
+		btRigidBody::btRigidBodyConstructionInfo info(0.f, motion_state, shape, local_inertia);
+		btRigidBody* body = new btRigidBody(info);
+
+		Physics physics = { shape, motion_state, body, 0.f, local_inertia };
+		return physics;
+	}
+
+	void deletePhysics(Physics& physics) {
+		delete physics.rigid_body;
+		delete physics.motion_state;
+		delete physics.collision_shape;
+	}
+
+	// The model benchmark needs an OpenGL context to load its buffers and textures.
+	// A hidden window is created once for the whole run.
+	bool createHiddenContext() {
+		static bool created = false;
+		if (created)
+			return true;
+
+		if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+			std::cout << "Unable to initialize SDL : " << SDL_GetError() << std::endl;
+			return false;
+		}
+		IMG_Init(IMG_INIT_JPG);
+
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+		SDL_Window* window = SDL_CreateWindow("EngineCC benchmark", 0, 0, 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+		if (!window) {
+			std::cout << "SDL Error: " << SDL_GetError() << std::endl;
+			return false;
+		}
+		if (!SDL_GL_CreateContext(window)) {
+			std::cout << "SDL Error: " << SDL_GetError() << std::endl;
+			return false;
+		}
+
+		glewExperimental = GL_TRUE;
+		if (glewInit() != GLEW_OK) {
+			std::cout << "Unable to initialize GLEW" << std::endl;
+			return false;
+		}
+
+		created = true;
+		return true;
+	}
+
+	// Non indexed grid of n x n quads with a noisy height, 3 vertices per triangle as imported by assimp
+	// n is chosen so that the grid has about num_triangles triangles
+	std::shared_ptr<Mesh> createNoisyGrid(unsigned int num_triangles) {
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> distribution(-0.1f, 0.1f);
+
+		unsigned int n = static_cast<unsigned int>(std::sqrt(num_triangles / 2.f));
+		std::vector<float> heights((n + 1) * (n + 1));
+		for (unsigned int i = 0; i < heights.size(); ++i) {
+			heights[i] = distribution(generator);
+		}
+
+		auto mesh = std::make_shared<Mesh>();
+		const unsigned int corners[6][2] = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 1, 0 } };
+		for (unsigned int x = 0; x < n; ++x) {
+			for (unsigned int z = 0; z < n; ++z) {
+				for (unsigned int k = 0; k < 6; ++k) {
+					unsigned int vx = x + corners[k][0];
+					unsigned int vz = z + corners[k][1];
+					mesh->m_indexes.push_back(static_cast<GLuint>(mesh->m_vertices.size()));
+					mesh->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(vx, heights[vx * (n + 1) + vz], vz)));
+				}
+			}
+		}
+		return mesh;
+	}
+
+	/// States of the benchmarks that need to be released in a given order
+	struct HierarchyState {
+		~HierarchyState() {
+			// The hierarchy accesses the Physics components of its entities when it is deleted
+			root.reset();
+			for (unsigned int i = 0; i < physics.size(); ++i) {
+				deletePhysics(physics[i]);
+			}
+		}
+
+		entityx::EventManager events;
+		entityx::EntityManager entities{ events };
+		std::vector<Physics> physics;
+		EntityHierarchyPtr root;
+	};
+
+	struct WorldState {
+		~WorldState() {
+			// Remove the entities from the dynamic world before their manager is destroyed
+			Singleton<World>::getInstance().free();
+			for (unsigned int i = 0; i < rigid_bodies.size(); ++i) {
+				delete rigid_bodies[i];
+			}
+		}
+
+		entityx::EventManager events;
+		entityx::EntityManager entities{ events };
+		std::vector<btRigidBody*> rigid_bodies;
+	};
+}
+
+Benchmark::Benchmark() {
+	addEngineCases();
+}
+
+Benchmark::~Benchmark() {
+}
+
+void Benchmark::add(const Case& bench_case) {
+	m_cases.push_back(bench_case);
+}
+
+uint64_t Benchmark::getNumAllocations() {
+	return num_allocations.load(std::memory_order_relaxed);
+}
+
+Benchmark::Result Benchmark::measure(const std::string& name, unsigned int size, const std::function<void()>& func, unsigned int ops_per_run) const {
+	// Warm up the caches
+	func();
+
+	// Find the number of runs needed so that one sample lasts long enough for the clock resolution
+	uint64_t num_runs = 1;
+	while (true) {
+		Clock::time_point start = Clock::now();
+		for (uint64_t i = 0; i < num_runs; ++i) {
+			func();
+		}
+		if (getElapsedNs(start, Clock::now()) >= min_sample_time_ns || num_runs >= (1ull << 30))
+			break;
+		num_runs *= 2;
+	}
+
+	// The median of the samples is reported so that a preemption of the process does not spoil the result
+	std::vector<double> samples_ns_per_op;
+	samples_ns_per_op.reserve(num_samples);
+	uint64_t allocs_start, allocs_end;
+	{
+		AllocationCounting counting;
+		allocs_start = getNumAllocations();
+		for (unsigned int k = 0; k < num_samples; ++k) {
+			Clock::time_point start = Clock::now();
+			for (uint64_t i = 0; i < num_runs; ++i) {
+				func();
+			}
+			double elapsed = getElapsedNs(start, Clock::now());
+			samples_ns_per_op.push_back(elapsed / (static_cast<double>(num_runs) * ops_per_run));
+		}
+		allocs_end = getNumAllocations();
+	}
+
+	std::sort(samples_ns_per_op.begin(), samples_ns_per_op.end());
+
+	Result result;
+	result.name = name;
+	result.size = size;
+	result.ns_per_op = samples_ns_per_op[samples_ns_per_op.size() / 2];
+	result.allocs_per_op = static_cast<double>(allocs_end - allocs_start) / (static_cast<double>(num_runs) * num_samples * ops_per_run);
+	return result;
+}
+
+void Benchmark::run(const std::string& filter) {
+	std::cout << std::left << std::setw(40) << "benchmark" << std::right
+		<< std::setw(10) << "size"
+		<< std::setw(16) << "ns/op"
+		<< std::setw(14) << "allocs/op" << std::endl;
+
+	for (unsigned int i = 0; i < m_cases.size(); ++i) {
+		const Case& bench_case = m_cases[i];
+		if (bench_case.name.find(filter) == std::string::npos)
+			continue;
+
+		for (unsigned int k = 0; k < bench_case.sizes.size(); ++k) {
+			unsigned int size = bench_case.sizes[k];
+			unsigned int ops_per_run = 1;
+			// The input is destroyed with the function at the end of the scope, before the next size is set up
+			std::function<void()> func = bench_case.setup(size, ops_per_run);
+			if (!func) {
+				std::cout << bench_case.name << " : skipped" << std::endl;
+				continue;
+			}
+
+			Result result = measure(bench_case.name, size, func, ops_per_run);
+			m_results.push_back(result);
+
+			std::cout << std::left << std::setw(40) << result.name << std::right
+				<< std::setw(10) << result.size
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(16) << result.ns_per_op
+				<< std::setw(14) << result.allocs_per_op << std::endl;
+		}
+	}
+}
+
+void Benchmark::addEngineCases() {
+	/// Bones transforms of the animated model of the game
+	// The size is the number of skeletons updated by one operation
+	Case bones_case;
+	bones_case.name = "Model::updateBonesTransforms";
+	bones_case.sizes = { 1 };
+	bones_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		if (!createHiddenContext())
+			return std::function<void()>();
+
+		std::shared_ptr<Model> model = std::make_shared<Model>("Content/boblampclean.md5mesh");
+		model->waitUntilLoaded();
+		ops_per_run = size;
+		return [model, size]() {
+			for (unsigned int i = 0; i < size; ++i) {
+				model->advance(1.f / 60.f);
+				model->updateBonesTransforms();
+			}
+			doNotOptimize(model->m_transforms[0]);
+		};
+	};
+	add(bones_case);
+
+	/// Bounding box of an array of vertices
+	// The size is the number of vertices, one operation is one vertex
+	Case bbox_case;
+	bbox_case.name = "BoundingBox::create";
+	bbox_case.sizes = { 1000, 100000, 1000000 };
+	bbox_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> distribution(-100.f, 100.f);
+
+		auto vertices = std::make_shared<std::vector<Mesh::VertexFormat>>();
+		vertices->reserve(size);
+		for (unsigned int i = 0; i < size; ++i) {
+			vertices->push_back(Mesh::VertexFormat(glm::vec3(distribution(generator), distribution(generator), distribution(generator)),
+				glm::vec4(1.f),
+				glm::vec3(0.f),
+				glm::vec3(0.f, 1.f, 0.f)));
+		}
+		glm::mat4 transform = glm::rotate(glm::translate(glm::mat4(1.f), glm::vec3(1.f, 2.f, 3.f)), 0.5f, glm::vec3(0.f, 1.f, 0.f));
+
+		ops_per_run = size;
+		return [vertices, transform]() {
+			BoundingBox box = BoundingBox::create(*vertices, transform);
+			doNotOptimize(box);
+		};
+	};
+	add(bbox_case);
+
+	/// Frustum culling of boxes spread around the viewer of the games
+	// The size is the number of boxes, one operation is one box
+	Case cull_case;
+	cull_case.name = "FrustumCuller::cull";
+	cull_case.sizes = { 100, 10000, 100000 };
+	cull_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> distribution(-200.f, 200.f);
+
+		auto culler = std::make_shared<FrustumCuller>();
+		culler->reserve(size);
+		for (unsigned int i = 0; i < size; ++i) {
+			BoundingBox box;
+			box.min = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+			box.max = box.min + glm::vec3(1.f);
+			culler->add(box);
+		}
+		Viewer viewer(glm::vec3(0.f, 10.f, 30.f), glm::vec3(0.f));
+		glm::mat4 view_projection = Viewer::getProjectionMatrix() * viewer.getViewMatrix();
+
+		ops_per_run = size;
+		return [culler, view_projection]() {
+			culler->cull(view_projection);
+			doNotOptimize(culler->getVisible());
+		};
+	};
+	add(cull_case);
+
+	/// Occlusion culling of boxes placed behind and around a wall in front of the viewer
+	// The size is the number of boxes, one operation is one box. The wall is rasterized and the pyramid built in every run
+	Case occlusion_case;
+	occlusion_case.name = "OcclusionCuller (rasterize + test)";
+	occlusion_case.sizes = { 100, 10000, 100000 };
+	occlusion_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> distribution(-20.f, 20.f);
+
+		auto boxes = std::make_shared<std::vector<BoundingBox>>(size);
+		for (unsigned int i = 0; i < size; ++i) {
+			BoundingBox& box = (*boxes)[i];
+			box.min = glm::vec3(distribution(generator), distribution(generator) * 0.25f, -10.f - std::fabs(distribution(generator)));
+			box.max = box.min + glm::vec3(1.f);
+		}
+
+		// Wall of 20x10 at z = -5, made of the two triangles of a quad
+		auto wall = std::make_shared<Mesh>();
+		wall->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(-10.f, -5.f, -5.f)));
+		wall->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(10.f, -5.f, -5.f)));
+		wall->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(10.f, 5.f, -5.f)));
+		wall->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(-10.f, 5.f, -5.f)));
+		wall->m_indexes = { 0, 1, 2, 2, 3, 0 };
+
+		Viewer viewer(glm::vec3(0.f, 0.f, 5.f), glm::vec3(0.f, 0.f, -5.f));
+		glm::mat4 view_projection = Viewer::getProjectionMatrix() * viewer.getViewMatrix();
+		auto occlusion = std::make_shared<OcclusionCuller>();
+
+		ops_per_run = size;
+		return [boxes, wall, occlusion, view_projection]() {
+			occlusion->begin(view_projection);
+			occlusion->rasterize(wall->m_vertices, wall->m_indexes, glm::mat4(1.f));
+			occlusion->buildHierarchy();
+
+			unsigned int num_visible = 0;
+			for (unsigned int i = 0; i < boxes->size(); ++i) {
+				num_visible += occlusion->isVisible((*boxes)[i]);
+			}
+			doNotOptimize(num_visible);
+		};
+	};
+	add(occlusion_case);
+
+	/// Simplification of a non indexed grid (3 vertices per triangle as imported by assimp) to a tenth of its triangles
+	// The size is the number of triangles, one operation is one triangle
+	Case simplify_case;
+	simplify_case.name = "MeshSimplifier::simplify";
+	simplify_case.sizes = { 2048, 32768 };
+	simplify_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		std::shared_ptr<Mesh> mesh = createNoisyGrid(size);
+
+		ops_per_run = static_cast<unsigned int>(mesh->m_indexes.size() / 3);
+		return [mesh]() {
+			std::vector<GLuint> indexes = MeshSimplifier::simplify(mesh->m_vertices, mesh->m_indexes, mesh->m_indexes.size() / 10);
+			doNotOptimize(indexes);
+		};
+	};
+	add(simplify_case);
+
+	/// Optimization of a non indexed grid as done at the import : weld, vertex cache and vertex fetch
+	// The size is the number of triangles, one operation is one triangle. The vertices and the cache miss ratios
+	// before and after are written once for each size (20000 triangles is a grid of 100 x 100 quads)
+	Case optimize_case;
+	optimize_case.name = "MeshOptimizer (weld, cache, fetch)";
+	optimize_case.sizes = { 20000, 200000 };
+	optimize_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		std::shared_ptr<Mesh> mesh = createNoisyGrid(size);
+
+		std::vector<Mesh::VertexFormat> vertices = mesh->m_vertices;
+		std::vector<GLuint> indexes = mesh->m_indexes;
+		MeshOptimizer::weld(vertices, indexes);
+		MeshOptimizer::optimizeVertexCache(indexes, vertices.size());
+		MeshOptimizer::optimizeVertexFetch(vertices, indexes);
+		std::cout << "grid of " << mesh->m_indexes.size() / 3 << " triangles : " << mesh->m_vertices.size() << " -> " << vertices.size()
+			<< " vertices, cache miss ratio " << std::fixed << std::setprecision(2)
+			<< MeshOptimizer::computeCacheMissRatio(mesh->m_indexes, mesh->m_vertices.size()) << " -> "
+			<< MeshOptimizer::computeCacheMissRatio(indexes, vertices.size()) << std::endl;
+
+		ops_per_run = static_cast<unsigned int>(mesh->m_indexes.size() / 3);
+		// The copy of the imported triangles is part of the measure, as it is done at the import
+		return [mesh]() {
+			std::vector<Mesh::VertexFormat> vertices = mesh->m_vertices;
+			std::vector<GLuint> indexes = mesh->m_indexes;
+			MeshOptimizer::weld(vertices, indexes);
+			MeshOptimizer::optimizeVertexCache(indexes, vertices.size());
+			MeshOptimizer::optimizeVertexFetch(vertices, indexes);
+			doNotOptimize(indexes);
+		};
+	};
+	add(optimize_case);
+
+	/// Transform hierarchies
+	// The size is the number of nodes, one operation is one node
+	// A deep hierarchy is a chain of entities, a wide hierarchy is a root having all the other entities as children
+	const bool deep_hierarchy[] = { true, false };
+	for (bool deep : deep_hierarchy) {
+		Case hierarchy_case;
+		hierarchy_case.name = deep ? "EntityHierarchy::compute (deep)" : "EntityHierarchy::compute (wide)";
+		hierarchy_case.sizes = { 10, 100, 1000 };
+		if (!deep)
+			hierarchy_case.sizes.push_back(10000);
+		hierarchy_case.setup = [deep](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+			auto state = std::make_shared<HierarchyState>();
+
+			btTransform local;
+			local.setIdentity();
+			local.setOrigin(btVector3(0.f, 1.f, 0.f));
+			local.setRotation(btQuaternion(btVector3(0, 1, 0), 0.1f));
+
+			std::vector<EntityHierarchy*> nodes;
+			for (unsigned int i = 0; i < size; ++i) {
+				entityx::Entity entity = state->entities.create();
+				Physics physics = createBoxPhysics(btVector3(0, 0, 0));
+				entity.assign<Physics>(physics);
+				state->physics.push_back(physics);
+
+				std::unique_ptr<EntityHierarchy> node = std::make_unique<EntityHierarchy>(entity, local);
+				EntityHierarchy* node_ptr = node.get();
+				if (i == 0)
+					state->root = std::move(node);
+				else if (deep)
+					nodes.back()->addChild(std::move(node));
+				else
+					state->root->addChild(std::move(node));
+				nodes.push_back(node_ptr);
+			}
+
+			ops_per_run = size;
+			return [state]() {
+				state->root->computeTransformHierarchy();
+			};
+		};
+		add(hierarchy_case);
+	}
+
+	/// Conversion of the bullet transforms to the transforms of the renderables
+	// The size is the number of bodies, one operation is one body
+	Case convert_case;
+	convert_case.name = "RenderSystem::btTransformToLocalTransform";
+	convert_case.sizes = { 1000, 10000, 100000 };
+	convert_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		struct ConvertState {
+			~ConvertState() {
+				for (unsigned int i = 0; i < shapes.size(); ++i) {
+					delete shapes[i];
+				}
+			}
+
+			Viewer viewer;
+			std::vector<btTransform> transforms;
+			std::vector<btCollisionShape*> shapes;
+		};
+		auto state = std::make_shared<ConvertState>();
+		auto render_system = std::make_shared<RenderSystem>(state->viewer);
+
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+		for (unsigned int i = 0; i < size; ++i) {
+			btTransform tr;
+			tr.setIdentity();
+			tr.setOrigin(btVector3(100.f * distribution(generator), 100.f * distribution(generator), 100.f * distribution(generator)));
+			tr.setRotation(btQuaternion(btVector3(distribution(generator), 1.f, distribution(generator)).normalized(), distribution(generator)));
+			state->transforms.push_back(tr);
+
+			btCollisionShape* shape = new btBoxShape(btVector3(0.5f, 0.5f, 0.5f));
+			shape->setLocalScaling(btVector3(1.f, 2.f, 1.f));
+			state->shapes.push_back(shape);
+		}
+
+		ops_per_run = size;
+		return [state, render_system]() {
+			for (unsigned int i = 0; i < state->transforms.size(); ++i) {
+				LocalTransform local_tr = render_system->btTransformToLocalTransform(state->transforms[i], state->shapes[i]);
+				doNotOptimize(local_tr);
+			}
+		};
+	};
+	add(convert_case);
+
+	/// Picking of an entity among named entities
+	// The size is the number of entities in the world. The boxes are aligned along the x axis
+	// and the ray hits the last one in the order of the names (worst case of the search by name)
+	Case picking_case;
+	picking_case.name = "World::isEntityPicked";
+	picking_case.sizes = { 100, 1000, 10000 };
+	picking_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		auto state = std::make_shared<WorldState>();
+		World& world = Singleton<World>::getInstance();
+
+		for (unsigned int i = 0; i < size; ++i) {
+			entityx::Entity entity = state->entities.create();
+			Physics physics = createBoxPhysics(btVector3(2.f * i, 0.f, 0.f));
+			entity.assign<Physics>(physics);
+			state->rigid_bodies.push_back(physics.rigid_body);
+
+			std::ostringstream name;
+			name << "entity" << std::setw(5) << std::setfill('0') << i;
+			world.addEntity(name.str(), entity);
+		}
+
+		btVector3 from(2.f * (size - 1), 10.f, 0.f);
+		btVector3 to(2.f * (size - 1), -10.f, 0.f);
+
+		ops_per_run = 1;
+		return [state, from, to]() {
+			std::string hit_entity;
+			btVector3 I;
+			bool hit = Singleton<World>::getInstance().isEntityPicked(from, to, hit_entity, I);
+			doNotOptimize(hit);
+		};
+	};
+	add(picking_case);
+
+	/// Step of a finite state machine
+	// The size is the number of transitions of each state. Only the last one is taken
+	// so that all the transitions are evaluated at each step. One operation is one step
+	Case fsm_case;
+	fsm_case.name = "FiniteStateMachine::run";
+	fsm_case.sizes = { 1, 8, 64 };
+	fsm_case.setup = [](unsigned int size, unsigned int& ops_per_run) -> std::function<void()> {
+		struct FsmState {
+			FsmState() : counter(0),
+				first([this](entityx::Entity entity, entityx::Entity player) { counter++; }),
+				second([this](entityx::Entity entity, entityx::Entity player) { counter--; }) {
+			}
+
+			int counter;
+			FiniteStateMachine::State first;
+			FiniteStateMachine::State second;
+			std::unique_ptr<FiniteStateMachine> fsm;
+		};
+		auto state = std::make_shared<FsmState>();
+
+		auto never = [](entityx::Entity entity, entityx::Entity player) { return false; };
+		auto always = [](entityx::Entity entity, entityx::Entity player) { return true; };
+		for (unsigned int i = 0; i + 1 < size; ++i) {
+			state->first.addTransition(FiniteStateMachine::Transition(&state->second, never));
+			state->second.addTransition(FiniteStateMachine::Transition(&state->first, never));
+		}
+		state->first.addTransition(FiniteStateMachine::Transition(&state->second, always));
+		state->second.addTransition(FiniteStateMachine::Transition(&state->first, always));
+		state->fsm = std::make_unique<FiniteStateMachine>(&state->first);
+
+		ops_per_run = 1;
+		return [state]() {
+			bool ended = state->fsm->run(entityx::Entity(), entityx::Entity());
+			doNotOptimize(ended);
+		};
+	};
+	add(fsm_case);
+}
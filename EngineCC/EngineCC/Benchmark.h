@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+/// Micro-benchmarks of the hot kernels of the engine
+// Each case is run with synthetic inputs of several sizes. The time and the number of heap allocations
+// are measured over many repetitions and reported per operation (ns/op, allocs/op).
+// Run them with : EngineCC --bench [filter]
+class Benchmark {
+public:
+	// A case prepares its input of a given size in setup and returns the function to measure.
+	// One call of this function counts for ops_per_run operations.
+	struct Case {
+		std::string name;
+		std::vector<unsigned int> sizes;
+		std::function<std::function<void()>(unsigned int size, unsigned int& ops_per_run)> setup;
+	};
+
+	struct Result {
+		std::string name;
+		unsigned int size;
+		double ns_per_op;
+		double allocs_per_op;
+	};
+
+	Benchmark();
+	~Benchmark();
+
+	void add(const Case& bench_case);
+
+	// Run the cases whose name contains filter and print the results
+	void run(const std::string& filter = "");
+
+	// Number of heap allocations done while the cases were measured
+	static uint64_t getNumAllocations();
+
+	// Prevent the compiler from removing a computation whose result is not used
+	template<typename T>
+	static void doNotOptimize(const T& value) {
+		static volatile const void* sink;
+		sink = &value;
+	}
+
+private:
+	Result measure(const std::string& name, unsigned int size, const std::function<void()>& func, unsigned int ops_per_run) const;
+
+	// Register the kernels of the engine
+	void addEngineCases();
+
+private:
+	std::vector<Case> m_cases;
+	std::vector<Result> m_results;
+};
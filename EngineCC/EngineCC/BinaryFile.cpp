@@ -0,0 +1,193 @@
+#include <fstream>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "BinaryFile.h"
+
+/// MappedFile definitions
+#ifdef _WIN32
+MappedFile::MappedFile() : m_data(nullptr),
+						   m_size(0),
+						   m_file(INVALID_HANDLE_VALUE),
+						   m_mapping(nullptr) {
+}
+#else
+MappedFile::MappedFile() : m_data(nullptr),
+						   m_size(0) {
+}
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const std::string& filename) {
+	close();
+#ifdef _WIN32
+	m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+		close();
+		return false;
+	}
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == nullptr) {
+		close();
+		return false;
+	}
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr) {
+		close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		::close(file);
+		return false;
+	}
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping stays valid once the file is closed
+	::close(file);
+	if (data == MAP_FAILED)
+		return false;
+	m_data = static_cast<const unsigned char*>(data);
+	m_size = static_cast<size_t>(status.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_data != nullptr)
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+	const uint64_t prime = 1099511628211ULL;
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= prime;
+	}
+	return hash;
+}
+
+bool getFileStatus(const std::string& filename, uint64_t& size, uint64_t& modification_time) {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes))
+		return false;
+	size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	modification_time = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat status;
+	if (stat(filename.c_str(), &status) != 0)
+		return false;
+	size = static_cast<uint64_t>(status.st_size);
+	// In nanoseconds, an edit in the same second as the previous call is seen
+	modification_time = static_cast<uint64_t>(status.st_mtim.tv_sec) * 1000000000ULL + static_cast<uint64_t>(status.st_mtim.tv_nsec);
+#endif
+	return true;
+}
+
+/// BinaryWriter definitions
+void BinaryWriter::writeString(const std::string& value) {
+	writeValue<uint32_t>(static_cast<uint32_t>(value.size()));
+	writeBytes(value.data(), value.size());
+}
+
+void BinaryWriter::writeBytes(const void* data, size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+}
+
+void BinaryWriter::align() {
+	m_buffer.resize((m_buffer.size() + BINARY_ARRAY_ALIGNMENT - 1) / BINARY_ARRAY_ALIGNMENT * BINARY_ARRAY_ALIGNMENT, 0);
+}
+
+bool BinaryWriter::save(const std::string& filename) const {
+	const std::string temporary_filename = filename + ".tmp";
+	{
+		std::ofstream file(temporary_filename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size());
+		if (!file.good())
+			return false;
+	}
+
+	// rename does not replace an existing file on Windows
+	std::remove(filename.c_str());
+	return std::rename(temporary_filename.c_str(), filename.c_str()) == 0;
+}
+
+/// BinaryReader definitions
+BinaryReader::BinaryReader(const unsigned char* data, size_t size) : m_data(data),
+																	 m_size(size),
+																	 m_position(0) {
+}
+
+bool BinaryReader::readString(std::string& value) {
+	uint32_t size = 0;
+	if (!readValue(size))
+		return false;
+	const unsigned char* bytes = skipBytes(size);
+	if (bytes == nullptr)
+		return false;
+	value.assign(reinterpret_cast<const char*>(bytes), size);
+	return true;
+}
+
+bool BinaryReader::readBytes(void* data, size_t size) {
+	const unsigned char* bytes = skipBytes(size);
+	if (bytes == nullptr)
+		return false;
+	if (size > 0)
+		std::memcpy(data, bytes, size);
+	return true;
+}
+
+const unsigned char* BinaryReader::skipBytes(size_t size) {
+	if (size > m_size - m_position)
+		return nullptr;
+	const unsigned char* bytes = m_data + m_position;
+	m_position += size;
+	return bytes;
+}
+
+bool BinaryReader::align() {
+	size_t aligned_position = (m_position + BINARY_ARRAY_ALIGNMENT - 1) / BINARY_ARRAY_ALIGNMENT * BINARY_ARRAY_ALIGNMENT;
+	return skipBytes(aligned_position - m_position) != nullptr;
+}
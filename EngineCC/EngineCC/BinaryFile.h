@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/// Read only mapping of a file in memory
+// The pages are read by the system when they are first accessed, the file is not copied
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file does not exist or cannot be mapped
+	bool open(const std::string& filename);
+	void close();
+
+	const unsigned char* getData() const {
+		return m_data;
+	}
+	size_t getSize() const {
+		return m_size;
+	}
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+};
+
+// 64 bits FNV-1a hash, a previous hash can be given as seed to chain the data
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+// Size and last modification time of a file without reading it. The time is only compared to the one of a previous call
+// Returns false if the file does not exist
+bool getFileStatus(const std::string& filename, uint64_t& size, uint64_t& modification_time);
+
+/// Binary files of the engine caches
+// The values are copied byte for byte (no pointer nor owned memory), the files are only read back by the same build on the same platform.
+// The arrays are prefixed by their number of elements (uint32) and their elements start on BINARY_ARRAY_ALIGNMENT bytes
+// from the start of the file, so that they can be read in place from a mapped file
+#define BINARY_ARRAY_ALIGNMENT 16
+
+class BinaryWriter {
+public:
+	template<typename T>
+	void writeValue(const T& value) {
+		writeBytes(&value, sizeof(T));
+	}
+
+	template<typename T>
+	void writeArray(const std::vector<T>& values) {
+		writeValue<uint32_t>(static_cast<uint32_t>(values.size()));
+		align();
+		writeBytes(values.data(), sizeof(T) * values.size());
+	}
+
+	void writeString(const std::string& value);
+	void writeBytes(const void* data, size_t size);
+	// Pad the buffer with zeros up to the next BINARY_ARRAY_ALIGNMENT bytes
+	void align();
+
+	const std::vector<unsigned char>& getBuffer() const {
+		return m_buffer;
+	}
+
+	// Write the buffer in a temporary file renamed once complete, so that a reader never sees a partial file
+	bool save(const std::string& filename) const;
+
+private:
+	std::vector<unsigned char> m_buffer;
+};
+
+// Read the values of a BinaryWriter from memory (e.g. a MappedFile). Every read checks the bounds,
+// a truncated or corrupted file makes the reads fail instead of reading past the end
+class BinaryReader {
+public:
+	BinaryReader(const unsigned char* data, size_t size);
+
+	template<typename T>
+	bool readValue(T& value) {
+		return readBytes(&value, sizeof(T));
+	}
+
+	// Elements of an array written by writeArray, they stay in the memory read. nullptr if the memory is too short
+	template<typename T>
+	const T* readArrayData(uint32_t& num_values) {
+		if (!readValue(num_values) || !align() || num_values > (m_size - m_position) / sizeof(T))
+			return nullptr;
+		return reinterpret_cast<const T*>(skipBytes(sizeof(T) * num_values));
+	}
+
+	template<typename T>
+	bool readArray(std::vector<T>& values) {
+		uint32_t num_values = 0;
+		const T* data = readArrayData<T>(num_values);
+		if (data == nullptr)
+			return false;
+		values.assign(data, data + num_values);
+		return true;
+	}
+
+	bool readString(std::string& value);
+	bool readBytes(void* data, size_t size);
+	// Pointer to the next size bytes in the memory read, nullptr if there are not enough of them
+	const unsigned char* skipBytes(size_t size);
+	// Skip the padding written by BinaryWriter::align
+	bool align();
+
+	size_t getPosition() const {
+		return m_position;
+	}
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_position;
+};
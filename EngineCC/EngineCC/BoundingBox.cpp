@@ -15,4 +15,25 @@ BoundingBox BoundingBox::create(const std::vector<Mesh::VertexFormat>& vertices,
 	}
 
 	return box;
+}
+
+BoundingBox BoundingBox::transform(const glm::mat4& transform_mat) const {
+	// Each column of the matrix contributes to the min or the max of the new box
+	// depending on its sign (J. Arvo, Transforming Axis-Aligned Bounding Boxes)
+	BoundingBox box;
+	box.min = glm::vec3(transform_mat[3]);
+	box.max = box.min;
+	for (unsigned int i = 0; i < 3; ++i) {
+		glm::vec3 a = glm::vec3(transform_mat[i]) * min[i];
+		glm::vec3 b = glm::vec3(transform_mat[i]) * max[i];
+		box.min += glm::min(a, b);
+		box.max += glm::max(a, b);
+	}
+
+	return box;
+}
+
+void BoundingBox::merge(const BoundingBox& box) {
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
 }
\ No newline at end of file
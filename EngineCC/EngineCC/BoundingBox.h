@@ -12,4 +12,9 @@ struct BoundingBox {
 	glm::vec3 max;
 
 	static BoundingBox create(const std::vector<Mesh::VertexFormat>& vertices, const glm::mat4& transform_mat);
+
+	// Smallest box containing this box transformed by transform_mat
+	BoundingBox transform(const glm::mat4& transform_mat) const;
+	// Grow the box so that it contains box
+	void merge(const BoundingBox& box);
 };
\ No newline at end of file
@@ -78,6 +78,10 @@ struct Carryable {
 	btTransform local_tr;
 };
 
+// Opaque entities hiding a large part of the scene (walls, doors...). Their meshes are rasterized by the occlusion culling
+struct Occluder {
+};
+
 // Entities can be equipped of two weapons, swords, spears, a shield or just a potion
 struct Handler {
 	entityx::Entity left_arm;
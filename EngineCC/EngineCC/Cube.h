@@ -10,6 +10,7 @@
 
 #include "Primitive.h"
 #include "Mesh.h"
+#include "AssetCache.h"
 
 class Cube : public Primitive {
 public:
@@ -24,18 +25,23 @@ public:
 	}
 
 	void setTexture(const std::string& filepath) {
-		for (int i = 0; i < m_meshes.size(); ++i) {
-			Mesh& mesh = dynamic_cast<Mesh&>(*(m_meshes[i]));
-			
-			std::shared_ptr<Texture> texture = std::make_shared<CubeMapTexture>(filepath);
-			assert(texture->load());
-			mesh.setTexture(texture);
-		}
+		setSharedTexture<CubeMapTexture>(filepath);
+	}
+
+	// Geometry shared by all the cubes, also drawn in place of the models that are not loaded yet
+	static std::shared_ptr<Drawable> getSharedMesh() {
+		AssetCache<std::string, Drawable>& geometries = AssetCache<std::string, Drawable>::getInstance();
+		return geometries.get("cube", &Cube::createMesh);
 	}
 
 private:
 	void load() {
-		std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>();
+		// All the cubes share the same geometry
+		m_meshes.push_back(getSharedMesh());
+	}
+
+	static std::shared_ptr<Drawable> createMesh() {
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
 		float half = std::sqrt(3.f) / 2;
 		mesh->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(-0.5, -0.5, 0.5),
 			glm::vec4(1.0, 0.0, 0.0, 1.0), glm::vec3(-half, -half, half)));
@@ -77,10 +83,9 @@ private:
 			6, 7, 3,
 		};
 		mesh->m_indexes = std::vector<GLuint>(indexes_arr, indexes_arr + 36);
+		mesh->createVao();
 
-		m_meshes.push_back(std::move(mesh));
-
-		this->writeBuffers();
+		return mesh;
 	}
 };
 
@@ -97,18 +102,18 @@ public:
 	}
 
 	void setTexture(const std::string& filepath) {
-		for (int i = 0; i < m_meshes.size(); ++i) {
-			Mesh& mesh = dynamic_cast<Mesh&>(*(m_meshes[i]));
-
-			std::shared_ptr<Texture> texture = std::make_shared<SimpleTexture>(filepath);
-			assert(texture->load());
-			mesh.setTexture(texture);
-		}
+		setSharedTexture<SimpleTexture>(filepath);
 	}
 
 private:
 	void load() {
-		std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>();
+		// All the planes share the same geometry
+		AssetCache<std::string, Drawable>& geometries = AssetCache<std::string, Drawable>::getInstance();
+		m_meshes.push_back(geometries.get("plane", &Plane::createMesh));
+	}
+
+	static std::shared_ptr<Drawable> createMesh() {
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
 		mesh->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(-0.5, 0, -0.5),
 			glm::vec4(1.0, 0.0, 0.0, 1.0), glm::vec3(0, 0, 0)));
 		mesh->m_vertices.push_back(Mesh::VertexFormat(glm::vec3(0.5, 0, -0.5),
@@ -124,10 +129,9 @@ private:
 			2, 3, 0
 		};
 		mesh->m_indexes = std::vector<GLuint>(indexes_arr, indexes_arr + 6);
+		mesh->createVao();
 
-		m_meshes.push_back(std::move(mesh));
-
-		this->writeBuffers();
+		return mesh;
 	}
 };
 
@@ -0,0 +1,83 @@
+#include <algorithm>
+
+#include "DebugLineRenderer.h"
+#include "Shader.h"
+#include "Viewer.h"
+#include "UniformRing.h"
+#include "Trace.h"
+
+namespace {
+	const size_t initial_capacity = 1 << 14;
+
+	GLuint packColor(const glm::vec4& color) {
+		glm::vec4 clamped = glm::clamp(color, glm::vec4(0.f), glm::vec4(1.f)) * 255.f + 0.5f;
+		return static_cast<GLuint>(clamped.r) |
+			   (static_cast<GLuint>(clamped.g) << 8) |
+			   (static_cast<GLuint>(clamped.b) << 16) |
+			   (static_cast<GLuint>(clamped.a) << 24);
+	}
+}
+
+/// DebugLineRenderer definitions
+DebugLineRenderer::DebugLineRenderer() : m_vao(0),
+										 m_vbo(0),
+										 m_capacity(0) {
+}
+
+DebugLineRenderer::~DebugLineRenderer() {
+	// The renderer is a static of the debug drawer, the GL objects are released with the context
+}
+
+void DebugLineRenderer::createBuffers() {
+	glCreateBuffers(1, &m_vbo);
+	m_capacity = initial_capacity;
+	glNamedBufferData(m_vbo, m_capacity * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+
+	glCreateVertexArrays(1, &m_vao);
+	glVertexArrayVertexBuffer(m_vao, 0, m_vbo, 0, sizeof(Vertex));
+	glEnableVertexArrayAttrib(m_vao, 0);
+	glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, point));
+	glVertexArrayAttribBinding(m_vao, 0, 0);
+	glEnableVertexArrayAttrib(m_vao, 1);
+	glVertexArrayAttribFormat(m_vao, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, color));
+	glVertexArrayAttribBinding(m_vao, 1, 0);
+}
+
+void DebugLineRenderer::addLine(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color) {
+	Vertex vertex;
+	vertex.color = packColor(color);
+	vertex.point = from;
+	m_vertices.push_back(vertex);
+	vertex.point = to;
+	m_vertices.push_back(vertex);
+}
+
+void DebugLineRenderer::flush(const Viewer& viewer, Shader& shader) {
+	TRACE_SCOPE("DebugLineRenderer::flush");
+	if (m_vertices.empty())
+		return;
+
+	if (m_vao == 0)
+		createBuffers();
+
+	// The storage is orphaned at each upload, and doubled when the lines do not fit
+	if (m_vertices.size() > m_capacity)
+		m_capacity = std::max(2 * m_capacity, m_vertices.size());
+	glNamedBufferData(m_vbo, m_capacity * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+	glNamedBufferSubData(m_vbo, 0, m_vertices.size() * sizeof(Vertex), m_vertices.data());
+
+	shader.bind();
+	UniformRing::getInstance().bindFrameUniforms(viewer.getViewMatrix(), Viewer::getProjectionMatrix());
+	glBindVertexArray(m_vao);
+	glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(m_vertices.size()));
+
+	clear();
+}
+
+void DebugLineRenderer::clear() {
+	m_vertices.clear();
+}
+
+size_t DebugLineRenderer::getNumLines() const {
+	return m_vertices.size() / 2;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Dependencies\glew\glew.h"
+
+class Shader;
+class Viewer;
+
+/// Lines drawn for debugging (physics shapes, bounding boxes...)
+// The lines of a frame are appended to a vector that keeps its capacity, and drawn with one glDrawArrays.
+// The vertex array and the vertex buffer are created once. The buffer grows geometrically when a frame has
+// more lines than it can hold, and is orphaned before each upload so that the driver does not wait for the
+// draw of the previous frame.
+class DebugLineRenderer {
+public:
+	struct Vertex {
+		glm::vec3 point;
+		// RGBA8, read as a normalized vec4
+		GLuint color;
+	};
+
+	// No GL object is created before the first flush, the renderer can be built without context
+	DebugLineRenderer();
+	~DebugLineRenderer();
+
+	void addLine(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color);
+
+	// Upload and draw the lines, then empty the list
+	void flush(const Viewer& viewer, Shader& shader);
+	void clear();
+
+	size_t getNumLines() const;
+
+private:
+	void createBuffers();
+
+private:
+	std::vector<Vertex> m_vertices;
+
+	GLuint m_vao;
+	GLuint m_vbo;
+	// Number of vertices the vertex buffer can hold
+	size_t m_capacity;
+};
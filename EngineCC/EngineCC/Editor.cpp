@@ -6,6 +6,8 @@
 #include "InputHandler.h"
 
 #include "RenderSystem.h"
+#include "AnimationSystem.h"
+#include "Profiler.h"
 
 Editor::Editor(GameProgram& program, InputHandler& input_handler) : ProgramState(program, input_handler),
 																			m_snap_to_grid(true),
@@ -37,7 +39,9 @@ Editor::Editor(GameProgram& program, InputHandler& input_handler) : ProgramState
 	LocalTransform t;
 	t.scale(glm::vec3(1000, 0, 1000));
 	m_grid->setLocalTransform(t);
+	m_grid->setTransparent(true);
 
+	systems.add<AnimationSystem>();
 	systems.add<RenderSystem>(m_viewer);
 	systems.configure();
 }
@@ -48,7 +52,10 @@ Editor::~Editor() {
 void Editor::run() {
 	GameProgram::m_current_viewer = &m_viewer;
 
-	this->callbacks();
+	{
+		PROFILE_SCOPE("callbacks");
+		this->callbacks();
+	}
 
 	if (m_input_handler.m_wheel == 1) {	
 		m_viewer.setPosition(m_viewer.getPosition() + m_viewer.getDirection());
@@ -57,17 +64,28 @@ void Editor::run() {
 		m_viewer.setPosition(m_viewer.getPosition() - m_viewer.getDirection());
 	}
 
-	EditionWindow& entity_panel = Singleton<EditionWindow>::getInstance();
-	entity_panel.render(m_input_handler, entities);
-	EntityCreationPanel& creation_panel = Singleton<EntityCreationPanel>::getInstance();
-	creation_panel.render(entities);
-	creation_panel.loadSaveSceneWindow(entities);
+	{
+		PROFILE_SCOPE("editor panels");
+		EditionWindow& entity_panel = Singleton<EditionWindow>::getInstance();
+		entity_panel.render(m_input_handler, entities);
+		EntityCreationPanel& creation_panel = Singleton<EntityCreationPanel>::getInstance();
+		creation_panel.render(entities);
+		creation_panel.loadSaveSceneWindow(entities);
+	}
+
+	{
+		PROFILE_SCOPE("animation");
+		systems.update<AnimationSystem>(1.f / 60.f);
+	}
+
+	{
+		PROFILE_SCOPE("render");
+		if (m_draw_grid) {
+			systems.system<RenderSystem>()->submit(*m_grid);
+		}
 
-	if (m_draw_grid) {
-		m_grid->draw(m_viewer);
+		systems.update<RenderSystem>(1.f / 60.f);
 	}
-	
-	systems.update_all(1.f / 60.f);
 }
 
 void Editor::reset() {
@@ -156,14 +156,7 @@ void EditionWindow::updateEntity(const std::string& name) {
 
 	const Transform& tr = m_transforms[name];
 
-	btTransform new_transform;
-	new_transform.setIdentity();
-	new_transform.setOrigin(btVector3(tr.tr.x, tr.tr.y, tr.tr.z));
-
-	btScalar theta_X = tr.rot.x * (2 * M_PI) / 360;
-	btScalar theta_Y = tr.rot.y * (2 * M_PI) / 360;
-	btScalar theta_Z = tr.rot.z * (2 * M_PI) / 360;
-	new_transform.setRotation(btQuaternion(theta_Y, theta_X, theta_Z));
+	btTransform new_transform = toBtTransform(tr);
 
 	//physic.motion_state->setWorldTransform(new_transform);
 	physic->rigid_body->setWorldTransform(new_transform);
@@ -179,6 +172,19 @@ void EditionWindow::updateEntity(const std::string& name) {
 	(*render)->setTexcoordsFactor(tr.tex_factor);
 }
 
+btTransform EditionWindow::toBtTransform(const Transform& tr) {
+	btTransform transform;
+	transform.setIdentity();
+	transform.setOrigin(btVector3(tr.tr.x, tr.tr.y, tr.tr.z));
+
+	btScalar theta_X = tr.rot.x * (2 * M_PI) / 360;
+	btScalar theta_Y = tr.rot.y * (2 * M_PI) / 360;
+	btScalar theta_Z = tr.rot.z * (2 * M_PI) / 360;
+	transform.setRotation(btQuaternion(theta_Y, theta_X, theta_Z));
+
+	return transform;
+}
+
 std::ostream& operator<<(std::ostream& stream_out, const EditionWindow::Transform& transform) {
 	stream_out << "Translation : " << std::endl;
 	stream_out << transform.tr.x << " " << transform.tr.y << " " << transform.tr.z << std::endl;
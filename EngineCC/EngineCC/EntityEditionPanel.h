@@ -22,6 +22,7 @@ using namespace tinyxml2;
 
 #include "Renderable.h"
 #include "Model.h"
+#include "Trace.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_access.hpp>
@@ -117,6 +118,9 @@ struct EditionWindow {
 	void reset();
 	void clear();
 
+	// Bullet world transform of an entity from its editor transform (the scale is not included)
+	static btTransform toBtTransform(const Transform& tr);
+
 private:
 	void updateEntity(const std::string& name);
 
@@ -282,6 +286,12 @@ public:
 		assert(*render != nullptr);
 		std::vector<glm::vec3>& vertices = (*render)->getPrimitive().getVertices();
 
+		entity.assign<Physics>(createPhysicsComponent(data, vertices));
+	}
+
+	/// Create a physics component whose collision shape is the convex hull of the vertices given
+	// This does not need any render component so that it can be used without any OpenGL context (e.g. headless simulation)
+	static Physics createPhysicsComponent(const ComponentsData& data, const std::vector<glm::vec3>& vertices) {
 		btConvexHullShape* entity_shape = new btConvexHullShape();
 		for (int i = 0; i < vertices.size(); ++i) {
 			entity_shape->addPoint(btVector3(vertices[i].x, vertices[i].y, vertices[i].z));
@@ -308,77 +318,157 @@ public:
 			body->setAngularFactor(0.f);
 
 		Physics physics = { entity_shape, motion_state, body, data.mass, local_inertia };
-		entity.assign<Physics>(physics);
+		return physics;
 	}
 
+	// The physics component needs the vertices of the model, it is added once the model is loaded without blocking the editor
 	void creationEntity(entityx::EntityManager& es, const ComponentsData& data, const EditionWindow::Transform& tr) {
 		entityx::Entity entity = es.create();
 		addRenderComponent(data, entity);
-		addPhysicsComponent(data, entity);
 
-		/// Add into the edition panel so that we can pick the entity and change its transformation
-		EditionWindow& edition_panel = Singleton<EditionWindow>::getInstance();
-		edition_panel.addEntity(data.name, tr, entity);
+		// The strings of data may not outlive this call, only its name and its physics fields are used by the callback
+		ComponentsData physics_data = data;
+		physics_data.filename = nullptr;
+		physics_data.filepath_tex = nullptr;
+		(*entity.component<Render>())->getPrimitive().whenLoaded([this, physics_data, tr, entity]() {
+			if (!entity.valid())
+				return;
+			addPhysicsComponent(physics_data, entity);
+
+			/// Add into the edition panel so that we can pick the entity and change its transformation
+			EditionWindow& edition_panel = Singleton<EditionWindow>::getInstance();
+			edition_panel.addEntity(physics_data.name, tr, entity);
+		});
 	}
 
 	void loadEntity(entityx::EntityManager& es, const std::string& entity_name, const std::string& entity_filename, const EditionWindow::Transform& tr) {
 		std::string filename = "C:\\Users\\Matthieu\\source\\repos\\EngineCC\\EngineCC\\EngineCC\\Scenes\\" + std::string(entity_filename) + ".xml";
 
 		XMLDocument doc;
+		ComponentsData data;
+		if (readEntityFile(doc, filename, entity_name, data)) {
+			/// Create the entity with all the data retrieved
+			creationEntity(es, data, tr);
+		}
+	}
+
+	/// Read the components of an entity from its XML file
+	// The filename and filepath_tex strings of data point into doc. Thus doc must live as long as data is used.
+	// Returns false if the file cannot be loaded
+	static bool readEntityFile(XMLDocument& doc, const std::string& filename, const std::string& entity_name, ComponentsData& data) {
 		XMLError eResult = doc.LoadFile(filename.c_str());
 		if (eResult != XML_SUCCESS) {
 			std::cout << "Scene file not found at : " << filename << std::endl;
+			return false;
 		}
-		else {
-			ComponentsData::RenderableType renderable_type;
-			const char* filename = nullptr;
-			const char* texture_path = nullptr;
-			float mass;
-			bool disable_angular_rotation;
-
-			XMLElement* root = doc.FirstChildElement("Root");
-			XMLElement* components = root->FirstChildElement("Components");
-			
-			/// Load each component one by one by reading into the DOM data structure obtained from the XML file
-			// Render component
-			XMLElement* render_component = components->FirstChildElement("Render");
-			assert(render_component != nullptr);
-			const char* renderable_type_str = nullptr;
-			renderable_type_str = render_component->Attribute("renderable_type");
-			assert(renderable_type_str != nullptr);
-
-			if (std::strcmp(renderable_type_str, "model") == 0) {
-				filename = render_component->Attribute("filename");
-				assert(filename != nullptr);
-				renderable_type = ComponentsData::MODEL;
-			}
-			else if(std::strcmp(renderable_type_str, "cube") == 0) {
-				texture_path = render_component->Attribute("texture_path");
-				assert(texture_path != nullptr);
-				renderable_type = ComponentsData::CUBE;
+
+		data.name = entity_name;
+		data.filename = nullptr;
+		data.filepath_tex = nullptr;
+
+		XMLElement* root = doc.FirstChildElement("Root");
+		XMLElement* components = root->FirstChildElement("Components");
+
+		/// Load each component one by one by reading into the DOM data structure obtained from the XML file
+		// Render component
+		XMLElement* render_component = components->FirstChildElement("Render");
+		assert(render_component != nullptr);
+		const char* renderable_type_str = nullptr;
+		renderable_type_str = render_component->Attribute("renderable_type");
+		assert(renderable_type_str != nullptr);
+
+		if (std::strcmp(renderable_type_str, "model") == 0) {
+			data.filename = render_component->Attribute("filename");
+			assert(data.filename != nullptr);
+			data.renderable_type = ComponentsData::MODEL;
+		}
+		else if(std::strcmp(renderable_type_str, "cube") == 0) {
+			data.filepath_tex = render_component->Attribute("texture_path");
+			assert(data.filepath_tex != nullptr);
+			data.renderable_type = ComponentsData::CUBE;
+		}
+		else if (std::strcmp(renderable_type_str, "plane") == 0) {
+			data.filepath_tex = render_component->Attribute("texture_path");
+			assert(data.filepath_tex != nullptr);
+			data.renderable_type = ComponentsData::PLANE;
+		}
+
+		// Physics component
+		XMLElement* physics_component = components->FirstChildElement("Physics");
+		assert(physics_component != nullptr);
+
+		XMLElement* mass_elt = physics_component->FirstChildElement("mass");
+		assert(mass_elt != nullptr);
+		mass_elt->QueryFloatText(&data.mass);
+
+		XMLElement* angular_rot_elt = physics_component->FirstChildElement("angular_rotation_disabled");
+		assert(angular_rot_elt != nullptr);
+		angular_rot_elt->QueryBoolText(&data.disable_angular_rotation);
+
+		return true;
+	}
+
+	/// Read the list of the entities of a scene file with their transform
+	// If parents is given, it is filled with the name of the parent of each entity (empty for the entities without parent).
+	// The parents are only written by the scene generator, the editor does not handle them.
+	// Returns false if the file cannot be loaded
+	static bool readSceneFile(const std::string& filename, std::vector<std::pair<std::string, EditionWindow::Transform>>& entities, std::vector<std::string>* parents = nullptr) {
+		XMLDocument doc;
+		XMLError eResult = doc.LoadFile(filename.c_str());
+		if (eResult != XML_SUCCESS) {
+			std::cout << "Scene file not found at : " << filename << std::endl;
+			return false;
+		}
+
+		XMLElement* root = doc.FirstChildElement("Root");
+		XMLElement* entityList = root->FirstChildElement("ListEntities");
+		XMLElement* current_entity = entityList->FirstChildElement("Entity");
+		while (current_entity != nullptr) {
+			const char* name_attribute = nullptr;
+			name_attribute = current_entity->Attribute("name");
+			assert(name_attribute != nullptr);
+			std::string entity_name = name_attribute;
+
+			// Older scenes do not save all the transform elements, we give them default values
+			EditionWindow::Transform transform = {glm::vec3(0), glm::vec3(1), glm::vec3(0), glm::vec3(1)};
+			XMLElement* rotation = current_entity->FirstChildElement("Rotation");
+			if (rotation) {
+				rotation->QueryFloatAttribute("X", &transform.rot.x);
+				rotation->QueryFloatAttribute("Y", &transform.rot.y);
+				rotation->QueryFloatAttribute("Z", &transform.rot.z);
 			}
-			else if (std::strcmp(renderable_type_str, "plane") == 0) {
-				texture_path = render_component->Attribute("texture_path");
-				assert(texture_path != nullptr);
-				renderable_type = ComponentsData::PLANE;
+
+			XMLElement* translation = current_entity->FirstChildElement("Translation");
+			if (translation) {
+				translation->QueryFloatAttribute("X", &transform.tr.x);
+				translation->QueryFloatAttribute("Y", &transform.tr.y);
+				translation->QueryFloatAttribute("Z", &transform.tr.z);
 			}
 
-			// Physics component
-			XMLElement* physics_component = components->FirstChildElement("Physics");
-			assert(physics_component != nullptr);
+			XMLElement* scale = current_entity->FirstChildElement("Scale");
+			if (scale) {
+				scale->QueryFloatAttribute("X", &transform.scale.x);
+				scale->QueryFloatAttribute("Y", &transform.scale.y);
+				scale->QueryFloatAttribute("Z", &transform.scale.z);
+			}
 
-			XMLElement* mass_elt = physics_component->FirstChildElement("mass");
-			assert(mass_elt != nullptr);
-			mass_elt->QueryFloatText(&mass);
+			XMLElement* texcoords_factor = current_entity->FirstChildElement("Texcoords_Factor");
+			if (texcoords_factor) {
+				texcoords_factor->QueryFloatAttribute("X", &transform.tex_factor.x);
+				texcoords_factor->QueryFloatAttribute("Y", &transform.tex_factor.y);
+				texcoords_factor->QueryFloatAttribute("Z", &transform.tex_factor.z);
+			}
 
-			XMLElement* angular_rot_elt = physics_component->FirstChildElement("angular_rotation_disabled");
-			assert(angular_rot_elt != nullptr);
-			angular_rot_elt->QueryBoolText(&disable_angular_rotation);
+			entities.push_back(std::make_pair(entity_name, transform));
+			if (parents) {
+				const char* parent_attribute = current_entity->Attribute("parent");
+				parents->push_back(parent_attribute ? parent_attribute : "");
+			}
 
-			/// Create the entity with all the data retrieved
-			ComponentsData data = {entity_name, renderable_type, filename, texture_path, mass, disable_angular_rotation};
-			creationEntity(es, data, tr);
+			current_entity = current_entity->NextSiblingElement("Entity");
 		}
+
+		return true;
 	}
 
 	void loadSaveSceneWindow(entityx::EntityManager& es) {
@@ -466,53 +556,20 @@ public:
 		ImGui::PushID(id);
 		id++;
 		if (ImGui::Button("Ok") && load_filename) {
-			XMLDocument doc;
-			XMLError eResult = doc.LoadFile(load_filename);
-			if (eResult != XML_SUCCESS) {
-				std::cout << "Scene file not found at : " << load_filename << std::endl;
-			}
-			else {
+			TRACE_SCOPE("load scene");
+			std::vector<std::pair<std::string, EditionWindow::Transform>> scene_entities;
+			if (readSceneFile(load_filename, scene_entities)) {
 				// We clear the current scene
 				EditionWindow& edition_window = Singleton<EditionWindow>::getInstance();
 				edition_window.clear();
 				// Once the entity manager contains no valid entity, we add
 				// the entities that are in the xml file
-
-				XMLElement* root = doc.FirstChildElement("Root");
-				XMLElement* entityList = root->FirstChildElement("ListEntities");
-				XMLElement* current_entity = entityList->FirstChildElement("Entity");
-				while (current_entity != nullptr) {
-					const char* name_attribute = nullptr;
-					name_attribute = current_entity->Attribute("name");
-					assert(name_attribute != nullptr);
-					std::string entity_name = name_attribute;
-
-					EditionWindow::Transform transform;
-					XMLElement* rotation = current_entity->FirstChildElement("Rotation");
-					rotation->QueryFloatAttribute("X", &transform.rot.x);
-					rotation->QueryFloatAttribute("Y", &transform.rot.y);
-					rotation->QueryFloatAttribute("Z", &transform.rot.z);
-
-					XMLElement* translation = current_entity->FirstChildElement("Translation");
-					translation->QueryFloatAttribute("X", &transform.tr.x);
-					translation->QueryFloatAttribute("Y", &transform.tr.y);
-					translation->QueryFloatAttribute("Z", &transform.tr.z);
-
-					XMLElement* scale = current_entity->FirstChildElement("Scale");
-					scale->QueryFloatAttribute("X", &transform.scale.x);
-					scale->QueryFloatAttribute("Y", &transform.scale.y);
-					scale->QueryFloatAttribute("Z", &transform.scale.z);
-
-					XMLElement* texcoords_factor = current_entity->FirstChildElement("Texcoords_Factor");
-					texcoords_factor->QueryFloatAttribute("X", &transform.tex_factor.x);
-					texcoords_factor->QueryFloatAttribute("Y", &transform.tex_factor.y);
-					texcoords_factor->QueryFloatAttribute("Z", &transform.tex_factor.z);
+				for (unsigned int i = 0; i < scene_entities.size(); ++i) {
+					const std::string& entity_name = scene_entities[i].first;
 
 					std::size_t pos = entity_name.find("_");
 					const std::string& entity_filename = entity_name.substr(0, pos);
-					loadEntity(es, entity_name, entity_filename, transform);
-					
-					current_entity = current_entity->NextSiblingElement("Entity");
+					loadEntity(es, entity_name, entity_filename, scene_entities[i].second);
 				}
 			}
 		}
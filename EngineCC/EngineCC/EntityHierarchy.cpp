@@ -13,8 +13,6 @@ EntityHierarchy::~EntityHierarchy() {
 	// The entity can be affected by the gravity when it is deleted from a hierarchy (i.e. drop of an entity)
 	if(m_entity.valid())
 		m_entity.component<Physics>()->rigid_body->setLinearFactor(btVector3(1, 1, 1));
-
-	std::cout << "delete entity hierarchy" << std::endl;
 }
 
 void EntityHierarchy::setLocalTransform(const btTransform& local) {
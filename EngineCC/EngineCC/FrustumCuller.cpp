@@ -0,0 +1,214 @@
+#include <chrono>
+#include <immintrin.h>
+
+#include "FrustumCuller.h"
+#include "Trace.h"
+
+namespace {
+#ifdef __AVX__
+	// Number of boxes tested by one instruction
+	const uint32_t simd_width = 8;
+#else
+	const uint32_t simd_width = 4;
+#endif
+
+	// Coordinates of the corner of the boxes the furthest along the normal of a plane
+	struct PlaneCorner {
+		const float* x;
+		const float* y;
+		const float* z;
+	};
+}
+
+/// FrustumCuller definitions
+FrustumCuller::FrustumCuller() : m_cull_time(0.f) {
+}
+
+FrustumCuller::~FrustumCuller() {
+}
+
+void FrustumCuller::extractPlanes(const glm::mat4& view_projection, glm::vec4 planes[6]) {
+	// Rows of the matrix (Gribb & Hartmann). glm matrices are indexed by column
+	glm::vec4 rows[4];
+	for (unsigned int i = 0; i < 4; ++i) {
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+	}
+
+	for (unsigned int i = 0; i < 3; ++i) {
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+}
+
+void FrustumCuller::clear() {
+	m_min_x.clear();
+	m_min_y.clear();
+	m_min_z.clear();
+	m_max_x.clear();
+	m_max_y.clear();
+	m_max_z.clear();
+	m_visible.clear();
+}
+
+void FrustumCuller::reserve(size_t num_boxes) {
+	m_min_x.reserve(num_boxes);
+	m_min_y.reserve(num_boxes);
+	m_min_z.reserve(num_boxes);
+	m_max_x.reserve(num_boxes);
+	m_max_y.reserve(num_boxes);
+	m_max_z.reserve(num_boxes);
+	m_visible.reserve(num_boxes);
+}
+
+uint32_t FrustumCuller::add(const BoundingBox& box) {
+	m_min_x.push_back(box.min.x);
+	m_min_y.push_back(box.min.y);
+	m_min_z.push_back(box.min.z);
+	m_max_x.push_back(box.max.x);
+	m_max_y.push_back(box.max.y);
+	m_max_z.push_back(box.max.z);
+	return static_cast<uint32_t>(m_min_x.size() - 1);
+}
+
+void FrustumCuller::set(uint32_t index, const BoundingBox& box) {
+	m_min_x[index] = box.min.x;
+	m_min_y[index] = box.min.y;
+	m_min_z[index] = box.min.z;
+	m_max_x[index] = box.max.x;
+	m_max_y[index] = box.max.y;
+	m_max_z[index] = box.max.z;
+}
+
+void FrustumCuller::remove(uint32_t index) {
+	const size_t last = m_min_x.size() - 1;
+	m_min_x[index] = m_min_x[last];
+	m_min_y[index] = m_min_y[last];
+	m_min_z[index] = m_min_z[last];
+	m_max_x[index] = m_max_x[last];
+	m_max_y[index] = m_max_y[last];
+	m_max_z[index] = m_max_z[last];
+	m_min_x.pop_back();
+	m_min_y.pop_back();
+	m_min_z.pop_back();
+	m_max_x.pop_back();
+	m_max_y.pop_back();
+	m_max_z.pop_back();
+}
+
+void FrustumCuller::cull(const glm::mat4& view_projection) {
+	TRACE_SCOPE("FrustumCuller::cull");
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	glm::vec4 planes[6];
+	extractPlanes(view_projection, planes);
+
+	// The corner tested for a plane only depends on the signs of its normal
+	PlaneCorner corners[6];
+	for (unsigned int p = 0; p < 6; ++p) {
+		corners[p].x = planes[p].x > 0.f ? m_max_x.data() : m_min_x.data();
+		corners[p].y = planes[p].y > 0.f ? m_max_y.data() : m_min_y.data();
+		corners[p].z = planes[p].z > 0.f ? m_max_z.data() : m_min_z.data();
+	}
+
+	m_visible.clear();
+	uint32_t num_boxes = static_cast<uint32_t>(m_min_x.size());
+	uint32_t num_simd = num_boxes - num_boxes % simd_width;
+
+#ifdef __AVX__
+	__m256 a[6], b[6], c[6], d[6];
+	for (unsigned int p = 0; p < 6; ++p) {
+		a[p] = _mm256_set1_ps(planes[p].x);
+		b[p] = _mm256_set1_ps(planes[p].y);
+		c[p] = _mm256_set1_ps(planes[p].z);
+		d[p] = _mm256_set1_ps(planes[p].w);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (uint32_t i = 0; i < num_simd; i += simd_width) {
+		__m256 outside = zero;
+		for (unsigned int p = 0; p < 6; ++p) {
+			__m256 dist = _mm256_add_ps(_mm256_mul_ps(a[p], _mm256_loadu_ps(corners[p].x + i)), d[p]);
+			dist = _mm256_add_ps(_mm256_mul_ps(b[p], _mm256_loadu_ps(corners[p].y + i)), dist);
+			dist = _mm256_add_ps(_mm256_mul_ps(c[p], _mm256_loadu_ps(corners[p].z + i)), dist);
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, zero, _CMP_LT_OQ));
+		}
+
+		int visible_mask = ~_mm256_movemask_ps(outside) & 0xFF;
+		for (uint32_t j = 0; visible_mask != 0; ++j, visible_mask >>= 1) {
+			if (visible_mask & 1)
+				m_visible.push_back(i + j);
+		}
+	}
+#else
+	__m128 a[6], b[6], c[6], d[6];
+	for (unsigned int p = 0; p < 6; ++p) {
+		a[p] = _mm_set1_ps(planes[p].x);
+		b[p] = _mm_set1_ps(planes[p].y);
+		c[p] = _mm_set1_ps(planes[p].z);
+		d[p] = _mm_set1_ps(planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint32_t i = 0; i < num_simd; i += simd_width) {
+		__m128 outside = zero;
+		for (unsigned int p = 0; p < 6; ++p) {
+			__m128 dist = _mm_add_ps(_mm_mul_ps(a[p], _mm_loadu_ps(corners[p].x + i)), d[p]);
+			dist = _mm_add_ps(_mm_mul_ps(b[p], _mm_loadu_ps(corners[p].y + i)), dist);
+			dist = _mm_add_ps(_mm_mul_ps(c[p], _mm_loadu_ps(corners[p].z + i)), dist);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, zero));
+		}
+
+		int visible_mask = ~_mm_movemask_ps(outside) & 0xF;
+		for (uint32_t j = 0; visible_mask != 0; ++j, visible_mask >>= 1) {
+			if (visible_mask & 1)
+				m_visible.push_back(i + j);
+		}
+	}
+#endif
+
+	// Remaining boxes that do not fill a register
+	cullScalar(planes, num_simd, num_boxes);
+
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+	m_cull_time = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(end - start).count();
+}
+
+bool FrustumCuller::isVisible(const glm::vec4 planes[6], const BoundingBox& box) {
+	for (unsigned int p = 0; p < 6; ++p) {
+		const glm::vec4& plane = planes[p];
+		glm::vec3 corner(plane.x > 0.f ? box.max.x : box.min.x,
+						 plane.y > 0.f ? box.max.y : box.min.y,
+						 plane.z > 0.f ? box.max.z : box.min.z);
+		if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.f)
+			return false;
+	}
+	return true;
+}
+
+void FrustumCuller::cullScalar(const glm::vec4 planes[6], uint32_t first, uint32_t last) {
+	for (uint32_t i = first; i < last; ++i) {
+		bool visible = true;
+		for (unsigned int p = 0; p < 6 && visible; ++p) {
+			const glm::vec4& plane = planes[p];
+			float x = plane.x > 0.f ? m_max_x[i] : m_min_x[i];
+			float y = plane.y > 0.f ? m_max_y[i] : m_min_y[i];
+			float z = plane.z > 0.f ? m_max_z[i] : m_min_z[i];
+			visible = (plane.x * x + plane.y * y + plane.z * z + plane.w) >= 0.f;
+		}
+
+		if (visible)
+			m_visible.push_back(i);
+	}
+}
+
+const std::vector<uint32_t>& FrustumCuller::getVisible() const {
+	return m_visible;
+}
+
+size_t FrustumCuller::size() const {
+	return m_min_x.size();
+}
+
+float FrustumCuller::getCullTime() const {
+	return m_cull_time;
+}
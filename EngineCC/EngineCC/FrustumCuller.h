@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "BoundingBox.h"
+
+/// Frustum culling of world space bounding boxes
+// The boxes are stored as a structure of arrays (one array per coordinate of their min and max corners)
+// so that they are tested against the planes of the frustum 4 at a time with SSE, or 8 at a time
+// when the engine is compiled with AVX (/arch:AVX).
+// For each plane, only the corner of the box the furthest along its normal is tested : a box is culled
+// as soon as this corner is behind one of the planes. Some boxes crossing the corners of the frustum are kept.
+class FrustumCuller {
+public:
+	FrustumCuller();
+	~FrustumCuller();
+
+	// Left, right, bottom, top, near and far planes of view_projection (a, b, c, d) with a normal pointing inside the frustum
+	static void extractPlanes(const glm::mat4& view_projection, glm::vec4 planes[6]);
+	// Test of a single box, for the callers that do not fill a table
+	static bool isVisible(const glm::vec4 planes[6], const BoundingBox& box);
+
+	void clear();
+	void reserve(size_t num_boxes);
+
+	// Returns the index of the box in the table
+	uint32_t add(const BoundingBox& box);
+	void set(uint32_t index, const BoundingBox& box);
+	// The last box of the table takes the index of the removed one
+	void remove(uint32_t index);
+
+	// Fill the indexes of the visible boxes
+	void cull(const glm::mat4& view_projection);
+
+	// Indexes of the boxes visible at the last cull, in increasing order
+	const std::vector<uint32_t>& getVisible() const;
+
+	size_t size() const;
+	// Duration of the last cull (ms)
+	float getCullTime() const;
+
+private:
+	// Test the boxes [first, last) one by one
+	void cullScalar(const glm::vec4 planes[6], uint32_t first, uint32_t last);
+
+private:
+	std::vector<float> m_min_x;
+	std::vector<float> m_min_y;
+	std::vector<float> m_min_z;
+	std::vector<float> m_max_x;
+	std::vector<float> m_max_y;
+	std::vector<float> m_max_z;
+
+	std::vector<uint32_t> m_visible;
+	float m_cull_time;
+};
@@ -7,6 +7,7 @@
 #include "GameProgram.h"
 #include "InputHandler.h"
 #include "Manager.h"
+#include "Profiler.h"
 
 #include "Components.h"
 
@@ -17,6 +18,7 @@
 #include "AttackSystem.h"
 #include "PhysicConstraintSystem.h"
 #include "MovementSystem.h"
+#include "AnimationSystem.h"
 
 #include <entityx/entityx.h>
 #include <glm/gtx/vector_angle.hpp>
@@ -142,6 +144,7 @@ void Game::createDoorEntity(entityx::EntityManager &es, World& world) {
 	//tr.setRotation(glm::vec3(0, 0, 1), 90*2*M_PI/360.f);
 	render->setLocalTransform(tr);
 	entity.assign<Render>(render);
+	entity.assign<Occluder>();
 
 	// Physics Component
 	std::vector<glm::vec3>& vertices = render->getPrimitive().getVertices();
@@ -201,6 +204,14 @@ void Game::createSwordEntity(const std::string& name, entityx::EntityManager &es
 	std::shared_ptr<Renderable<Model>> arrow_render = std::make_shared<Renderable<Model>>(shaders.get("simple"), "C:\\Users\\Matthieu\\Source\\Repos\\EngineCC\\EngineCC\\EngineCC\\Content\\sword.obj");
 	entity.assign<Render>(arrow_render);
 
+	// The physics component is added once the model is loaded, the game does not wait for the file
+	arrow_render->getPrimitive().whenLoaded([this, name, entity]() {
+		if (entity.valid())
+			addSwordPhysics(name, entity);
+	});
+}
+
+void Game::addSwordPhysics(const std::string& name, entityx::Entity entity) {
 	/// Add physic component
 	// Collision shape computed from the mesh of the entity
 	entityx::ComponentHandle<Render> render = entity.component<Render>();
@@ -290,6 +301,10 @@ void Game::init(entityx::EntityManager& es_editor) {
 
 	m_viewer.setPosition(glm::vec3(0, 5, 0));
 	m_viewer.setDirection(glm::vec3(1, 0, 0));
+	// The camera angles start from the same values at each launch of the game so that a replayed session is identical
+	m_theta = 0.f;
+	m_alpha = 0.f;
+	m_player_direction = glm::vec3(0.f);
 	
 	createGroundEntity(entities);
 	createDoorEntity(entities, world);
@@ -342,6 +357,7 @@ Game::Game(GameProgram& program, InputHandler& input_handler) : ProgramState(pro
 	systems.add<AttackSystem>();
 	systems.add<ScriptSystem>(world.get("player"));
 	systems.add<PickingSystem>(m_viewer, m_input_handler, world.get("player"));
+	systems.add<AnimationSystem>();
 	systems.add<RenderSystem>(m_viewer);
 	systems.configure();
 
@@ -547,18 +563,48 @@ void Game::run() {
 	GameProgram::m_current_viewer = &m_viewer;
 
 	/// Systems updates
-	systems.update_all(1.f / 60.f);
-
-	/*systems.update<PhysicSystem>(1.f / 60.f);
-	systems.update<MovementSystem>(1.f / 60.f);
-	systems.update<ScriptSystem>(1.f / 60.f);
-	systems.update<PickingSystem>(1.f / 60.f);
-	systems.update<RenderSystem>(1.f / 60.f);*/
+	// Each system is updated on its own, in the order they have been added, so that we can profile them
+	const entityx::TimeDelta dt = 1.f / 60.f;
+	{
+		PROFILE_SCOPE("constraints");
+		systems.update<PhysicConstraintSystem>(dt);
+	}
+	{
+		PROFILE_SCOPE("physic");
+		systems.update<PhysicSystem>(dt);
+	}
+	{
+		PROFILE_SCOPE("movement");
+		systems.update<MovementSystem>(dt);
+	}
+	{
+		PROFILE_SCOPE("attack");
+		systems.update<AttackSystem>(dt);
+	}
+	{
+		PROFILE_SCOPE("script");
+		systems.update<ScriptSystem>(dt);
+	}
+	{
+		PROFILE_SCOPE("picking");
+		systems.update<PickingSystem>(dt);
+	}
+	{
+		PROFILE_SCOPE("animation");
+		systems.update<AnimationSystem>(dt);
+	}
+	{
+		PROFILE_SCOPE("render");
+		systems.update<RenderSystem>(dt);
+	}
 
 	/// Player keyboard callbacks
 	// Reset the direction vector of the player
 	m_player_direction = glm::vec3(0.f);
-	this->callbacks();
+	{
+		PROFILE_SCOPE("callbacks");
+		this->callbacks();
+	}
 	
 	/// Player view update
 	// Viewer in game mode update
@@ -31,6 +31,8 @@ private:
 	void createPlayerEntity(entityx::EntityManager &es, World& world);
 	void createArrowEntity(entityx::EntityManager &es, entityx::EventManager &events);
 	void createSwordEntity(const std::string& name, entityx::EntityManager &es, World& world);
+	// Physics and carryable components of a sword, added once its model is loaded
+	void addSwordPhysics(const std::string& name, entityx::Entity entity);
 
 	void addEntity(const std::string& name, entityx::Entity entity);
 
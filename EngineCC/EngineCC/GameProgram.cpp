@@ -2,6 +2,7 @@
 #include <string>
 #include <set>
 #include <functional>
+#include <chrono>
 
 #include "Dependencies\glew\glew.h"
 
@@ -11,6 +12,12 @@
 #include "FiniteStateMachine.h"
 
 #include "Manager.h"
+#include "Profiler.h"
+#include "InputRecorder.h"
+#include "UniformRing.h"
+#include "AssetLoader.h"
+#include "AssetCache.h"
+#include "Model.h"
 
 #include <entityx/entityx.h>
 
@@ -99,7 +106,12 @@ GameProgram::GameProgram() : m_font_color(glm::vec4(0.5, 0.5, 0.8, 1.0)),
 
 	SetOpenglFlags();
 
-	SDL_GL_SetSwapInterval(1);
+	// A replayed session runs as fast as possible to measure the frame times
+	bool replay = (Singleton<InputRecorder>::getInstance().getMode() == InputRecorder::REPLAY);
+	SDL_GL_SetSwapInterval(replay ? 0 : 1);
+	// The entities of a replayed session must get their components (e.g. the physics of the models) on the same frames as when it
+	// was recorded : both load their assets synchronously
+	AssetLoader::getInstance().setSynchronous(Singleton<InputRecorder>::getInstance().getMode() != InputRecorder::NONE);
 	// Setup ImGui binding
 	ImGui_ImplSdlGL3_Init(m_window);
 
@@ -152,8 +164,21 @@ GameProgram::GameProgram() : m_font_color(glm::vec4(0.5, 0.5, 0.8, 1.0)),
 	glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	while (m_run) {
+		// The frame zone of the previous iteration has ended, the loading before the loop counts as the first frame
+		TRACE_END_FRAME();
+		TRACE_SCOPE("frame");
+		PROFILE_BEGIN_FRAME();
+		UniformRing::getInstance().beginFrame();
 		ImGui_ImplSdlGL3_NewFrame(m_window);
-		inputHandler.update(event);
+		{
+			PROFILE_SCOPE("input");
+			inputHandler.update(event);
+		}
+		{
+			// The assets decoded by the workers are uploaded before the entities using them are drawn
+			PROFILE_SCOPE("asset upload");
+			AssetLoader::getInstance().update(ASSET_UPLOAD_BUDGET_MS);
+		}
 		glViewport(0, 0, (int)ImGui::GetIO().DisplaySize.x, (int)ImGui::GetIO().DisplaySize.y);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glClearColor(m_font_color.x,
@@ -182,12 +207,27 @@ GameProgram::GameProgram() : m_font_color(glm::vec4(0.5, 0.5, 0.8, 1.0)),
 			}
 		}
 
-		ImGui::Render();
-		SDL_GL_SwapWindow(m_window);
+		PROFILE_DRAW_OVERLAY();
+		{
+			PROFILE_SCOPE("imgui render");
+			ImGui::Render();
+		}
+		PROFILE_COUNTER("uniforms (KB)", UniformRing::getInstance().getFrameSize() / 1024.f);
+		PROFILE_COUNTER("assets pending", AssetLoader::getInstance().getNumPending());
+		UniformRing::getInstance().endFrame();
+		{
+			PROFILE_SCOPE("swap");
+			SDL_GL_SwapWindow(m_window);
+		}
+		PROFILE_END_FRAME();
 	}
 }
 
 void GameProgram::initShaders() const {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	// The programs missing from the binary cache are compiled together by the driver threads
+	Shader::enableParallelCompile();
+
 	// Simple shader loading handling vertices and colors
 	std::shared_ptr<Shader> textured_shader = std::make_shared<Shader>("vertex_shader.glsl", "fragment_shader.glsl");
 	std::shared_ptr<Shader> textured_cubemap_shader = std::make_shared<Shader>("vertex_cubemap.glsl", "fragment_cubemap.glsl");
@@ -196,6 +236,33 @@ void GameProgram::initShaders() const {
 	// Add a new shader for drawing the lines of the bullet debug drawer
 	std::shared_ptr<Shader> debug_bullet_shader = std::make_shared<Shader>("vertex_debug_bullet_shader.glsl", "fragment_color_shader.glsl");
 
+	// Instanced variants drawing the identical renderables in one call
+	textured_shader->setInstancedVariant(std::make_shared<Shader>("vertex_shader_instanced.glsl", "fragment_shader.glsl"));
+	textured_cubemap_shader->setInstancedVariant(std::make_shared<Shader>("vertex_cubemap_instanced.glsl", "fragment_cubemap.glsl"));
+	simple_shader->setInstancedVariant(std::make_shared<Shader>("vertex_color_shader_instanced.glsl", "fragment_color_shader.glsl"));
+	grid_shader->setInstancedVariant(std::make_shared<Shader>("vertex_color_shader_instanced.glsl", "fragment_grid.glsl"));
+
+	// The uniform and storage blocks of all the programs read the ranges bound by the uniform ring
+	unsigned int num_programs = 0;
+	unsigned int num_cached = 0;
+	for (Shader* shader : { textured_shader.get(), textured_cubemap_shader.get(), simple_shader.get(), grid_shader.get(), debug_bullet_shader.get() }) {
+		for (Shader* program : { shader, shader->getInstancedVariant() }) {
+			if (!program)
+				continue;
+			program->finishLinking();
+			num_programs++;
+			if (program->isFromCache())
+				num_cached++;
+
+			program->setUniformBlockBinding("Frame", FRAME_UNIFORMS_BINDING);
+			program->setUniformBlockBinding("Object", OBJECT_UNIFORMS_BINDING);
+			program->setStorageBlockBinding("Bones", BONES_STORAGE_BINDING);
+		}
+	}
+
+	float shaders_time = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << num_programs << " shader programs ready in " << shaders_time << " ms, " << num_cached << " read from the binary cache" << std::endl;
+
 	Manager<std::string, std::shared_ptr<Shader>>& shaders = Manager<std::string, std::shared_ptr<Shader>>::getInstance();
 
 	shaders.insert("simple", simple_shader);
@@ -207,6 +274,18 @@ void GameProgram::initShaders() const {
 
 GameProgram::~GameProgram()
 {
+	Singleton<InputRecorder>::getInstance().stop();
+
+	// The entities, their assets and the shaders delete their GL objects, the context must still be current.
+	// The static pointers and caches would only be released after SDL_Quit
+	game.reset();
+	editor.reset();
+	Manager<std::string, std::shared_ptr<Shader>>::getInstance().getRessources().clear();
+	AssetCache<std::string, ModelData>::getInstance().clear();
+	AssetCache<std::string, Drawable>::getInstance().clear();
+	AssetCache<std::string, Texture>::getInstance().clear();
+	AssetLoader::getInstance().shutdown();
+
 	ImGui_ImplSdlGL3_Shutdown();
 	// Delete our opengl context, destroy our window, and shutdown SDL
 	SDL_GL_DeleteContext(m_context);
@@ -3,22 +3,50 @@
 #include "InputHandler.h"
 #include "PickingSystem.h"
 #include "Singleton.h"
+#include "InputRecorder.h"
+#include "Profiler.h"
 
 InputHandler::InputHandler(GameProgram& program) : m_program(program) {
 	m_keydown = false;
 	m_button = 0;
 	m_wheel = 0;
+	m_mouse_X = 0;
+	m_mouse_Y = 0;
 
 	m_key_repeat_disabled.insert(SDLK_RETURN);
 	// SDLK_e is reserved for the interaction with other entities
 	m_key_repeat_disabled.insert(SDLK_e);
 	m_key_repeat_disabled.insert(SDLK_r);
+	// Profiler overlay and dump
+	m_key_repeat_disabled.insert(SDLK_F1);
+	m_key_repeat_disabled.insert(SDLK_F2);
+	// Trace capture
+	m_key_repeat_disabled.insert(SDLK_F3);
+	// Physics debug drawing
+	m_key_repeat_disabled.insert(SDLK_F4);
+	m_key_repeat_disabled.insert(SDLK_F5);
 }
 
 InputHandler::~InputHandler() {
 }
 
 void InputHandler::update(SDL_Event& event) {
+	InputRecorder& recorder = Singleton<InputRecorder>::getInstance();
+	if (recorder.getMode() == InputRecorder::REPLAY) {
+		// The events are still pumped so that the window stays responsive but they are ignored
+		while (SDL_PollEvent(&event)) {
+		}
+
+		if (!recorder.replay(*this)) {
+			// End of the recorded session
+			const std::string profile_filename = recorder.getFilename() + ".profile.csv";
+			recorder.stop();
+			Singleton<FrameProfiler>::getInstance().dumpCSV(profile_filename);
+			m_program.close();
+		}
+		return;
+	}
+
 	// Pump new events 
 	// Get new keyboard events
 	m_wheel = 0;
@@ -66,6 +94,8 @@ void InputHandler::update(SDL_Event& event) {
 			break;
 		}
 	}
+
+	recorder.record(*this);
 }
 
 
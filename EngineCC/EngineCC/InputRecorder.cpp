@@ -0,0 +1,142 @@
+#include <iostream>
+
+#include "InputRecorder.h"
+#include "InputHandler.h"
+
+/// File format
+// Header : magic number, version
+// Each frame : keydown (uint8), button (uint8), wheel (int8), mouse X, mouse Y (int32), number of keys (uint16), keys (int32)
+#define INPUT_RECORD_MAGIC 0x49434345
+#define INPUT_RECORD_VERSION 1
+
+namespace {
+	template<typename T>
+	void writeValue(std::ofstream& file, T value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool readValue(std::ifstream& file, T& value) {
+		file.read(reinterpret_cast<char*>(&value), sizeof(T));
+		return file.gcount() == sizeof(T);
+	}
+}
+
+InputRecorder::InputRecorder() : m_mode(NONE),
+								 m_num_frames(0) {
+}
+
+InputRecorder::~InputRecorder() {
+	stop();
+}
+
+bool InputRecorder::startRecording(const std::string& filename) {
+	stop();
+
+	m_output.open(filename, std::ios::binary);
+	if (!m_output.is_open()) {
+		std::cout << "Unable to record the inputs in " << filename << std::endl;
+		return false;
+	}
+
+	writeValue<uint32_t>(m_output, INPUT_RECORD_MAGIC);
+	writeValue<uint32_t>(m_output, INPUT_RECORD_VERSION);
+
+	m_filename = filename;
+	m_mode = RECORD;
+	m_num_frames = 0;
+	std::cout << "Recording the inputs in " << filename << std::endl;
+	return true;
+}
+
+bool InputRecorder::startReplay(const std::string& filename) {
+	stop();
+
+	m_input.open(filename, std::ios::binary);
+	if (!m_input.is_open()) {
+		std::cout << "Unable to open the input record " << filename << std::endl;
+		return false;
+	}
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	if (!readValue(m_input, magic) || !readValue(m_input, version) || magic != INPUT_RECORD_MAGIC || version != INPUT_RECORD_VERSION) {
+		std::cout << filename << " is not an input record of this version" << std::endl;
+		m_input.close();
+		return false;
+	}
+
+	m_filename = filename;
+	m_mode = REPLAY;
+	m_num_frames = 0;
+	std::cout << "Replaying the inputs of " << filename << std::endl;
+	return true;
+}
+
+void InputRecorder::stop() {
+	if (m_mode == RECORD) {
+		m_output.close();
+		std::cout << m_num_frames << " frames of inputs recorded in " << m_filename << std::endl;
+	}
+	else if (m_mode == REPLAY) {
+		m_input.close();
+		std::cout << m_num_frames << " frames of inputs replayed from " << m_filename << std::endl;
+	}
+	m_mode = NONE;
+}
+
+InputRecorder::Mode InputRecorder::getMode() const {
+	return m_mode;
+}
+
+const std::string& InputRecorder::getFilename() const {
+	return m_filename;
+}
+
+void InputRecorder::record(const InputHandler& input) {
+	if (m_mode != RECORD)
+		return;
+
+	writeValue<uint8_t>(m_output, input.m_keydown ? 1 : 0);
+	writeValue<uint8_t>(m_output, input.m_button);
+	writeValue<int8_t>(m_output, static_cast<int8_t>(input.m_wheel));
+	writeValue<int32_t>(m_output, input.m_mouse_X);
+	writeValue<int32_t>(m_output, input.m_mouse_Y);
+	writeValue<uint16_t>(m_output, static_cast<uint16_t>(input.m_key.size()));
+	for (std::set<int>::const_iterator it = input.m_key.cbegin(); it != input.m_key.cend(); ++it) {
+		writeValue<int32_t>(m_output, *it);
+	}
+
+	m_num_frames++;
+}
+
+bool InputRecorder::replay(InputHandler& input) {
+	if (m_mode != REPLAY)
+		return false;
+
+	uint8_t keydown, button;
+	int8_t wheel;
+	int32_t mouse_X, mouse_Y;
+	uint16_t num_keys;
+	if (!readValue(m_input, keydown) || !readValue(m_input, button) || !readValue(m_input, wheel) ||
+		!readValue(m_input, mouse_X) || !readValue(m_input, mouse_Y) || !readValue(m_input, num_keys)) {
+		return false;
+	}
+
+	input.m_key.clear();
+	for (uint16_t i = 0; i < num_keys; ++i) {
+		int32_t key;
+		if (!readValue(m_input, key))
+			return false;
+		input.m_key.insert(key);
+	}
+
+	input.m_keydown = (keydown != 0);
+	input.m_button = button;
+	input.m_wheel = wheel;
+	input.m_mouse_X = mouse_X;
+	input.m_mouse_Y = mouse_Y;
+
+	m_num_frames++;
+	return true;
+}
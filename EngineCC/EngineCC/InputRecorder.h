@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+class InputHandler;
+
+/// Recording and replay of the inputs
+// The input state of the InputHandler (keys pressed, mouse position, button and wheel) is written every frame
+// in a compact binary file. Replaying it gives back exactly the same inputs frame after frame so that, together with
+// the fixed time step of the systems, a gameplay session can be run again to compare the frame times of two builds.
+// EngineCC --record <file> / EngineCC --replay <file>
+class InputRecorder {
+public:
+	enum Mode {
+		NONE,
+		RECORD,
+		REPLAY
+	};
+
+	InputRecorder();
+	~InputRecorder();
+
+	// Returns false if the file cannot be opened
+	bool startRecording(const std::string& filename);
+	bool startReplay(const std::string& filename);
+	void stop();
+
+	Mode getMode() const;
+	const std::string& getFilename() const;
+
+	// Write the input state of the current frame
+	void record(const InputHandler& input);
+	// Overwrite the input state with the one of the next recorded frame
+	// Returns false when all the frames have been replayed
+	bool replay(InputHandler& input);
+
+private:
+	Mode m_mode;
+	std::string m_filename;
+	std::ofstream m_output;
+	std::ifstream m_input;
+	uint32_t m_num_frames;
+};
@@ -1,57 +1,270 @@
+#include <algorithm>
+#include <cstddef>
+
+#include <glm/gtc/packing.hpp>
+
 #include "Mesh.h"
+#include "RenderQueue.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+namespace {
+	GLuint packColor(const glm::vec4& color) {
+		return glm::packUnorm4x8(glm::clamp(color, 0.f, 1.f));
+	}
+
+	// x, y and z on 10 bits signed normalized, read as GL_INT_2_10_10_10_REV
+	GLuint packNormal(const glm::vec3& normal) {
+		return glm::packSnorm3x10_1x2(glm::vec4(glm::clamp(normal, -1.f, 1.f), 0.f));
+	}
+
+	GLuint packTexcoord(const glm::vec3& texcoord) {
+		return glm::packHalf2x16(glm::vec2(texcoord.x, texcoord.y));
+	}
+
+	// The weights are rounded so that their sum stays the same as before the quantization
+	GLuint packWeights(const glm::vec4& weights) {
+		glm::vec4 quantized = glm::round(glm::clamp(weights, 0.f, 1.f) * 255.f);
+		float error = glm::round((weights.x + weights.y + weights.z + weights.w) * 255.f) - (quantized.x + quantized.y + quantized.z + quantized.w);
+		// The largest weight is the first one, sorted by the model loader
+		quantized.x = glm::clamp(quantized.x + error, 0.f, 255.f);
+		return glm::packUnorm4x8(quantized / 255.f);
+	}
 
-Drawable::Drawable() {
+	template<typename Vertex>
+	void setStaticAttributes() {
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, point)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(offsetof(Vertex, color)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(Vertex), (void*)(offsetof(Vertex, normal)));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, texcoord)));
+	}
+}
+
+Drawable::Drawable() : m_vao(0),
+					   m_vbo(0),
+					   m_layout(STATIC_LAYOUT),
+					   m_min_point(0.f),
+					   m_max_point(0.f) {
 }
 Drawable::~Drawable() {
+	deleteBuffers();
+}
+void Drawable::deleteBuffers() {
+	if (m_vao != 0)
+		glDeleteVertexArrays(1, &m_vao);
+	if (m_vbo != 0)
+		glDeleteBuffers(1, &m_vbo);
+	m_vao = 0;
+	m_vbo = 0;
+}
+void Drawable::computeBounds() {
+	if (m_vertices.empty())
+		return;
+
+	m_min_point = m_vertices[0].point;
+	m_max_point = m_vertices[0].point;
+	for (unsigned int i = 1; i < m_vertices.size(); ++i) {
+		m_min_point = glm::min(m_min_point, m_vertices[i].point);
+		m_max_point = glm::max(m_max_point, m_vertices[i].point);
+	}
+}
+void Drawable::writeVertexBuffer() {
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+	switch (m_layout) {
+	case STATIC_LAYOUT: {
+		std::vector<StaticVertex> vertices(m_vertices.size());
+		for (unsigned int i = 0; i < m_vertices.size(); ++i) {
+			const VertexFormat& vertex = m_vertices[i];
+			vertices[i].point = vertex.point;
+			vertices[i].color = packColor(vertex.color);
+			vertices[i].normal = packNormal(vertex.normal);
+			vertices[i].texcoord = packTexcoord(vertex.texcoord);
+		}
+		glBufferData(GL_ARRAY_BUFFER, sizeof(StaticVertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		setStaticAttributes<StaticVertex>();
+		break;
+	}
+	case SKINNED_LAYOUT: {
+		std::vector<SkinnedVertex> vertices(m_vertices.size());
+		for (unsigned int i = 0; i < m_vertices.size(); ++i) {
+			const VertexFormat& vertex = m_vertices[i];
+			vertices[i].point = vertex.point;
+			vertices[i].color = packColor(vertex.color);
+			vertices[i].normal = packNormal(vertex.normal);
+			vertices[i].texcoord = packTexcoord(vertex.texcoord);
+			for (unsigned int j = 0; j < 4; ++j) {
+				vertices[i].bones_indexes[j] = static_cast<GLubyte>(glm::clamp(vertex.bones_indexes[j], 0, 255));
+			}
+			vertices[i].weights = packWeights(vertex.weights);
+		}
+		glBufferData(GL_ARRAY_BUFFER, sizeof(SkinnedVertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		setStaticAttributes<SkinnedVertex>();
+		glEnableVertexAttribArray(4);
+		glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, sizeof(SkinnedVertex), (void*)(offsetof(SkinnedVertex, bones_indexes)));
+		glEnableVertexAttribArray(5);
+		glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinnedVertex), (void*)(offsetof(SkinnedVertex, weights)));
+		break;
+	}
+	case WIDE_SKINNED_LAYOUT: {
+		std::vector<WideSkinnedVertex> vertices(m_vertices.size());
+		for (unsigned int i = 0; i < m_vertices.size(); ++i) {
+			const VertexFormat& vertex = m_vertices[i];
+			vertices[i].point = vertex.point;
+			vertices[i].color = packColor(vertex.color);
+			vertices[i].normal = packNormal(vertex.normal);
+			vertices[i].texcoord = packTexcoord(vertex.texcoord);
+			for (unsigned int j = 0; j < 4; ++j) {
+				vertices[i].bones_indexes[j] = static_cast<GLushort>(glm::clamp(vertex.bones_indexes[j], 0, 65535));
+			}
+			vertices[i].weights = packWeights(vertex.weights);
+		}
+		glBufferData(GL_ARRAY_BUFFER, sizeof(WideSkinnedVertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		setStaticAttributes<WideSkinnedVertex>();
+		glEnableVertexAttribArray(4);
+		glVertexAttribIPointer(4, 4, GL_UNSIGNED_SHORT, sizeof(WideSkinnedVertex), (void*)(offsetof(WideSkinnedVertex, bones_indexes)));
+		glEnableVertexAttribArray(5);
+		glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(WideSkinnedVertex), (void*)(offsetof(WideSkinnedVertex, weights)));
+		break;
+	}
+	case COLORED_LAYOUT: {
+		std::vector<ColoredVertex> vertices(m_vertices.size());
+		for (unsigned int i = 0; i < m_vertices.size(); ++i) {
+			vertices[i].point = m_vertices[i].point;
+			vertices[i].color = packColor(m_vertices[i].color);
+		}
+		glBufferData(GL_ARRAY_BUFFER, sizeof(ColoredVertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void*)(offsetof(ColoredVertex, point)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ColoredVertex), (void*)(offsetof(ColoredVertex, color)));
+		break;
+	}
+	}
 }
 
 
 /// Mesh function definitions
-Mesh::Mesh() : m_texture(nullptr) {
+Mesh::Mesh() : m_ibo(0),
+			   m_index_type(GL_UNSIGNED_INT),
+			   m_texture(nullptr) {
 }
 Mesh::~Mesh() {
+	if (m_ibo != 0)
+		glDeleteBuffers(1, &m_ibo);
+}
+std::shared_ptr<Drawable> Mesh::clone() const {
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(*this);
+	// The copy gets its own buffers when its vao is created
+	mesh->m_vao = 0;
+	mesh->m_vbo = 0;
+	mesh->m_ibo = 0;
+	return mesh;
+}
+void Mesh::generateLods(const std::vector<float>& ratios) {
+	m_lod_indexes.clear();
+	const std::vector<GLuint>* previous = &m_indexes;
+	for (unsigned int i = 0; i < ratios.size(); ++i) {
+		// Each level is simplified from the previous one
+		size_t target = static_cast<size_t>(m_indexes.size() * ratios[i]);
+		std::vector<GLuint> indexes = MeshSimplifier::simplify(m_vertices, *previous, target);
+		if (indexes.empty() || indexes.size() >= previous->size())
+			break;
+		// The simplified triangles keep the order of the original ones, which is not optimal anymore
+		MeshOptimizer::optimizeVertexCache(indexes, m_vertices.size());
+
+		m_lod_indexes.push_back(indexes);
+		previous = &m_lod_indexes.back();
+	}
 }
 void Mesh::createVao() {
-	if (glIsVertexArray(m_vao))
-		glDeleteVertexArrays(1, &m_vao);
+	deleteBuffers();
+	if (m_ibo != 0)
+		glDeleteBuffers(1, &m_ibo);
+	computeBounds();
 
 	glGenVertexArrays(1, &m_vao);
 	glBindVertexArray(m_vao);
 
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	writeVertexBuffer();
+	// Model matrix and texcoords factor of the instanced draws
+	RenderQueue::setInstanceAttributes();
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Mesh::VertexFormat) * this->m_vertices.size(), &(this->m_vertices[0]), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::VertexFormat), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Mesh::VertexFormat), (void*)(offsetof(Mesh::VertexFormat, Mesh::VertexFormat::color)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::VertexFormat), (void*)(offsetof(Mesh::VertexFormat, Mesh::VertexFormat::normal)));
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::VertexFormat), (void*)(offsetof(Mesh::VertexFormat, Mesh::VertexFormat::texcoord)));
-	glEnableVertexAttribArray(4);
-	glVertexAttribIPointer(4, 4, GL_INT, sizeof(Mesh::VertexFormat), (void*)(offsetof(Mesh::VertexFormat, Mesh::VertexFormat::bones_indexes)));
-	glEnableVertexAttribArray(5);
-	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Mesh::VertexFormat), (void*)(offsetof(Mesh::VertexFormat, Mesh::VertexFormat::weights)));
+	// The levels of details follow the full resolution indexes in the element buffer
+	m_lods.clear();
+	Lod lod = { 0, static_cast<GLsizei>(this->m_indexes.size()) };
+	m_lods.push_back(lod);
+	for (unsigned int i = 0; i < m_lod_indexes.size(); ++i) {
+		lod.first_index += lod.num_indexes;
+		lod.num_indexes = static_cast<GLsizei>(m_lod_indexes[i].size());
+		m_lods.push_back(lod);
+	}
+	GLsizeiptr num_indexes = m_lods.back().first_index + m_lods.back().num_indexes;
 
-	GLuint ibo;
-	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * this->m_indexes.size(), &(this->m_indexes[0]), GL_STATIC_DRAW);
+	// Half the memory and bandwidth of the indexes when the mesh has at most 65536 vertices
+	m_index_type = (m_vertices.size() <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	const GLsizeiptr index_size = getIndexSize();
+
+	glGenBuffers(1, &m_ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size * num_indexes, NULL, GL_STATIC_DRAW);
+	for (unsigned int i = 0; i < m_lods.size(); ++i) {
+		const std::vector<GLuint>& indexes = (i == 0) ? m_indexes : m_lod_indexes[i - 1];
+		if (m_index_type == GL_UNSIGNED_SHORT) {
+			std::vector<GLushort> short_indexes(indexes.begin(), indexes.end());
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index_size * m_lods[i].first_index, index_size * short_indexes.size(), short_indexes.data());
+		}
+		else {
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index_size * m_lods[i].first_index, index_size * indexes.size(), indexes.data());
+		}
+	}
 
 }
 
 void Mesh::draw(const std::weak_ptr<Shader> shader) const {
 	glBindVertexArray(m_vao);
 	// bind the texture for the mesh
-	if (m_texture)
-		m_texture->bind(shader, "tex");
+	static const UniformId tex_id = Shader::getUniformId("tex");
+	if (m_texture) {
+		if (auto program = shader.lock())
+			m_texture->bind(*program, tex_id);
+	}
+
+	drawGeometry(0);
+}
+
+void Mesh::drawGeometry(unsigned int lod) const {
+	// The ranges are created with the vertex array, a mesh drawn before has nothing to draw
+	if (m_lods.empty())
+		return;
+	const Lod& range = m_lods[std::min<size_t>(lod, m_lods.size() - 1)];
+	glDrawElements(GL_TRIANGLES, range.num_indexes, m_index_type, (void*)(getIndexSize() * range.first_index));
+}
+
+void Mesh::drawGeometryInstanced(unsigned int lod, GLsizei count, GLuint base_instance) const {
+	if (m_lods.empty())
+		return;
+	const Lod& range = m_lods[std::min<size_t>(lod, m_lods.size() - 1)];
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, range.num_indexes, m_index_type, (void*)(getIndexSize() * range.first_index), count, base_instance);
+}
 
-	int size;
-	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
-	glDrawElements(GL_TRIANGLES, size / sizeof(GLuint), GL_UNSIGNED_INT, 0);
+GLsizeiptr Mesh::getIndexSize() const {
+	return (m_index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+void Mesh::optimize() {
+	MeshOptimizer::weld(m_vertices, m_indexes);
+	MeshOptimizer::optimizeVertexCache(m_indexes, m_vertices.size());
+	MeshOptimizer::optimizeVertexFetch(m_vertices, m_indexes);
+}
+
+unsigned int Mesh::getNumLods() const {
+	return static_cast<unsigned int>(m_lods.size());
 }
 
 std::vector<glm::vec3> Mesh::getVertices() const {
@@ -68,34 +281,46 @@ void Mesh::setTexture(std::weak_ptr<Texture> texture){
 		m_texture = texture_sp;
 }
 
+const Texture* Mesh::getTexture() const {
+	return m_texture.get();
+}
+
 /// Line function definitions
 Line::Line() {
+	m_layout = COLORED_LAYOUT;
 }
 Line::~Line() {
 }
+std::shared_ptr<Drawable> Line::clone() const {
+	std::shared_ptr<Line> line = std::make_shared<Line>(*this);
+	line->m_vao = 0;
+	line->m_vbo = 0;
+	return line;
+}
 void Line::createVao() {
-	if (glIsVertexArray(m_vao))
-		glDeleteVertexArrays(1, &m_vao);
+	deleteBuffers();
+	computeBounds();
 
 	glGenVertexArrays(1, &m_vao);
 	glBindVertexArray(m_vao);
 
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Mesh::VertexFormat) * this->m_vertices.size(), &(this->m_vertices[0]), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::VertexFormat), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Mesh::VertexFormat), (void*)(offsetof(Mesh::VertexFormat, Mesh::VertexFormat::color)));
+	writeVertexBuffer();
+	RenderQueue::setInstanceAttributes();
 }
 
 void Line::draw(const std::weak_ptr<Shader> shader) const {
 	glBindVertexArray(m_vao);
+	drawGeometry(0);
+}
+
+void Line::drawGeometry(unsigned int lod) const {
 	glDrawArrays(GL_LINES, 0, m_vertices.size());
 }
 
+void Line::drawGeometryInstanced(unsigned int lod, GLsizei count, GLuint base_instance) const {
+	glDrawArraysInstancedBaseInstance(GL_LINES, 0, m_vertices.size(), count, base_instance);
+}
+
 std::vector<glm::vec3> Line::getVertices() const {
 	std::vector<glm::vec3> vertices;
 	for (int i = 0; i < m_vertices.size(); ++i) {
@@ -37,33 +37,133 @@ struct Drawable {
 		glm::vec4 weights;
 	};
 
+	/// Layouts of the vertex buffers
+	// The vertices are edited in the VertexFormat above and packed in the layout of the drawable when its vertex array is created.
+	// The attributes keep the locations read by the shaders, the ones a layout does not store are disabled
+	enum VertexLayout {
+		// Position, RGBA8 color, 10-10-10-2 normal and half float texcoords (u, v) : 24 bytes
+		STATIC_LAYOUT,
+		// Static layout followed by uint8 bones indexes and unorm8 weights : 32 bytes
+		SKINNED_LAYOUT,
+		// Position and RGBA8 color : 16 bytes
+		COLORED_LAYOUT,
+		// Skinned layout with uint16 bones indexes, for the skeletons of more than 256 bones : 36 bytes
+		WIDE_SKINNED_LAYOUT
+	};
+
+	struct StaticVertex {
+		glm::vec3 point;
+		GLuint color;
+		GLuint normal;
+		GLuint texcoord;
+	};
+
+	struct SkinnedVertex {
+		glm::vec3 point;
+		GLuint color;
+		GLuint normal;
+		GLuint texcoord;
+		GLubyte bones_indexes[4];
+		GLuint weights;
+	};
+
+	struct WideSkinnedVertex {
+		glm::vec3 point;
+		GLuint color;
+		GLuint normal;
+		GLuint texcoord;
+		GLushort bones_indexes[4];
+		GLuint weights;
+	};
+
+	struct ColoredVertex {
+		glm::vec3 point;
+		GLuint color;
+	};
+
 	Drawable();
 	virtual ~Drawable();
 
 	virtual void createVao() = 0;
+	// Copy of the vertices (and indexes) without the GL objects, used when an instance modifies a shared geometry
+	virtual std::shared_ptr<Drawable> clone() const = 0;
 	virtual void draw(const std::weak_ptr<Shader> shader) const = 0;
+	// Issue the draw call of a level of details, the vertex array and the texture must be bound
+	virtual void drawGeometry(unsigned int lod) const = 0;
+	// Draw count instances reading their attributes from base_instance in the instance buffer
+	virtual void drawGeometryInstanced(unsigned int lod, GLsizei count, GLuint base_instance) const = 0;
+	// Number of levels of details, the level 0 is the full resolution
+	virtual unsigned int getNumLods() const {
+		return 1;
+	}
+
+	virtual const Texture* getTexture() const {
+		return nullptr;
+	}
 
 	virtual std::vector<glm::vec3> getVertices() const = 0;
 	
+protected:
+	void deleteBuffers();
+	// Compute the local bounds of the vertices, called when the vertex array is created
+	void computeBounds();
+	// Pack the vertices in m_layout, upload them in a new vertex buffer and set the attributes of the vertex array bound
+	void writeVertexBuffer();
 
 public:
 	GLuint m_vao;
+	GLuint m_vbo;
 	std::vector<VertexFormat> m_vertices;
+	// Static for the meshes and colored for the lines by default, set before the vertex array is created
+	VertexLayout m_layout;
+
+	// Axis aligned bounds of the vertices in the space of the mesh
+	glm::vec3 m_min_point;
+	glm::vec3 m_max_point;
 };
 
 struct Mesh : public Drawable {
 public:
+	// Range of the element buffer drawn for a level of details
+	struct Lod {
+		GLuint first_index;
+		GLsizei num_indexes;
+	};
+
 	Mesh();
 	virtual ~Mesh();
 
+	// Simplify the triangles into the levels of details, each one keeping about ratios[i] of the triangles of m_indexes
+	// Must be called before createVao. Stops when the mesh cannot be simplified anymore
+	void generateLods(const std::vector<float>& ratios);
+	// Weld the identical vertices and reorder the triangles and the vertices for the caches of the GPU (see MeshOptimizer)
+	// Must be called before generateLods
+	void optimize();
+
 	void createVao();
+	std::shared_ptr<Drawable> clone() const;
 	void draw(const std::weak_ptr<Shader> shader) const;
+	void drawGeometry(unsigned int lod) const;
+	void drawGeometryInstanced(unsigned int lod, GLsizei count, GLuint base_instance) const;
+	unsigned int getNumLods() const;
 	std::vector<glm::vec3> getVertices() const;
 
 	void setTexture(std::weak_ptr<Texture> texture);
+	const Texture* getTexture() const;
+
+private:
+	// Bytes of an index in the element buffer
+	GLsizeiptr getIndexSize() const;
 
 public:
 	std::vector<GLuint> m_indexes;
+	// Indexes of the simplified levels of details. They reference the same vertices as m_indexes
+	std::vector<std::vector<GLuint>> m_lod_indexes;
+	GLuint m_ibo;
+	// Ranges of the levels in the element buffer, which holds m_indexes followed by m_lod_indexes
+	std::vector<Lod> m_lods;
+	// GL_UNSIGNED_SHORT when all the vertices can be indexed on 16 bits, GL_UNSIGNED_INT otherwise
+	GLenum m_index_type;
 
 	// Two meshes can reference the same texture => shared_ptr
 	GLuint m_material_index;
@@ -76,7 +176,10 @@ public:
 	virtual ~Line();
 
 	void createVao();
+	std::shared_ptr<Drawable> clone() const;
 	void draw(const std::weak_ptr<Shader> shader) const;
+	void drawGeometry(unsigned int lod) const;
+	void drawGeometryInstanced(unsigned int lod, GLsizei count, GLuint base_instance) const;
 	std::vector<glm::vec3> getVertices() const;
 };
 
@@ -0,0 +1,195 @@
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+#include "Trace.h"
+
+namespace {
+	// Size of the LRU cache modeled by the optimization and the scores of its positions (Forsyth)
+	const int max_cache_size = 32;
+	const float cache_decay_power = 1.5f;
+	const float last_triangle_score = 0.75f;
+	// The vertices with few remaining triangles are favoured, so that no isolated triangle is left behind
+	const float valence_boost_scale = 2.f;
+	const float valence_boost_power = 0.5f;
+
+	std::string getBytes(const void* data, size_t size) {
+		return std::string(static_cast<const char*>(data), size);
+	}
+
+	float computeVertexScore(int cache_position, unsigned int num_remaining_triangles) {
+		// The vertex is not used anymore
+		if (num_remaining_triangles == 0)
+			return -1.f;
+
+		float score = 0.f;
+		if (cache_position >= 0) {
+			// The vertices of the last triangle get a fixed score, so that the next one does not only reuse its edges
+			if (cache_position < 3) {
+				score = last_triangle_score;
+			}
+			else {
+				const float scaler = 1.f / (max_cache_size - 3);
+				score = std::pow(1.f - (cache_position - 3) * scaler, cache_decay_power);
+			}
+		}
+		score += valence_boost_scale * std::pow(static_cast<float>(num_remaining_triangles), -valence_boost_power);
+		return score;
+	}
+}
+
+size_t MeshOptimizer::weld(std::vector<Mesh::VertexFormat>& vertices, std::vector<GLuint>& indexes) {
+	TRACE_SCOPE("MeshOptimizer::weld");
+	std::vector<Mesh::VertexFormat> welded_vertices;
+	std::vector<GLuint> remap(vertices.size());
+	std::unordered_map<std::string, GLuint> vertex_map;
+	for (GLuint i = 0; i < vertices.size(); ++i) {
+		std::pair<std::unordered_map<std::string, GLuint>::iterator, bool> vertex =
+			vertex_map.emplace(getBytes(&vertices[i], sizeof(Mesh::VertexFormat)), static_cast<GLuint>(welded_vertices.size()));
+		if (vertex.second)
+			welded_vertices.push_back(vertices[i]);
+		remap[i] = vertex.first->second;
+	}
+
+	for (GLuint& index : indexes) {
+		index = remap[index];
+	}
+
+	size_t num_removed = vertices.size() - welded_vertices.size();
+	vertices.swap(welded_vertices);
+	return num_removed;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<GLuint>& indexes, size_t num_vertices) {
+	TRACE_SCOPE("MeshOptimizer::optimizeVertexCache");
+	const size_t num_triangles = indexes.size() / 3;
+	if (num_triangles == 0)
+		return;
+
+	/// Triangles of each vertex
+	std::vector<unsigned int> num_remaining(num_vertices, 0);
+	for (GLuint index : indexes) {
+		num_remaining[index]++;
+	}
+	std::vector<unsigned int> offsets(num_vertices + 1, 0);
+	for (size_t i = 0; i < num_vertices; ++i) {
+		offsets[i + 1] = offsets[i] + num_remaining[i];
+	}
+	// The triangles of a vertex are in [offsets[v], offsets[v] + num_remaining[v]), the emitted ones are removed
+	std::vector<unsigned int> vertex_triangles(indexes.size());
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indexes.size(); ++i) {
+		vertex_triangles[fill[indexes[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<float> vertex_scores(num_vertices);
+	for (size_t i = 0; i < num_vertices; ++i) {
+		vertex_scores[i] = computeVertexScore(-1, num_remaining[i]);
+	}
+	std::vector<bool> emitted(num_triangles, false);
+
+	// The cache holds 3 more vertices than its size while the new triangle is inserted
+	std::vector<GLuint> cache;
+	std::vector<GLuint> new_cache;
+	cache.reserve(max_cache_size + 3);
+	new_cache.reserve(max_cache_size + 3);
+
+	std::vector<GLuint> optimized;
+	optimized.reserve(indexes.size());
+	// Next triangle to consider when no triangle of the cache is left
+	size_t next_triangle = 0;
+	int best_triangle = -1;
+
+	while (optimized.size() < indexes.size()) {
+		if (best_triangle < 0) {
+			// No triangle of the cache is left, restart from the first remaining one in the input order.
+			// Searching the best one of the mesh would make the optimization quadratic on meshes made of many parts
+			while (emitted[next_triangle])
+				next_triangle++;
+			best_triangle = static_cast<int>(next_triangle);
+		}
+
+		/// Emit the triangle
+		const GLuint* triangle = &indexes[3 * best_triangle];
+		emitted[best_triangle] = true;
+		new_cache.clear();
+		for (unsigned int k = 0; k < 3; ++k) {
+			GLuint vertex = triangle[k];
+			optimized.push_back(vertex);
+			new_cache.push_back(vertex);
+
+			// Remove the triangle from the remaining ones of its vertices
+			unsigned int* triangles = &vertex_triangles[offsets[vertex]];
+			unsigned int* last = triangles + num_remaining[vertex];
+			*std::find(triangles, last, static_cast<unsigned int>(best_triangle)) = *(last - 1);
+			num_remaining[vertex]--;
+		}
+
+		// The vertices of the triangle move to the front of the LRU cache
+		for (GLuint vertex : cache) {
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				new_cache.push_back(vertex);
+		}
+		cache.swap(new_cache);
+		// The vertices pushed out of the cache lose their cache score
+		for (size_t i = max_cache_size; i < cache.size(); ++i) {
+			vertex_scores[cache[i]] = computeVertexScore(-1, num_remaining[cache[i]]);
+		}
+		if (cache.size() > max_cache_size)
+			cache.resize(max_cache_size);
+
+		/// Update the scores of the vertices of the cache and pick the best of their remaining triangles
+		for (size_t i = 0; i < cache.size(); ++i) {
+			vertex_scores[cache[i]] = computeVertexScore(static_cast<int>(i), num_remaining[cache[i]]);
+		}
+
+		best_triangle = -1;
+		float best_score = -1.f;
+		for (GLuint vertex : cache) {
+			for (unsigned int j = offsets[vertex]; j < offsets[vertex] + num_remaining[vertex]; ++j) {
+				unsigned int t = vertex_triangles[j];
+				float score = vertex_scores[indexes[3 * t]] + vertex_scores[indexes[3 * t + 1]] + vertex_scores[indexes[3 * t + 2]];
+				if (score > best_score) {
+					best_score = score;
+					best_triangle = static_cast<int>(t);
+				}
+			}
+		}
+	}
+
+	indexes.swap(optimized);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Mesh::VertexFormat>& vertices, std::vector<GLuint>& indexes) {
+	TRACE_SCOPE("MeshOptimizer::optimizeVertexFetch");
+	const GLuint unused = static_cast<GLuint>(-1);
+	std::vector<GLuint> remap(vertices.size(), unused);
+	std::vector<Mesh::VertexFormat> ordered_vertices;
+	ordered_vertices.reserve(vertices.size());
+	for (GLuint& index : indexes) {
+		if (remap[index] == unused) {
+			remap[index] = static_cast<GLuint>(ordered_vertices.size());
+			ordered_vertices.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered_vertices);
+}
+
+float MeshOptimizer::computeCacheMissRatio(const std::vector<GLuint>& indexes, size_t num_vertices, unsigned int cache_size) {
+	if (indexes.size() < 3)
+		return 0.f;
+
+	// Time at which each vertex entered the FIFO, it is still in the cache if less than cache_size vertices came after it
+	std::vector<size_t> entry_times(num_vertices, 0);
+	size_t num_misses = 0;
+	for (GLuint index : indexes) {
+		if (entry_times[index] == 0 || num_misses - entry_times[index] >= cache_size) {
+			num_misses++;
+			entry_times[index] = num_misses;
+		}
+	}
+	return static_cast<float>(num_misses) / (indexes.size() / 3);
+}
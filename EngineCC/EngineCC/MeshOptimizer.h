@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "Mesh.h"
+
+/// Optimization of the indexed triangles of a mesh for the GPU
+// - weld : the identical vertices (same position and attributes) are merged, the triangles imported by assimp
+//   have their own three vertices otherwise
+// - optimizeVertexCache : the triangles are reordered so that their vertices are still in the post-transform cache
+//   of the GPU when they are reused (Forsyth, linear-speed vertex cache optimisation), the vertex shader runs less often
+// - optimizeVertexFetch : the vertices are reordered by first use, the triangles read the vertex buffer almost linearly
+// The average cache miss ratio (vertices transformed per triangle) measures the result, from 3 for non indexed triangles
+// down to about 0.5 for a regular grid.
+class MeshOptimizer {
+public:
+	// Size of the FIFO cache used to measure the cache miss ratios
+	static const unsigned int measure_cache_size = 16;
+
+	// Merge the identical vertices and index them, returns the number of vertices removed
+	static size_t weld(std::vector<Mesh::VertexFormat>& vertices, std::vector<GLuint>& indexes);
+	// Reorder the triangles, the indexes stay in the range of num_vertices
+	static void optimizeVertexCache(std::vector<GLuint>& indexes, size_t num_vertices);
+	// Reorder the vertices in the order the triangles use them and remap the indexes. The unused vertices are removed
+	static void optimizeVertexFetch(std::vector<Mesh::VertexFormat>& vertices, std::vector<GLuint>& indexes);
+
+	// Average number of vertices transformed per triangle with a FIFO post-transform cache
+	static float computeCacheMissRatio(const std::vector<GLuint>& indexes, size_t num_vertices, unsigned int cache_size = measure_cache_size);
+};
@@ -0,0 +1,245 @@
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+
+#include "MeshSimplifier.h"
+#include "Trace.h"
+
+namespace {
+	// Maximum number of collapse passes, each pass collapses independent edges
+	const unsigned int max_passes = 64;
+
+	// Symmetric 4x4 matrix. Evaluated at a point, it gives the sum of the squared distances to the planes it has been built from
+	struct Quadric {
+		Quadric() : a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0) {
+		}
+
+		void addPlane(double a, double b, double c, double d, double weight) {
+			a00 += weight * a * a; a01 += weight * a * b; a02 += weight * a * c; a03 += weight * a * d;
+			a11 += weight * b * b; a12 += weight * b * c; a13 += weight * b * d;
+			a22 += weight * c * c; a23 += weight * c * d;
+			a33 += weight * d * d;
+		}
+
+		void add(const Quadric& q) {
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+		}
+
+		double evaluate(const glm::vec3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x +
+				a11 * y * y + 2 * a12 * y * z + 2 * a13 * y +
+				a22 * z * z + 2 * a23 * z +
+				a33;
+		}
+
+		double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+	};
+
+	struct Collapse {
+		double cost;
+		GLuint from;
+		GLuint to;
+	};
+
+	std::string getBytes(const void* data, size_t size) {
+		return std::string(static_cast<const char*>(data), size);
+	}
+
+	// True if moving from onto to turns over one of the triangles around from that is not removed by the collapse
+	bool flips(const std::vector<Mesh::VertexFormat>& vertices, const std::vector<GLuint>& position_ids,
+			   const std::vector<GLuint>& indexes, const std::vector<GLuint>& offsets, const std::vector<GLuint>& triangles,
+			   GLuint from, GLuint to) {
+		for (GLuint i = offsets[from]; i < offsets[from + 1]; ++i) {
+			const GLuint* triangle = &indexes[3 * triangles[i]];
+			if (position_ids[triangle[0]] == position_ids[to] ||
+				position_ids[triangle[1]] == position_ids[to] ||
+				position_ids[triangle[2]] == position_ids[to])
+				continue;
+
+			glm::vec3 points[3];
+			glm::vec3 moved_points[3];
+			for (unsigned int k = 0; k < 3; ++k) {
+				points[k] = vertices[triangle[k]].point;
+				moved_points[k] = (triangle[k] == from) ? vertices[to].point : points[k];
+			}
+
+			glm::vec3 normal = glm::cross(points[1] - points[0], points[2] - points[0]);
+			glm::vec3 moved_normal = glm::cross(moved_points[1] - moved_points[0], moved_points[2] - moved_points[0]);
+			if (glm::dot(normal, moved_normal) <= 0.f)
+				return true;
+		}
+		return false;
+	}
+}
+
+std::vector<GLuint> MeshSimplifier::simplify(const std::vector<Mesh::VertexFormat>& vertices, const std::vector<GLuint>& indexes, size_t target_num_indexes) {
+	TRACE_SCOPE("MeshSimplifier::simplify");
+
+	/// Weld the vertices having the same attributes and group them by position
+	// The first vertex of a group of identical vertices represents all of them
+	std::vector<GLuint> canonical(vertices.size());
+	std::vector<GLuint> position_ids(vertices.size());
+	std::vector<unsigned int> num_wedges;
+	std::unordered_map<std::string, GLuint> vertex_map;
+	std::unordered_map<std::string, GLuint> position_map;
+	for (GLuint i = 0; i < vertices.size(); ++i) {
+		canonical[i] = vertex_map.emplace(getBytes(&vertices[i], sizeof(Mesh::VertexFormat)), i).first->second;
+
+		std::pair<std::unordered_map<std::string, GLuint>::iterator, bool> position =
+			position_map.emplace(getBytes(&vertices[i].point, sizeof(glm::vec3)), static_cast<GLuint>(num_wedges.size()));
+		if (position.second)
+			num_wedges.push_back(0);
+		position_ids[i] = position.first->second;
+
+		if (canonical[i] == i)
+			num_wedges[position_ids[i]]++;
+	}
+	const size_t num_positions = num_wedges.size();
+
+	std::vector<GLuint> result;
+	result.reserve(indexes.size());
+	for (size_t i = 0; i + 2 < indexes.size(); i += 3) {
+		GLuint a = canonical[indexes[i]], b = canonical[indexes[i + 1]], c = canonical[indexes[i + 2]];
+		if (position_ids[a] == position_ids[b] || position_ids[b] == position_ids[c] || position_ids[c] == position_ids[a])
+			continue;
+		result.push_back(a);
+		result.push_back(b);
+		result.push_back(c);
+	}
+
+	/// Lock the seams and the borders
+	std::vector<bool> locked(num_positions);
+	for (size_t p = 0; p < num_positions; ++p) {
+		locked[p] = num_wedges[p] > 1;
+	}
+
+	// An edge of a closed manifold mesh is shared by two triangles
+	std::unordered_map<uint64_t, unsigned int> edges;
+	for (size_t i = 0; i < result.size(); ++i) {
+		uint64_t a = position_ids[result[i]];
+		uint64_t b = position_ids[result[(i % 3 == 2) ? i - 2 : i + 1]];
+		edges[(std::min(a, b) << 32) | std::max(a, b)]++;
+	}
+	for (std::unordered_map<uint64_t, unsigned int>::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+		if (it->second != 2) {
+			locked[it->first >> 32] = true;
+			locked[it->first & 0xFFFFFFFF] = true;
+		}
+	}
+
+	/// Quadrics of the planes of the triangles around each position, weighted by their area
+	std::vector<Quadric> quadrics(num_positions);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		const glm::vec3& p0 = vertices[result[i]].point;
+		glm::vec3 normal = glm::cross(vertices[result[i + 1]].point - p0, vertices[result[i + 2]].point - p0);
+		float length = glm::length(normal);
+		if (length == 0.f)
+			continue;
+
+		normal /= length;
+		double area = 0.5 * length;
+		double d = -glm::dot(normal, p0);
+		for (unsigned int k = 0; k < 3; ++k) {
+			quadrics[position_ids[result[i + k]]].addPlane(normal.x, normal.y, normal.z, d, area);
+		}
+	}
+
+	/// Collapse passes
+	// Each pass sorts the possible collapses by cost and applies the cheapest ones that do not touch the same triangles
+	const size_t target_num_triangles = target_num_indexes / 3;
+	std::vector<GLuint> offsets;
+	std::vector<GLuint> triangles;
+	std::vector<GLuint> remap(vertices.size());
+	std::vector<bool> touched(num_positions);
+	std::vector<Collapse> collapses;
+	for (unsigned int pass = 0; pass < max_passes && result.size() / 3 > target_num_triangles; ++pass) {
+		size_t num_triangles = result.size() / 3;
+
+		// Triangles around each vertex
+		offsets.assign(vertices.size() + 1, 0);
+		for (size_t i = 0; i < result.size(); ++i) {
+			offsets[result[i] + 1]++;
+		}
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		triangles.resize(result.size());
+		std::vector<GLuint> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i) {
+			triangles[cursor[result[i]]++] = static_cast<GLuint>(i / 3);
+		}
+
+		// An unlocked vertex is the only vertex at its position, it can be moved onto any of its neighbours
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); ++i) {
+			GLuint a = result[i];
+			GLuint b = result[(i % 3 == 2) ? i - 2 : i + 1];
+			GLuint pa = position_ids[a], pb = position_ids[b];
+
+			if (!locked[pa]) {
+				Quadric q = quadrics[pa];
+				q.add(quadrics[pb]);
+				Collapse collapse = { q.evaluate(vertices[b].point), a, b };
+				collapses.push_back(collapse);
+			}
+			if (!locked[pb]) {
+				Quadric q = quadrics[pb];
+				q.add(quadrics[pa]);
+				Collapse collapse = { q.evaluate(vertices[a].point), b, a };
+				collapses.push_back(collapse);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.cost < b.cost;
+		});
+
+		std::fill(touched.begin(), touched.end(), false);
+		std::iota(remap.begin(), remap.end(), 0);
+		size_t num_removed = 0;
+		size_t num_collapses = 0;
+		for (size_t i = 0; i < collapses.size() && num_removed < num_triangles - target_num_triangles; ++i) {
+			const Collapse& collapse = collapses[i];
+			GLuint from_position = position_ids[collapse.from];
+			GLuint to_position = position_ids[collapse.to];
+			if (touched[from_position] || touched[to_position])
+				continue;
+			if (flips(vertices, position_ids, result, offsets, triangles, collapse.from, collapse.to))
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[to_position].add(quadrics[from_position]);
+
+			// The triangles around the moved vertex must not change again in this pass
+			for (GLuint k = offsets[collapse.from]; k < offsets[collapse.from + 1]; ++k) {
+				const GLuint* triangle = &result[3 * triangles[k]];
+				touched[position_ids[triangle[0]]] = true;
+				touched[position_ids[triangle[1]]] = true;
+				touched[position_ids[triangle[2]]] = true;
+			}
+
+			// A collapse inside the mesh removes the two triangles sharing the edge
+			num_removed += 2;
+			num_collapses++;
+		}
+
+		if (num_collapses == 0)
+			break;
+
+		size_t num_indexes = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			GLuint a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (position_ids[a] == position_ids[b] || position_ids[b] == position_ids[c] || position_ids[c] == position_ids[a])
+				continue;
+			result[num_indexes++] = a;
+			result[num_indexes++] = b;
+			result[num_indexes++] = c;
+		}
+		result.resize(num_indexes);
+	}
+
+	return result;
+}
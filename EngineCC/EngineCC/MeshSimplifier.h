@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+#include "Mesh.h"
+
+/// Mesh simplification by quadric error metric (Garland & Heckbert)
+// The edges are collapsed onto one of their existing vertices, so the simplified triangles only reference vertices
+// of the original vertex buffer : the levels of details share its buffer and keep the texcoords and the bones of the vertices.
+// The vertices are first welded by position to recover the topology of the non indexed meshes imported by assimp.
+// A vertex is locked (never removed) when it lies on a seam, i.e. its position is shared by vertices with different
+// attributes (texcoords, normals, bones indexes or weights), or on a border of the mesh.
+class MeshSimplifier {
+public:
+	// Indexes of a simplified version of the triangles with about target_num_indexes indexes.
+	// Less triangles may not be removed when the remaining vertices are locked or the collapses would flip triangles
+	static std::vector<GLuint> simplify(const std::vector<Mesh::VertexFormat>& vertices, const std::vector<GLuint>& indexes, size_t target_num_indexes);
+};
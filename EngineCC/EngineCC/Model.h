@@ -3,8 +3,11 @@
 #include <string>
 #include <map>
 #include <queue>
-#include <chrono>
+#include <cmath>
 #include <ctime>
+#include <algorithm>
+#include <cctype>
+#include <sstream>
 
 /// Assimp includes
 // C++ importer interface
@@ -17,94 +20,336 @@
 #include "Primitive.h"
 #include "Mesh.h"
 #include "BoundingBox.h"
-
-class Model : public Primitive {
+#include "Trace.h"
+#include "AssetCache.h"
+#include "AnimationClip.h"
+#include "MeshOptimizer.h"
+#include "AssetLoader.h"
+#include "Cube.h"
+#include "BinaryFile.h"
+
+/// Mesh cache
+// The result of the import (meshes optimized with their levels of details, materials, skeleton and animation clip)
+// is written next to the model file in <file>.meshcache. The next imports read it instead of running assimp.
+// Header : magic number, version, key. The key is a hash of the content of the file (and of the .md5anim of a .md5mesh,
+// of the .mtl of a .obj), of the import flags and of the sizes of the structures copied in the file, a cache whose key differs is imported again
+#define MODEL_CACHE_MAGIC 0x484D4345
+#define MODEL_CACHE_VERSION 2
+#define MODEL_IMPORT_FLAGS (aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs)
+
+/// Data of a model file, imported once and shared by all the models of this file
+// It contains what does not change from one instance to the other : the GPU buffers of the meshes,
+// their materials and the skeleton. The animation state is kept by each Model
+class ModelData {
 public:
-	Model(const std::string& filename) : m_filename(filename) {
-		this->load();
+	ModelData(const std::string& filename) : m_filename(filename),
+											 m_scene(nullptr),
+											 m_animated(false),
+											 m_num_uploaded(0),
+											 m_ready(false) {
 	}
-	Model() : m_scene(NULL),
-			  m_animated(false), 
-			  m_start(std::chrono::high_resolution_clock::now()) {
-	}
-	~Model() {
+	~ModelData() {
 	}
 
-	void setTexture(const std::string& filepath) {
-		return;
+	// Data of the file, imported on the first request
+	// The file is imported on a worker thread and its meshes are uploaded by the AssetLoader, m_ready tells when they can be drawn
+	static std::shared_ptr<ModelData> getShared(const std::string& filename) {
+		AssetCache<std::string, ModelData>& models = AssetCache<std::string, ModelData>::getInstance();
+		return models.get(getCanonicalPath(filename), [&filename]() {
+			std::shared_ptr<ModelData> data = std::make_shared<ModelData>(filename);
+			// The job keeps the data alive until its upload, so that it is always released on the main thread
+			data->m_job = AssetLoader::getInstance().load([data]() {
+				data->import();
+			}, [data]() {
+				return data->upload();
+			});
+			return data;
+		});
 	}
 
-	inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4& from) const
-	{
-		glm::mat4 to;
-
-		to[0][0] = (GLfloat)from.a1; to[0][1] = (GLfloat)from.b1;  to[0][2] = (GLfloat)from.c1; to[0][3] = (GLfloat)from.d1;
-		to[1][0] = (GLfloat)from.a2; to[1][1] = (GLfloat)from.b2;  to[1][2] = (GLfloat)from.c2; to[1][3] = (GLfloat)from.d2;
-		to[2][0] = (GLfloat)from.a3; to[2][1] = (GLfloat)from.b3;  to[2][2] = (GLfloat)from.c3; to[2][3] = (GLfloat)from.d3;
-		to[3][0] = (GLfloat)from.a4; to[3][1] = (GLfloat)from.b4;  to[3][2] = (GLfloat)from.c4; to[3][3] = (GLfloat)from.d4;
-
-		return to;
-	}
-
-	virtual std::vector<glm::vec3> getVertices() const {
-		std::vector<glm::vec3> vertices;
-		//glm::mat4& glm_globalRootTransform = aiMatrix4x4ToGlm(m_scene->mRootNode->mTransformation);
-		glm::mat4& glm_globalRootTransform = aiMatrix4x4ToGlm(m_scene->mRootNode->mTransformation.Inverse());
-		for (int i = 0; i < m_meshes.size(); ++i) {
-			std::vector<glm::vec3>& vertices_current_mesh = m_meshes[i]->getVertices();
-			// A loaded model contains a m_globalRootTransform that must be applied to the vertices before computing the convex hull collision shape
-			for (int j = 0; j < vertices_current_mesh.size(); ++j) {
-				vertices_current_mesh[j] = glm::vec3(glm_globalRootTransform * glm::vec4(vertices_current_mesh[j], 1.f));
-			}
-
-			vertices.insert(vertices.end(), vertices_current_mesh.begin(), vertices_current_mesh.end());
+	// Import the file and prepare its meshes without any OpenGL call, run on a worker thread
+	void import() {
+		TRACE_SCOPE("Model::import");
+		const std::string cache_filename = m_filename + ".meshcache";
+		const uint64_t key = computeCacheKey();
+		if (readCache(cache_filename, key)) {
+			std::cout << m_filename << " read from the mesh cache" << std::endl;
+			computeCollisionVertices();
+			return;
 		}
-		return vertices;
-	}
 
-	void load() {
-		m_scene = m_Importer.ReadFile(m_filename.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+		m_scene = m_Importer.ReadFile(m_filename.c_str(), MODEL_IMPORT_FLAGS);
 
 		if (m_scene) {
 			loadVerticesData();
 			m_globalRootTransform = m_scene->mRootNode->mTransformation.Inverse();
+			m_rootTransform = m_scene->mRootNode->mTransformation;
 
 			m_animated = m_scene->HasAnimations();
-			const std::vector<std::shared_ptr<Texture>>& materials = loadMaterials();
-
-			// Give to each mesh its texture 
+			if (m_animated)
+				m_clip = std::make_unique<AnimationClip>(*m_scene->mAnimations[0]);
+			flattenSkeleton();
+			// The textures are requested by the upload, the asset caches are only used on the main thread
+			loadMaterials();
+
+			// The levels of details are generated once for all the models of the file
+			// The last one keeps a tenth of the triangles for the distant crowds
+			const std::vector<float> lod_ratios = { 0.5f, 0.25f, 0.1f };
+			// The vertices of the animated models keep their bones, packed on 8 bits unless the skeleton has more than 256 bones
+			const Drawable::VertexLayout skinned_layout = (m_bones_map.size() > 256) ? Drawable::WIDE_SKINNED_LAYOUT : Drawable::SKINNED_LAYOUT;
 			for (unsigned int i = 0; i < m_meshes.size(); ++i) {
 				Mesh& mesh = dynamic_cast<Mesh&>(*(m_meshes[i]));
-				GLuint material_index = mesh.m_material_index;
-				if (!materials.empty() && material_index < materials.size())
-					mesh.m_texture = materials[material_index];
-				else
-					std::cout << "material index out of range among the vector of textures load" << std::endl;
+				if (m_animated)
+					mesh.m_layout = skinned_layout;
+
+				// Average number of vertices transformed per triangle, 3 for the triangles imported by assimp
+				size_t num_vertices = mesh.m_vertices.size();
+				float miss_ratio = MeshOptimizer::computeCacheMissRatio(mesh.m_indexes, num_vertices);
+				mesh.optimize();
+				// The models are imported by the workers of the loader, the line is written at once so that it is not interleaved
+				std::ostringstream stats;
+				stats << m_filename << " mesh " << i << " : " << num_vertices << " -> " << mesh.m_vertices.size() << " vertices, cache miss ratio "
+					<< miss_ratio << " -> " << MeshOptimizer::computeCacheMissRatio(mesh.m_indexes, mesh.m_vertices.size()) << "\n";
+				std::cout << stats.str() << std::flush;
+
+				mesh.generateLods(lod_ratios);
 			}
 
-			this->writeBuffers();
+			// Everything has been converted, the assimp scene is released
+			m_Importer.FreeScene();
+			m_scene = nullptr;
+			computeCollisionVertices();
+
+			if (!writeCache(cache_filename, key))
+				std::cout << "Unable to write the mesh cache " << cache_filename << std::endl;
 		}
 		else {
+			// The model stays empty, the game goes on without it
 			printf("Error parsing '%s': '%s'\n", m_filename.c_str(), m_Importer.GetErrorString());
-			exit(1);
 		}
 	}
 
-	void draw(const std::weak_ptr<Shader> shader) {
-		updateBonesTransforms(m_globalRootTransform,
-							  m_scene->mRootNode,
-							  m_scene->mRootNode->mTransformation);
+	// Create the buffers of the next mesh and request its texture, run on the main thread.
+	// One mesh is uploaded per step of the AssetLoader, returns true once all of them are
+	bool upload() {
+		TRACE_SCOPE("Model::upload");
+		if (m_num_uploaded < m_meshes.size()) {
+			// Give to the mesh its texture
+			Mesh& mesh = dynamic_cast<Mesh&>(*(m_meshes[m_num_uploaded]));
+			GLuint material_index = mesh.m_material_index;
+			if (!m_material_files.empty() && material_index < m_material_files.size()) {
+				if (!m_material_files[material_index].empty())
+					mesh.m_texture = SimpleTexture::getShared(m_material_files[material_index]);
+			}
+			else {
+				std::cout << "material index out of range among the vector of textures load" << std::endl;
+			}
 
-		if (auto program = shader.lock()) {
-			glUniformMatrix4fv(program->getUniformLocation("bonesTransform"), m_transforms.size(), GL_TRUE, reinterpret_cast<const GLfloat*>(m_transforms.data()));
-			glUniform1i(program->getUniformLocation("animated"), static_cast<int>(m_animated));
+			mesh.createVao();
+			m_num_uploaded++;
 		}
-		Primitive::draw(shader);
+		if (m_num_uploaded < m_meshes.size())
+			return false;
+
+		m_ready = true;
+		return true;
 	}
 
 private:
-	const std::vector<std::shared_ptr<Texture>> loadMaterials() {
-		std::vector<std::shared_ptr<Texture>> materials(m_scene->mNumMaterials);
+	// Vertices of the meshes moved by the global root transform, the convex hulls of the collision shapes are built from them
+	void computeCollisionVertices() {
+		m_collision_vertices.clear();
+		for (unsigned int i = 0; i < m_meshes.size(); ++i) {
+			const Mesh& mesh = dynamic_cast<const Mesh&>(*(m_meshes[i]));
+			for (unsigned int j = 0; j < mesh.m_vertices.size(); ++j) {
+				const glm::vec3& point = mesh.m_vertices[j].point;
+				aiVector3D vertex = m_globalRootTransform * aiVector3D(point.x, point.y, point.z);
+				m_collision_vertices.push_back(glm::vec3(vertex.x, vertex.y, vertex.z));
+			}
+		}
+	}
+
+	/// Mesh cache
+	uint64_t computeCacheKey() const {
+		uint64_t key = hashBytes(nullptr, 0);
+		std::vector<std::string> sources(1, m_filename);
+		// The animations of a .md5mesh are imported from the .md5anim of the same name
+		const std::string md5_extension = ".md5mesh";
+		if (m_filename.size() > md5_extension.size() && m_filename.compare(m_filename.size() - md5_extension.size(), md5_extension.size(), md5_extension) == 0)
+			sources.push_back(m_filename.substr(0, m_filename.size() - md5_extension.size()) + ".md5anim");
+
+		// The materials of a .obj are read from the files of its mtllib lines, they are added to the sources while the .obj is hashed
+		const std::string obj_extension = ".obj";
+		const bool obj = m_filename.size() > obj_extension.size() && m_filename.compare(m_filename.size() - obj_extension.size(), obj_extension.size(), obj_extension) == 0;
+		for (unsigned int i = 0; i < sources.size(); ++i) {
+			MappedFile file;
+			if (!file.open(sources[i]))
+				continue;
+			key = hashBytes(file.getData(), file.getSize(), key);
+			if (i == 0 && obj)
+				findMaterialLibraries(file, sources);
+		}
+
+		// The vertices, the joints and the matrices are copied byte for byte, a change of their structures invalidates the caches
+		const uint32_t import_flags = MODEL_IMPORT_FLAGS;
+		const uint32_t sizes[] = { sizeof(Mesh::VertexFormat), sizeof(Joint), sizeof(aiMatrix4x4) };
+		key = hashBytes(sizes, sizeof(sizes), key);
+		return hashBytes(&import_flags, sizeof(import_flags), key);
+	}
+
+	// Add the files named by the mtllib lines of the .obj to libraries, relative to the directory of the .obj
+	// As assimp, the name is the rest of the line
+	void findMaterialLibraries(const MappedFile& file, std::vector<std::string>& libraries) const {
+		const std::string directory = m_filename.substr(0, m_filename.find_last_of("/\\") + 1);
+		const std::string keyword = "mtllib";
+		const char* line = reinterpret_cast<const char*>(file.getData());
+		const char* end = line + file.getSize();
+		while (line < end) {
+			const char* line_end = std::find(line, end, '\n');
+			if (static_cast<size_t>(line_end - line) > keyword.size() && std::equal(keyword.begin(), keyword.end(), line) &&
+				std::isspace(static_cast<unsigned char>(line[keyword.size()]))) {
+				const char* name = line + keyword.size();
+				const char* name_end = line_end;
+				while (name < name_end && std::isspace(static_cast<unsigned char>(*name)))
+					++name;
+				while (name_end > name && std::isspace(static_cast<unsigned char>(name_end[-1])))
+					--name_end;
+				if (name < name_end)
+					libraries.push_back(directory + std::string(name, name_end));
+			}
+			if (line_end == end)
+				break;
+			line = line_end + 1;
+		}
+	}
+
+	// Replace the data by the one of the cache, returns false if the cache is missing, outdated or truncated
+	bool readCache(const std::string& cache_filename, uint64_t key) {
+		TRACE_SCOPE("Model::readCache");
+		MappedFile file;
+		if (!file.open(cache_filename))
+			return false;
+
+		BinaryReader reader(file.getData(), file.getSize());
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint64_t cache_key = 0;
+		if (!reader.readValue(magic) || !reader.readValue(version) || !reader.readValue(cache_key) ||
+			magic != MODEL_CACHE_MAGIC || version != MODEL_CACHE_VERSION || cache_key != key)
+			return false;
+
+		if (!readCacheData(reader)) {
+			std::cout << "The mesh cache " << cache_filename << " is corrupted, the model is imported again" << std::endl;
+			m_clip.reset();
+			m_joints.clear();
+			m_bones_map.clear();
+			m_offset_bones.clear();
+			m_material_files.clear();
+			m_meshes.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool readCacheData(BinaryReader& reader) {
+		uint8_t animated = 0;
+		uint8_t has_clip = 0;
+		if (!reader.readValue(m_rootTransform) || !reader.readValue(m_globalRootTransform) ||
+			!reader.readValue(animated) || !reader.readValue(has_clip))
+			return false;
+		m_animated = animated != 0;
+		if (has_clip) {
+			m_clip = std::make_unique<AnimationClip>();
+			if (!m_clip->read(reader))
+				return false;
+		}
+
+		uint32_t num_bones = 0;
+		if (!reader.readArray(m_joints) || !reader.readArray(m_offset_bones) || !reader.readValue(num_bones))
+			return false;
+		for (uint32_t i = 0; i < num_bones; ++i) {
+			std::string name;
+			int32_t index = 0;
+			if (!reader.readString(name) || !reader.readValue(index))
+				return false;
+			m_bones_map[name] = index;
+		}
+
+		uint32_t num_materials = 0;
+		if (!reader.readValue(num_materials))
+			return false;
+		m_material_files.resize(num_materials);
+		for (uint32_t i = 0; i < num_materials; ++i) {
+			if (!reader.readString(m_material_files[i]))
+				return false;
+		}
+
+		uint32_t num_meshes = 0;
+		if (!reader.readValue(num_meshes))
+			return false;
+		for (uint32_t i = 0; i < num_meshes; ++i) {
+			std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+			uint32_t layout = 0;
+			uint32_t num_lods = 0;
+			if (!reader.readValue(layout) || !reader.readValue(mesh->m_material_index) ||
+				!reader.readArray(mesh->m_vertices) || !reader.readArray(mesh->m_indexes) || !reader.readValue(num_lods))
+				return false;
+			mesh->m_layout = static_cast<Drawable::VertexLayout>(layout);
+			mesh->m_lod_indexes.resize(num_lods);
+			for (uint32_t j = 0; j < num_lods; ++j) {
+				if (!reader.readArray(mesh->m_lod_indexes[j]))
+					return false;
+			}
+			m_meshes.push_back(mesh);
+		}
+		return true;
+	}
+
+	bool writeCache(const std::string& cache_filename, uint64_t key) const {
+		TRACE_SCOPE("Model::writeCache");
+		BinaryWriter writer;
+		writer.writeValue<uint32_t>(MODEL_CACHE_MAGIC);
+		writer.writeValue<uint32_t>(MODEL_CACHE_VERSION);
+		writer.writeValue(key);
+
+		writer.writeValue(m_rootTransform);
+		writer.writeValue(m_globalRootTransform);
+		writer.writeValue<uint8_t>(m_animated ? 1 : 0);
+		writer.writeValue<uint8_t>(m_clip ? 1 : 0);
+		if (m_clip)
+			m_clip->write(writer);
+
+		writer.writeArray(m_joints);
+		writer.writeArray(m_offset_bones);
+		writer.writeValue<uint32_t>(static_cast<uint32_t>(m_bones_map.size()));
+		for (std::map<std::string, int>::const_iterator it = m_bones_map.begin(); it != m_bones_map.end(); ++it) {
+			writer.writeString(it->first);
+			writer.writeValue<int32_t>(it->second);
+		}
+
+		writer.writeValue<uint32_t>(static_cast<uint32_t>(m_material_files.size()));
+		for (const std::string& material_file : m_material_files) {
+			writer.writeString(material_file);
+		}
+
+		writer.writeValue<uint32_t>(static_cast<uint32_t>(m_meshes.size()));
+		for (unsigned int i = 0; i < m_meshes.size(); ++i) {
+			const Mesh& mesh = dynamic_cast<const Mesh&>(*(m_meshes[i]));
+			writer.writeValue<uint32_t>(mesh.m_layout);
+			writer.writeValue(mesh.m_material_index);
+			writer.writeArray(mesh.m_vertices);
+			writer.writeArray(mesh.m_indexes);
+			writer.writeValue<uint32_t>(static_cast<uint32_t>(mesh.m_lod_indexes.size()));
+			for (const std::vector<GLuint>& lod_indexes : mesh.m_lod_indexes) {
+				writer.writeArray(lod_indexes);
+			}
+		}
+		return writer.save(cache_filename);
+	}
+
+	// Collect the diffuse texture file of each material, empty if it has none
+	void loadMaterials() {
+		m_material_files.assign(m_scene->mNumMaterials, std::string());
 		// Retrieve textures for the model
 		for (unsigned int i = 0; i < m_scene->mNumMaterials; i++) {
 			const aiMaterial* pMaterial = m_scene->mMaterials[i];
@@ -115,13 +360,10 @@ private:
 					std::string filename = "Content/";
 					filename += path.data;
 					std::cout << filename << std::endl;
-					materials[i] = std::make_shared<SimpleTexture>(filename);
-					assert(materials[i]->load());
+					m_material_files[i] = filename;
 				}
 			}
 		}
-
-		return materials;
 	}
 
 	void loadBones() {
@@ -147,93 +389,28 @@ private:
 		}
 	}
 
-	void computeRotationInterp(double elapsed_time_sec, double duration_anim_sec, aiNodeAnim* node_animation, aiQuaternion& rotation) {
-		double current_key = (elapsed_time_sec / duration_anim_sec) * node_animation->mNumRotationKeys;
-		unsigned int index = static_cast<unsigned int>(current_key);
-		double factor_interp = current_key - index;
-		
-		unsigned int prev = index % node_animation->mNumRotationKeys;
-		unsigned int next = (index + 1) % node_animation->mNumRotationKeys;
-
-		const aiQuaternion& start = node_animation->mRotationKeys[prev].mValue;
-		const aiQuaternion& end = node_animation->mRotationKeys[next].mValue;
-		
-		aiQuaternion::Interpolate(rotation, start, end, static_cast<float>(factor_interp));
-	}
-
-	void computeTranslationInterp(double elapsed_time_sec, double duration_anim_sec, aiNodeAnim* node_animation, aiVector3D& translation) {
-		double current_key = (elapsed_time_sec / duration_anim_sec) * node_animation->mNumPositionKeys;
-		unsigned int index = static_cast<unsigned int>(current_key);
-		float factor_interp = current_key - index;
-
-		unsigned int prev = index % node_animation->mNumPositionKeys;
-		unsigned int next = (index + 1) % node_animation->mNumPositionKeys;
-
-		aiVector3D& start = node_animation->mPositionKeys[prev].mValue;
-		aiVector3D& end = node_animation->mPositionKeys[next].mValue;
-
-		translation = end * factor_interp + start * (1 - factor_interp);
-	}
-
-	void computeScalingInterp(double elapsed_time_sec, double duration_anim_sec, aiNodeAnim* node_animation, aiVector3D& scaling) {
-		double current_key = (elapsed_time_sec / duration_anim_sec) * node_animation->mNumScalingKeys;
-		unsigned int index = static_cast<unsigned int>(current_key);
-		float factor_interp = current_key - index;
-
-		unsigned int prev = index % node_animation->mNumScalingKeys;
-		unsigned int next = (index + 1) % node_animation->mNumScalingKeys;
-
-		aiVector3D& start = node_animation->mScalingKeys[prev].mValue;
-		aiVector3D& end = node_animation->mScalingKeys[next].mValue;
-
-		scaling = end * factor_interp + start * (1 - factor_interp);
-	}
-
-	void updateBonesTransforms(const aiMatrix4x4& global_inv, aiNode* node, const aiMatrix4x4& parentTransform) {
-		// Find the corresponding bone by searching through the map : name -> int
-		// for the id first and then for the Bone in the indexed vector of Bones
-		if (node) {
-			const std::string& name = node->mName.C_Str();
-			aiMatrix4x4 transform = node->mTransformation;
-
-			if (m_bones_map.find(name) != m_bones_map.end()) {
-				int index = m_bones_map[name];
-
-				aiMatrix4x4 translation_mat, rotation_mat, scaling_mat;
-				double duration_ticks = m_scene->mAnimations[0]->mDuration;
-				double num_ticks_per_sec = m_scene->mAnimations[0]->mTicksPerSecond;
-				
-				double duration_anim_sec = duration_ticks / num_ticks_per_sec;
-
-				std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-				double elapsed_time_sec = std::chrono::duration_cast< std::chrono::duration<double> >(now - m_start).count();
-
-				for (unsigned int i = 0; i < m_scene->mAnimations[0]->mNumChannels; ++i) {
-					aiNodeAnim* node_animation = m_scene->mAnimations[0]->mChannels[i];
-					if (node_animation->mNodeName.C_Str() == name) {
-						aiVector3D scaling_vec;
-						this->computeScalingInterp(elapsed_time_sec, duration_anim_sec, node_animation, scaling_vec);
-						aiMatrix4x4::Scaling(scaling_vec, scaling_mat);
-						
-						aiQuaternion rotation_quat;
-						this->computeRotationInterp(elapsed_time_sec, duration_anim_sec, node_animation, rotation_quat);
-						rotation_mat = aiMatrix4x4(rotation_quat.GetMatrix());
-						
-						aiVector3D translation_vec;
-						this->computeTranslationInterp(elapsed_time_sec, duration_anim_sec, node_animation, translation_vec);
-						aiMatrix4x4::Translation(translation_vec, translation_mat);
-						
-						transform = translation_mat * rotation_mat * scaling_mat;
-
-						break;
-					}
-				}
-				
-				m_transforms[index] = global_inv * parentTransform * transform * m_offset_bones[index];
-			}
-
-			for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-				updateBonesTransforms(global_inv, node->mChildren[i], parentTransform * transform);
+	// Store the node tree in m_joints, each node after its parent, with its bone and its animation channel
+	void flattenSkeleton() {
+		// Depth first traversal, the parents are pushed before their children
+		std::vector<std::pair<const aiNode*, int>> stack(1, std::make_pair(m_scene->mRootNode, -1));
+		while (!stack.empty()) {
+			const aiNode* node = stack.back().first;
+			int parent = stack.back().second;
+			stack.pop_back();
+
+			const std::string name = node->mName.C_Str();
+			std::map<std::string, int>::const_iterator bone = m_bones_map.find(name);
+
+			Joint joint;
+			joint.parent = parent;
+			joint.bone = (bone != m_bones_map.end()) ? bone->second : -1;
+			joint.channel = m_clip ? m_clip->findChannel(name.c_str()) : -1;
+			joint.transform = node->mTransformation;
+
+			int index = static_cast<int>(m_joints.size());
+			m_joints.push_back(joint);
+			for (unsigned int i = node->mNumChildren; i > 0; --i) {
+				stack.push_back(std::make_pair(node->mChildren[i - 1], index));
 			}
 		}
 	}
@@ -241,9 +418,6 @@ private:
 	void loadVerticesData() {
 		this->loadBones();
 
-		m_transforms.clear();
-		m_transforms.resize(m_bones_map.size(), aiMatrix4x4());
-
 		aiVector3D zero(0.f, 0.f, 0.f);
 
 		//Vector indexed by ID vertices
@@ -251,12 +425,10 @@ private:
 		unsigned int starting_index = 0;
 		for (unsigned int i = 0; i < m_scene->mNumMeshes; ++i) {
 			const aiMesh* mesh = m_scene->mMeshes[i];
-			std::unique_ptr<Mesh> current_mesh = std::make_unique<Mesh>();
+			std::shared_ptr<Mesh> current_mesh = std::make_shared<Mesh>();
 
 			// Retrieve the data of the model which will be given to the VBO
-			// Test if the mesh has been correctly triangulated
-			assert(mesh->mNumVertices == mesh->mNumFaces * 3);
-
+			// The triangles imported by assimp do not share their vertices, they are welded once the bones are known
 			unsigned int num_vertices = mesh->mNumVertices;
 			for (unsigned int j = 0; j < num_vertices; ++j) {
 				// A mesh surely has vertices but not always normals nor texcoords
@@ -309,7 +481,7 @@ private:
 			// Retrieve the index of the material the mesh is referred to
 			current_mesh->m_material_index = mesh->mMaterialIndex;
 
-			m_meshes.push_back(std::move(current_mesh));
+			m_meshes.push_back(current_mesh);
 		}
 
 		starting_index = 0;
@@ -338,27 +510,259 @@ private:
 		}
 	}
 private:
-	// Assimp model importer
+	// Assimp model importer, it owns the scene
 	Assimp::Importer m_Importer;
 public:
-	// Name of the model to load
 	std::string m_filename;
 
+	// Only valid while the file is loaded
 	const aiScene* m_scene;
+	// Transform of the root node of the skeleton
+	aiMatrix4x4 m_rootTransform;
 	aiMatrix4x4 m_globalRootTransform;
+	bool m_animated;
+	// First animation of the file
+	std::unique_ptr<AnimationClip> m_clip;
+
+	// Node of the flattened skeleton
+	struct Joint {
+		// Index of the parent joint, lower than the index of the joint. -1 for the root node
+		int parent;
+		// Index in the bones transforms, -1 if no vertex depends on the node
+		int bone;
+		// Channel of the animation moving the node, -1 if it keeps its bind transform
+		int channel;
+		// Bind transform relative to the parent
+		aiMatrix4x4 transform;
+	};
 
 	// Bones infomation
+	// Nodes of the scene in topological order, the names are resolved once at load
+	std::vector<Joint> m_joints;
 	// A map between bones names and global indexes
 	std::map<std::string, int> m_bones_map;
 	// Offset matrices of all the bones indexed by the global bone index
 	std::vector<aiMatrix4x4> m_offset_bones;
+
+	std::vector<std::shared_ptr<Drawable>> m_meshes;
+
+	// Information of which vertices can be impacted by a bone
+	std::map<int, std::vector<Mesh::VertexFormat>> m_bones_vertices;
+
+	// Diffuse texture of each material, loaded by the upload
+	std::vector<std::string> m_material_files;
+
+	// Computed by the import, see Model::getVertices
+	std::vector<glm::vec3> m_collision_vertices;
+
+	// Import and upload of the file, see AssetLoader
+	std::shared_ptr<AssetLoader::Job> m_job;
+	// Meshes whose buffers are created, main thread only
+	size_t m_num_uploaded;
+	// Set once the meshes are uploaded, main thread only
+	bool m_ready;
+};
+
+class Model : public Primitive {
+public:
+	Model(const std::string& filename) : m_filename(filename),
+										 m_time(0.f),
+										 m_palette(nullptr),
+										 m_animated(false),
+										 m_loaded(false) {
+		this->load();
+	}
+	Model() : m_time(0.f),
+			  m_palette(nullptr),
+			  m_animated(false),
+			  m_loaded(false) {
+	}
+	~Model() {
+	}
+
+	void setTexture(const std::string& filepath) {
+		return;
+	}
+
+	inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4& from) const
+	{
+		glm::mat4 to;
+
+		to[0][0] = (GLfloat)from.a1; to[0][1] = (GLfloat)from.b1;  to[0][2] = (GLfloat)from.c1; to[0][3] = (GLfloat)from.d1;
+		to[1][0] = (GLfloat)from.a2; to[1][1] = (GLfloat)from.b2;  to[1][2] = (GLfloat)from.c2; to[1][3] = (GLfloat)from.d2;
+		to[2][0] = (GLfloat)from.a3; to[2][1] = (GLfloat)from.b3;  to[2][2] = (GLfloat)from.c3; to[2][3] = (GLfloat)from.d3;
+		to[3][0] = (GLfloat)from.a4; to[3][1] = (GLfloat)from.b4;  to[3][2] = (GLfloat)from.c4; to[3][3] = (GLfloat)from.d4;
+
+		return to;
+	}
+
+	// Vertices of the meshes with the global root transform applied, computed on the worker thread that imported the file.
+	// The vertices of the placeholder are returned until the model is loaded, the collision shapes are built in whenLoaded
+	virtual std::vector<glm::vec3> getVertices() const {
+		if (!m_loaded)
+			return Primitive::getVertices();
+		return m_data->m_collision_vertices;
+	}
+
+	// The bones transforms of an animated model contain the global root transform, the bind pose box is moved as the vertices
+	virtual BoundingBox getLocalBoundingBox() const {
+		BoundingBox box = Primitive::getLocalBoundingBox();
+		if (m_animated && m_data)
+			box = box.transform(aiMatrix4x4ToGlm(m_data->m_globalRootTransform));
+		return box;
+	}
+
+	// Read the vertices of a model file without creating any OpenGL resource
+	// The root transform of the model is applied as in getVertices
+	static std::vector<glm::vec3> readVertices(const std::string& filename) {
+		std::vector<glm::vec3> vertices;
+
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(filename.c_str(), aiProcess_Triangulate);
+		if (!scene) {
+			printf("Error parsing '%s': '%s'\n", filename.c_str(), importer.GetErrorString());
+			return vertices;
+		}
+
+		aiMatrix4x4 globalRootTransform = scene->mRootNode->mTransformation.Inverse();
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+			const aiMesh* mesh = scene->mMeshes[i];
+			for (unsigned int j = 0; j < mesh->mNumVertices; ++j) {
+				aiVector3D vertex = globalRootTransform * mesh->mVertices[j];
+				vertices.push_back(glm::vec3(vertex.x, vertex.y, vertex.z));
+			}
+		}
+		return vertices;
+	}
+
+	void load() {
+		// The file is only imported by the first model using it, a cube is drawn until its meshes are uploaded
+		m_data = ModelData::getShared(m_filename);
+		m_loaded = false;
+		m_animated = false;
+		m_meshes.assign(1, Cube::getSharedMesh());
+		finishLoading();
+	}
+
+	// Replace the placeholder by the meshes of the file once they are uploaded
+	virtual bool finishLoading() {
+		if (m_loaded || !m_data->m_ready)
+			return false;
+
+		m_meshes = m_data->m_meshes;
+		m_animated = m_data->m_animated;
+
+		m_transforms.clear();
+		m_transforms.resize(m_data->m_bones_map.size(), aiMatrix4x4());
+		if (m_data->m_clip)
+			m_data->m_clip->resetCursor(m_cursor);
+		m_loaded = true;
+
+		// A callback may request another one, the list is moved out before they run
+		std::vector<std::function<void()>> callbacks;
+		callbacks.swap(m_loaded_callbacks);
+		for (unsigned int i = 0; i < callbacks.size(); ++i)
+			callbacks[i]();
+		return true;
+	}
+
+	// The callbacks are run by finishLoading, called every frame by the RenderSystem
+	virtual void whenLoaded(const std::function<void()>& callback) {
+		if (m_loaded)
+			callback();
+		else
+			m_loaded_callbacks.push_back(callback);
+	}
+
+	// Block until the file is loaded, for the callers that need the model at once (e.g. the benchmarks)
+	void waitUntilLoaded() {
+		AssetLoader::getInstance().finish(m_data->m_job);
+		finishLoading();
+	}
+
+	bool isAnimated() const {
+		return m_loaded && m_data->m_clip;
+	}
+
+	unsigned int getNumBones() const {
+		return static_cast<unsigned int>(m_transforms.size());
+	}
+
+	// Move the animation forward, it loops
+	void advance(float dt) {
+		if (!isAnimated())
+			return;
+
+		float duration = m_data->m_clip->getDuration();
+		m_time = (duration > 0.f) ? std::fmod(m_time + dt, duration) : 0.f;
+	}
+
+	float getTime() const {
+		return m_time;
+	}
+
+	// Compute the transforms of the bones at the current time of the animation
+	void updateBonesTransforms() {
+		if (isAnimated())
+			evaluatePose(m_time, m_transforms.data());
+	}
+
+	// Write the transforms of the bones at time in palette (getNumBones() matrices)
+	// The joints are evaluated in one pass : the global transform of a parent is always computed before its children.
+	// Only the cursor and the joint transforms of this model are modified, the models can be evaluated concurrently
+	void evaluatePose(float time, aiMatrix4x4* palette) {
+		const AnimationClip& clip = *m_data->m_clip;
+		const std::vector<ModelData::Joint>& joints = m_data->m_joints;
+		const aiMatrix4x4& root_transform = m_data->m_rootTransform;
+		m_joint_transforms.resize(joints.size());
+		for (unsigned int i = 0; i < joints.size(); ++i) {
+			const ModelData::Joint& joint = joints[i];
+			const aiMatrix4x4& transform = (joint.channel >= 0) ? clip.sample(joint.channel, time, m_cursor) : joint.transform;
+
+			// The root node is relative to its own bind transform
+			const aiMatrix4x4& parent_transform = (joint.parent >= 0) ? m_joint_transforms[joint.parent] : root_transform;
+			m_joint_transforms[i] = parent_transform * transform;
+
+			if (joint.bone >= 0)
+				palette[joint.bone] = m_data->m_globalRootTransform * m_joint_transforms[i] * m_data->m_offset_bones[joint.bone];
+		}
+	}
+
+	// Bones transforms prepared by the AnimationSystem for the current frame, they must stay valid until the draws are flushed.
+	// Without palette, the model is drawn with its own transforms
+	void setPalette(const aiMatrix4x4* palette) {
+		m_palette = palette;
+	}
+
+	void submit(RenderQueue& queue, const RenderQueue::DrawItem& item) const override {
+		RenderQueue::DrawItem model_item = item;
+		if (m_animated) {
+			model_item.bones = reinterpret_cast<const GLfloat*>(m_palette ? m_palette : m_transforms.data());
+			model_item.num_bones = m_transforms.size();
+		}
+		Primitive::submit(queue, model_item);
+	}
+
+public:
+	// Name of the model to load
+	std::string m_filename;
+	// Shared with the other models of the same file
+	std::shared_ptr<const ModelData> m_data;
+
 	// Final transform of each bone to send to GPU indexed by the global bone index
 	std::vector<aiMatrix4x4> m_transforms;
+	// Global transform of each joint, kept to avoid allocating at each update
+	std::vector<aiMatrix4x4> m_joint_transforms;
 
 	// When animating a model
-	std::chrono::high_resolution_clock::time_point m_start;
+	// Seconds since the start of the animation, advanced by the AnimationSystem
+	float m_time;
+	const aiMatrix4x4* m_palette;
+	// Keys of the clip sampled by the last update
+	AnimationClip::Cursor m_cursor;
 	bool m_animated;
-
-	// Information of which vertices can be impacted by a bone
-	std::map<int, std::vector<Mesh::VertexFormat>> m_bones_vertices;
+	// False while the placeholder is drawn
+	bool m_loaded;
+	// Waiting for the meshes, see whenLoaded
+	std::vector<std::function<void()>> m_loaded_callbacks;
 };
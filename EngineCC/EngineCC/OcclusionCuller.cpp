@@ -0,0 +1,243 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <immintrin.h>
+
+#include "OcclusionCuller.h"
+#include "Primitive.h"
+#include "Trace.h"
+
+namespace {
+	// Clip space w under which a point is considered on or behind the near plane
+	const float min_w = 1e-3f;
+
+	// Twice the signed area of the triangle (a, b, p), positive when p is on the left of a -> b
+	float edgeFunction(const glm::vec3& a, const glm::vec3& b, float x, float y) {
+		return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+	}
+}
+
+/// OcclusionCuller definitions
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height) : m_width(width),
+																			 m_height(height),
+																			 m_view_projection(1.f) {
+	assert(width % 4 == 0);
+
+	unsigned int level_width = width;
+	unsigned int level_height = height;
+	while (true) {
+		m_levels.push_back(std::vector<float>(level_width * level_height, 1.f));
+		if (level_width == 1 || level_height == 1)
+			break;
+		level_width /= 2;
+		level_height /= 2;
+	}
+}
+
+OcclusionCuller::~OcclusionCuller() {
+}
+
+void OcclusionCuller::begin(const glm::mat4& view_projection) {
+	m_view_projection = view_projection;
+	std::fill(m_levels[0].begin(), m_levels[0].end(), 1.f);
+}
+
+void OcclusionCuller::rasterize(const std::vector<Mesh::VertexFormat>& vertices, const std::vector<GLuint>& indexes, const glm::mat4& model) {
+	TRACE_SCOPE("OcclusionCuller::rasterize");
+	glm::mat4 model_view_projection = m_view_projection * model;
+
+	// Each vertex is projected once, w < 0 marks the vertices behind the near plane
+	m_screen_vertices.resize(vertices.size());
+	for (unsigned int i = 0; i < vertices.size(); ++i) {
+		glm::vec4 clip = model_view_projection * glm::vec4(vertices[i].point, 1.f);
+		if (clip.w < min_w) {
+			m_screen_vertices[i] = glm::vec4(0.f, 0.f, 0.f, -1.f);
+			continue;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		m_screen_vertices[i] = glm::vec4((ndc.x * 0.5f + 0.5f) * m_width,
+										 (ndc.y * 0.5f + 0.5f) * m_height,
+										 ndc.z * 0.5f + 0.5f,
+										 1.f);
+	}
+
+	for (unsigned int i = 0; i + 2 < indexes.size(); i += 3) {
+		const glm::vec4& v0 = m_screen_vertices[indexes[i]];
+		const glm::vec4& v1 = m_screen_vertices[indexes[i + 1]];
+		const glm::vec4& v2 = m_screen_vertices[indexes[i + 2]];
+		if (v0.w < 0.f || v1.w < 0.f || v2.w < 0.f)
+			continue;
+
+		rasterizeTriangle(glm::vec3(v0), glm::vec3(v1), glm::vec3(v2));
+	}
+}
+
+void OcclusionCuller::rasterize(const Primitive& primitive, const glm::mat4& model) {
+	for (unsigned int i = 0; i < primitive.m_meshes.size(); ++i) {
+		if (const Mesh* mesh = dynamic_cast<const Mesh*>(primitive.m_meshes[i].get()))
+			rasterize(mesh->m_vertices, mesh->m_indexes, model);
+	}
+}
+
+void OcclusionCuller::rasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+	// Both faces are rasterized, the triangle is made counter clockwise
+	float area = edgeFunction(v0, v1, v2.x, v2.y);
+	if (std::fabs(area) < 1e-6f)
+		return;
+	const glm::vec3& a = v0;
+	const glm::vec3& b = area > 0.f ? v1 : v2;
+	const glm::vec3& c = area > 0.f ? v2 : v1;
+	area = std::fabs(area);
+
+	// Pixels whose center is inside the bounding rectangle of the triangle.
+	// The first column is aligned on 4 pixels so that the groups of 4 pixels never cross the end of a row
+	int min_x = std::max(static_cast<int>(std::floor(std::min(a.x, std::min(b.x, c.x)))), 0);
+	int max_x = std::min(static_cast<int>(std::ceil(std::max(a.x, std::max(b.x, c.x)))), static_cast<int>(m_width) - 1);
+	int min_y = std::max(static_cast<int>(std::floor(std::min(a.y, std::min(b.y, c.y)))), 0);
+	int max_y = std::min(static_cast<int>(std::ceil(std::max(a.y, std::max(b.y, c.y)))), static_cast<int>(m_height) - 1);
+	if (min_x > max_x || min_y > max_y)
+		return;
+	min_x &= ~3;
+
+	// The edge functions are linear in x : w(x + 1) = w(x) + dx
+	// w0 is the weight of a (edge b -> c), w1 of b (edge c -> a), w2 of c (edge a -> b)
+	float inv_area = 1.f / area;
+	float dx0 = b.y - c.y;
+	float dx1 = c.y - a.y;
+	float dx2 = a.y - b.y;
+
+	const __m128 offsets = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 step_x0 = _mm_set1_ps(4.f * dx0);
+	const __m128 step_x1 = _mm_set1_ps(4.f * dx1);
+	const __m128 step_x2 = _mm_set1_ps(4.f * dx2);
+	// Depth interpolated from the weights, z = z_a + w1 * (z_b - z_a) + w2 * (z_c - z_a) with normalized weights
+	const __m128 z_a = _mm_set1_ps(a.z);
+	const __m128 dz_b = _mm_set1_ps((b.z - a.z) * inv_area);
+	const __m128 dz_c = _mm_set1_ps((c.z - a.z) * inv_area);
+
+	std::vector<float>& depth = m_levels[0];
+	for (int y = min_y; y <= max_y; ++y) {
+		float py = y + 0.5f;
+		float px = min_x + 0.5f;
+		__m128 w0 = _mm_add_ps(_mm_set1_ps(edgeFunction(b, c, px, py)), _mm_mul_ps(offsets, _mm_set1_ps(dx0)));
+		__m128 w1 = _mm_add_ps(_mm_set1_ps(edgeFunction(c, a, px, py)), _mm_mul_ps(offsets, _mm_set1_ps(dx1)));
+		__m128 w2 = _mm_add_ps(_mm_set1_ps(edgeFunction(a, b, px, py)), _mm_mul_ps(offsets, _mm_set1_ps(dx2)));
+
+		float* row = &depth[y * m_width];
+		for (int x = min_x; x <= max_x; x += 4) {
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+			if (_mm_movemask_ps(inside) != 0) {
+				__m128 z = _mm_add_ps(z_a, _mm_add_ps(_mm_mul_ps(w1, dz_b), _mm_mul_ps(w2, dz_c)));
+				__m128 old_depth = _mm_loadu_ps(row + x);
+				__m128 new_depth = _mm_min_ps(old_depth, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+			}
+
+			w0 = _mm_add_ps(w0, step_x0);
+			w1 = _mm_add_ps(w1, step_x1);
+			w2 = _mm_add_ps(w2, step_x2);
+		}
+	}
+}
+
+void OcclusionCuller::buildHierarchy() {
+	TRACE_SCOPE("OcclusionCuller::buildHierarchy");
+	for (unsigned int level = 1; level < m_levels.size(); ++level) {
+		unsigned int width = m_width >> level;
+		unsigned int height = m_height >> level;
+		unsigned int src_width = m_width >> (level - 1);
+		const std::vector<float>& src = m_levels[level - 1];
+		std::vector<float>& dst = m_levels[level];
+
+		for (unsigned int y = 0; y < height; ++y) {
+			const float* row0 = &src[2 * y * src_width];
+			const float* row1 = row0 + src_width;
+			for (unsigned int x = 0; x < width; ++x) {
+				dst[y * width + x] = std::max(std::max(row0[2 * x], row0[2 * x + 1]), std::max(row1[2 * x], row1[2 * x + 1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::project(const BoundingBox& box, glm::vec2& min_point, glm::vec2& max_point, float& min_depth) const {
+	min_point = glm::vec2(std::numeric_limits<float>::max());
+	max_point = glm::vec2(-std::numeric_limits<float>::max());
+	min_depth = 1.f;
+	for (unsigned int i = 0; i < 8; ++i) {
+		glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+						 (i & 2) ? box.max.y : box.min.y,
+						 (i & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = m_view_projection * glm::vec4(corner, 1.f);
+		if (clip.w < min_w)
+			return false;
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 screen((ndc.x * 0.5f + 0.5f) * m_width, (ndc.y * 0.5f + 0.5f) * m_height);
+		min_point = glm::min(min_point, screen);
+		max_point = glm::max(max_point, screen);
+		min_depth = std::min(min_depth, ndc.z * 0.5f + 0.5f);
+	}
+	return true;
+}
+
+bool OcclusionCuller::isVisible(const BoundingBox& box) const {
+	glm::vec2 min_point, max_point;
+	float min_depth;
+	if (!project(box, min_point, max_point, min_depth))
+		return true;
+
+	// Pixels of the level 0 covered by the box
+	int min_x = std::max(static_cast<int>(std::floor(min_point.x)), 0);
+	int max_x = std::min(static_cast<int>(std::floor(max_point.x)), static_cast<int>(m_width) - 1);
+	int min_y = std::max(static_cast<int>(std::floor(min_point.y)), 0);
+	int max_y = std::min(static_cast<int>(std::floor(max_point.y)), static_cast<int>(m_height) - 1);
+	if (min_x > max_x || min_y > max_y)
+		return true;
+
+	// Level where the rectangle covers at most 2x2 texels
+	unsigned int size = static_cast<unsigned int>(std::max(max_x - min_x, max_y - min_y));
+	unsigned int level = 0;
+	while ((size >> level) > 1 && level + 1 < m_levels.size())
+		level++;
+
+	unsigned int width = m_width >> level;
+	const std::vector<float>& depth = m_levels[level];
+	float max_depth = 0.f;
+	for (int y = min_y >> level; y <= (max_y >> level); ++y) {
+		for (int x = min_x >> level; x <= (max_x >> level); ++x) {
+			max_depth = std::max(max_depth, depth[y * width + x]);
+		}
+	}
+
+	return min_depth <= max_depth;
+}
+
+float OcclusionCuller::getScreenArea(const BoundingBox& box) const {
+	glm::vec2 min_point, max_point;
+	float min_depth;
+	if (!project(box, min_point, max_point, min_depth))
+		return 1.f;
+
+	glm::vec2 size = glm::clamp(max_point, glm::vec2(0.f), glm::vec2(m_width, m_height)) -
+					 glm::clamp(min_point, glm::vec2(0.f), glm::vec2(m_width, m_height));
+	return (size.x * size.y) / (m_width * m_height);
+}
+
+unsigned int OcclusionCuller::getWidth() const {
+	return m_width;
+}
+
+unsigned int OcclusionCuller::getHeight() const {
+	return m_height;
+}
+
+float OcclusionCuller::getDepth(unsigned int level, unsigned int x, unsigned int y) const {
+	return m_levels[level][y * (m_width >> level) + x];
+}
+
+unsigned int OcclusionCuller::getNumLevels() const {
+	return m_levels.size();
+}
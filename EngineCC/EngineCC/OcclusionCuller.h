@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BoundingBox.h"
+#include "Mesh.h"
+
+class Primitive;
+
+// Size of the CPU depth buffer. The width must be a multiple of 4 (one SSE register of pixels)
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+// Fraction of the screen covered by the bounds of an occluder below which it is not rasterized
+#define OCCLUSION_MIN_OCCLUDER_AREA 0.02f
+
+/// Software occlusion culling
+// The triangles of a few occluders are rasterized 4 pixels at a time with SSE into a low resolution depth buffer.
+// A hierarchical-Z pyramid is built from it, each texel of a level keeping the farthest depth of the 2x2 texels below.
+// A box is hidden when its nearest depth is behind the farthest depth of the texels covered by its screen rectangle,
+// read at the level where this rectangle covers at most 2x2 texels.
+// Everything is done on the CPU so that it can be run without an OpenGL context.
+// Usage per frame : begin, rasterize the occluders, buildHierarchy, then isVisible for each candidate.
+class OcclusionCuller {
+public:
+	OcclusionCuller(unsigned int width = OCCLUSION_WIDTH, unsigned int height = OCCLUSION_HEIGHT);
+	~OcclusionCuller();
+
+	// Clear the depth buffer, the occluders and the boxes are then projected with view_projection
+	void begin(const glm::mat4& view_projection);
+
+	// Rasterize the triangles of the indexed vertices transformed by model
+	// The triangles crossing the near plane are skipped, the occlusion stays conservative
+	void rasterize(const std::vector<Mesh::VertexFormat>& vertices, const std::vector<GLuint>& indexes, const glm::mat4& model);
+	// Rasterize the meshes of primitive, the lines are ignored
+	void rasterize(const Primitive& primitive, const glm::mat4& model);
+
+	void buildHierarchy();
+
+	// False if the box is behind the occluders, the pyramid must have been built
+	bool isVisible(const BoundingBox& box) const;
+	// Fraction of the screen covered by the rectangle of the box, 1 if it crosses the near plane
+	float getScreenArea(const BoundingBox& box) const;
+
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+	// Depth in [0, 1] of the texel (x, y) of a level of the pyramid. The level 0 is the depth buffer
+	float getDepth(unsigned int level, unsigned int x, unsigned int y) const;
+	unsigned int getNumLevels() const;
+
+private:
+	// Screen rectangle (in pixels of the level 0) and nearest depth of a box
+	// Returns false if the box crosses the near plane
+	bool project(const BoundingBox& box, glm::vec2& min_point, glm::vec2& max_point, float& min_depth) const;
+
+	void rasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+
+private:
+	unsigned int m_width;
+	unsigned int m_height;
+
+	glm::mat4 m_view_projection;
+
+	// Level 0 is the depth buffer, level i is (width >> i) x (height >> i)
+	std::vector<std::vector<float>> m_levels;
+
+	// Screen space positions of the vertices of the occluder being rasterized, kept to avoid allocating
+	std::vector<glm::vec4> m_screen_vertices;
+};
@@ -15,6 +15,10 @@
 #include "Components.h"
 #include "Shader.h"
 #include "Cube.h"
+#include "FrustumCuller.h"
+#include "DebugLineRenderer.h"
+#include "Profiler.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -22,57 +26,123 @@ using namespace std;
 class PhysicSystem : public entityx::System<PhysicSystem> {
 public:
 	/// DebugDrawer Bullet
-	//// Helper class; draws the world as seen by Bullet.
-	//// This is very handy to see it Bullet's world matches yours.
-	//// This example uses the old OpenGL API for simplicity, 
-	//// so you'll have to remplace GLFW_OPENGL_CORE_PROFILE by
-	//// GLFW_OPENGL_COMPAT_PROFILE in glfwWindowHint()
-	//// How to use this class :
-	//// Declare an instance of the class :
-	//// BulletDebugDrawer_DeprecatedOpenGL mydebugdrawer;
-	//// dynamicsWorld->setDebugDrawer(&mydebugdrawer);
-	//// Each frame, call it :
-	//// mydebugdrawer.SetMatrices(ViewMatrix, ProjectionMatrix);
-	//// dynamicsWorld->debugDrawWorld();
+	// Draws the world as seen by Bullet, to check that it matches the renderables.
+	// The lines are collected in a DebugLineRenderer and drawn with one call per frame.
+	// F4 cycles through the modes (off, everything, wireframes, AABBs, constraints),
+	// F5 toggles the frustum filtering : only the objects whose AABB is in the view frustum are drawn.
 	class BulletDebugDrawer : public btIDebugDraw {
 	public:
+		enum Mode {
+			DEBUG_OFF,
+			DEBUG_ALL,
+			DEBUG_WIREFRAMES,
+			DEBUG_AABBS,
+			DEBUG_CONSTRAINTS,
+			NUM_DEBUG_MODES
+		};
+
+		BulletDebugDrawer() : m_mode(DEBUG_ALL), m_frustum_filter(true) {
+		}
 
 		virtual void drawLine(const btVector3& from, const btVector3& to, const btVector3& color) {
-			glm::vec3 from_glm(from.x(), from.y(), from.z());
-			glm::vec3 to_glm(to.x(), to.y(), to.z());
-			glm::vec4 color_glm(color.x(), color.y(), color.z(), 1.0);
-
-			m_points.push_back(from_glm);
-			m_points.push_back(to_glm);
+			m_lines.addLine(glm::vec3(from.x(), from.y(), from.z()),
+							glm::vec3(to.x(), to.y(), to.z()),
+							glm::vec4(color.x(), color.y(), color.z(), 1.f));
+		}
 
-			m_colors.push_back(color_glm);
-			m_colors.push_back(color_glm);
+		// Replaces btCollisionWorld::debugDrawWorld, which draws all the objects of the world
+		void drawWorld(btDiscreteDynamicsWorld& world) {
+			TRACE_SCOPE("BulletDebugDrawer::drawWorld");
+			const Viewer* viewer = GameProgram::m_current_viewer;
+			if (m_mode == DEBUG_OFF || viewer == nullptr)
+				return;
+
+			glm::vec4 planes[6];
+			FrustumCuller::extractPlanes(Viewer::getProjectionMatrix() * viewer->getViewMatrix(), planes);
+			int debug_mode = getDebugMode();
+
+			const btCollisionObjectArray& objects = world.getCollisionObjectArray();
+			for (int i = 0; i < objects.size(); ++i) {
+				const btCollisionObject* object = objects[i];
+				btVector3 min_point, max_point;
+				object->getCollisionShape()->getAabb(object->getWorldTransform(), min_point, max_point);
+				if (!isVisible(planes, min_point, max_point))
+					continue;
+
+				if (debug_mode & DBG_DrawWireframe) {
+					// Sleeping bodies in green
+					btVector3 color = (object->getActivationState() == ISLAND_SLEEPING) ? btVector3(0, 1, 0) : btVector3(1, 1, 1);
+					world.debugDrawObject(object->getWorldTransform(), object->getCollisionShape(), color);
+				}
+				if (debug_mode & DBG_DrawAabb)
+					drawAabb(min_point, max_point, btVector3(1, 0, 0));
+			}
+
+			if (debug_mode & (DBG_DrawConstraints | DBG_DrawConstraintLimits)) {
+				for (int i = 0; i < world.getNumConstraints(); ++i) {
+					btTypedConstraint* constraint = world.getConstraint(i);
+					btVector3 min_a, max_a, min_b, max_b;
+					constraint->getRigidBodyA().getAabb(min_a, max_a);
+					constraint->getRigidBodyB().getAabb(min_b, max_b);
+					if (isVisible(planes, min_a, max_a) || isVisible(planes, min_b, max_b))
+						world.debugDrawConstraint(constraint);
+				}
+			}
 		}
 
 		void draw() {
 			Manager<std::string, std::shared_ptr<Shader>>& shaders = Manager<std::string, std::shared_ptr<Shader>>::getInstance();
-			Renderable<LinePrimitive> lines(shaders.get("debug_bullet"), m_points, m_colors);
-
 			const Viewer* viewer = GameProgram::m_current_viewer;
-			if (viewer != nullptr)
-				lines.draw(*viewer);
+			std::shared_ptr<Shader> shader = shaders.get("debug_bullet");
+			PROFILE_COUNTER("debug lines", m_lines.getNumLines());
+			if (viewer != nullptr && shader)
+				m_lines.flush(*viewer, *shader);
+			m_lines.clear();
+		}
+
+		void cycleMode() {
+			m_mode = static_cast<Mode>((m_mode + 1) % NUM_DEBUG_MODES);
+		}
 
-			m_points.clear();
-			m_colors.clear();
+		void toggleFrustumFilter() {
+			m_frustum_filter = !m_frustum_filter;
 		}
 
 		virtual void drawContactPoint(const btVector3 &, const btVector3 &, btScalar, int, const btVector3 &) {}
 		virtual void reportErrorWarning(const char *) {}
 		virtual void draw3dText(const btVector3 &, const char *) {}
-		virtual void setDebugMode(int p) {
-			m = p;
+		// The Bullet flags are derived from the mode
+		virtual void setDebugMode(int) {}
+		int getDebugMode(void) const {
+			switch (m_mode) {
+			case DEBUG_ALL:
+				return DBG_DrawWireframe | DBG_DrawAabb | DBG_DrawConstraints | DBG_DrawConstraintLimits;
+			case DEBUG_WIREFRAMES:
+				return DBG_DrawWireframe;
+			case DEBUG_AABBS:
+				return DBG_DrawAabb;
+			case DEBUG_CONSTRAINTS:
+				return DBG_DrawConstraints | DBG_DrawConstraintLimits;
+			default:
+				return DBG_NoDebug;
+			}
 		}
-		int getDebugMode(void) const { return 3; }
-		int m;
 
-	public:
-		std::vector<glm::vec3> m_points;
-		std::vector<glm::vec4> m_colors;
+	private:
+		bool isVisible(const glm::vec4 planes[6], const btVector3& min_point, const btVector3& max_point) const {
+			if (!m_frustum_filter)
+				return true;
+
+			BoundingBox box;
+			box.min = glm::vec3(min_point.x(), min_point.y(), min_point.z());
+			box.max = glm::vec3(max_point.x(), max_point.y(), max_point.z());
+			return FrustumCuller::isVisible(planes, box);
+		}
+
+	private:
+		Mode m_mode;
+		bool m_frustum_filter;
+		DebugLineRenderer m_lines;
 	};
 public:
 	struct YourOwnFilterCallback : public btOverlapFilterCallback
@@ -91,10 +161,13 @@ public:
 	// Receive entities so that we add them to the dynamic world
 	// entities that will be instanciated during the game will be send
 	// to the PhysicSystem by a special event that will add them too.
-	PhysicSystem(entityx::EntityManager &es, btDiscreteDynamicsWorld& dynamic_world) : m_entities(es), m_dynamic_world(dynamic_world) {
+	// The debug drawing of the bullet world needs an OpenGL context. It is disabled for headless simulations.
+	PhysicSystem(entityx::EntityManager &es, btDiscreteDynamicsWorld& dynamic_world, bool debug_draw = true) : m_entities(es), m_dynamic_world(dynamic_world), m_debug_draw(debug_draw) {
 		// Setting of the debug drawer to the dynamic world
-		BulletDebugDrawer& debug_drawer = Singleton<BulletDebugDrawer>::getInstance();
-		m_dynamic_world.setDebugDrawer(&debug_drawer);
+		if (m_debug_draw) {
+			BulletDebugDrawer& debug_drawer = Singleton<BulletDebugDrawer>::getInstance();
+			m_dynamic_world.setDebugDrawer(&debug_drawer);
+		}
 
 		m_dynamic_world.setGravity(btVector3(0, -10.0, 0));
 	}
@@ -116,16 +189,22 @@ public:
 			entityHierarchy->computeTransformHierarchy();
 		}
 
-		m_dynamic_world.stepSimulation(dt);
+		{
+			TRACE_SCOPE("stepSimulation");
+			m_dynamic_world.stepSimulation(dt);
+		}
 
 		//Draw the debugging bullet world
-		m_dynamic_world.debugDrawWorld();
-		BulletDebugDrawer& debug_drawer = Singleton<BulletDebugDrawer>::getInstance();
-		debug_drawer.draw();
+		if (m_debug_draw) {
+			BulletDebugDrawer& debug_drawer = Singleton<BulletDebugDrawer>::getInstance();
+			debug_drawer.drawWorld(m_dynamic_world);
+			debug_drawer.draw();
+		}
 	}
 
 private:
 	btDiscreteDynamicsWorld& m_dynamic_world;
+	bool m_debug_draw;
 
 	// Reference to the entity manager for deallocating all Physics components
 	entityx::EntityManager& m_entities;
@@ -1,9 +1,11 @@
+#include <algorithm>
+
 #include "Primitive.h"
 
 #include "BoundingBox.h"
 #include "Mesh.h"
 
-Primitive::Primitive() {
+Primitive::Primitive() : m_own_meshes(false) {
 }
 
 Primitive::~Primitive() {
@@ -18,13 +20,60 @@ std::vector<glm::vec3> Primitive::getVertices() const {
 	return vertices;
 }
 
+BoundingBox Primitive::getLocalBoundingBox() const {
+	BoundingBox box = { glm::vec3(0.f), glm::vec3(0.f) };
+	for (unsigned int i = 0; i < m_meshes.size(); ++i) {
+		BoundingBox mesh_box = { m_meshes[i]->m_min_point, m_meshes[i]->m_max_point };
+		if (i == 0)
+			box = mesh_box;
+		else
+			box.merge(mesh_box);
+	}
+	return box;
+}
+
+unsigned int Primitive::getNumLods() const {
+	unsigned int num_lods = 1;
+	for (unsigned int i = 0; i < m_meshes.size(); ++i) {
+		num_lods = std::max(num_lods, m_meshes[i]->getNumLods());
+	}
+	return num_lods;
+}
+
 void Primitive::draw(const std::weak_ptr<Shader> shader) const {
+	static const UniformId tex_id = Shader::getUniformId("tex");
 	for (unsigned int i = 0; i < m_meshes.size(); ++i) {
-		m_meshes[i]->draw(shader);
+		if (i < m_textures.size() && m_textures[i]) {
+			// The texture of the instance replaces the one of the shared mesh
+			glBindVertexArray(m_meshes[i]->m_vao);
+			if (auto program = shader.lock())
+				m_textures[i]->bind(*program, tex_id);
+			m_meshes[i]->drawGeometry(0);
+		}
+		else {
+			m_meshes[i]->draw(shader);
+		}
+	}
+}
+
+void Primitive::submit(RenderQueue& queue, const RenderQueue::DrawItem& item) const {
+	RenderQueue::DrawItem mesh_item = item;
+	for (unsigned int i = 0; i < m_meshes.size(); ++i) {
+		mesh_item.drawable = m_meshes[i].get();
+		mesh_item.texture = (i < m_textures.size() && m_textures[i]) ? m_textures[i].get() : m_meshes[i]->getTexture();
+		queue.push(mesh_item);
 	}
 }
 
 void Primitive::setColor(const glm::vec4& color) {
+	// Copy on write, the other primitives keep the shared meshes
+	if (!m_own_meshes) {
+		for (unsigned int i = 0; i < m_meshes.size(); ++i) {
+			m_meshes[i] = m_meshes[i]->clone();
+		}
+		m_own_meshes = true;
+	}
+
 	for (unsigned int i = 0; i < m_meshes.size(); ++i) {
 		for (unsigned int j = 0; j < m_meshes[i]->m_vertices.size(); ++j) {
 			Mesh::VertexFormat& vertex = m_meshes[i]->m_vertices[j];
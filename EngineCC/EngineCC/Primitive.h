@@ -1,12 +1,16 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <functional>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
+#include "Texture.h"
+#include "RenderQueue.h"
+#include "BoundingBox.h"
 
 struct Drawable;
 
@@ -17,18 +21,46 @@ public:
 	virtual ~Primitive();
 
 	virtual void draw(const std::weak_ptr<Shader> shader) const;
+	// Push one item per mesh, item holds the states common to all the meshes
+	virtual void submit(RenderQueue& queue, const RenderQueue::DrawItem& item) const;
 
 	void setColor(const glm::vec4& color);
 
 	virtual std::vector<glm::vec3> getVertices() const;
+	// Bounds of the meshes in the space of the primitive, computed when their vertex arrays are created
+	virtual BoundingBox getLocalBoundingBox() const;
+	// Largest number of levels of details of the meshes
+	unsigned int getNumLods() const;
+	// Called every frame by the renderables, true when the meshes of an asynchronously loaded primitive have just replaced its placeholder
+	virtual bool finishLoading() {
+		return false;
+	}
+	// Run callback once the meshes have replaced the placeholder, at once if they already have (e.g. to build a collision shape from getVertices).
+	// Main thread only
+	virtual void whenLoaded(const std::function<void()>& callback) {
+		callback();
+	}
 
 
 	virtual void setTexture(const std::string& filepath) = 0;
 
 protected:
 	void writeBuffers();
+	// Give to each mesh the texture of the file, shared with the other primitives using it
+	template<typename T>
+	void setSharedTexture(const std::string& filepath) {
+		m_textures.assign(m_meshes.size(), T::getShared(filepath));
+	}
 
 public:
 	// A model is defined by its data vertices
-	std::vector<std::unique_ptr<Drawable>> m_meshes;
+	// The meshes are shared between the primitives of the same type (see AssetCache) and must not be modified.
+	// setColor gives its own copy of the meshes to the primitive
+	std::vector<std::shared_ptr<Drawable>> m_meshes;
+
+	// Per instance textures indexed as the meshes. When empty or null, the texture of the mesh is used
+	std::vector<std::shared_ptr<Texture>> m_textures;
+
+private:
+	bool m_own_meshes;
 };
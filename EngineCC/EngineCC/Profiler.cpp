@@ -0,0 +1,214 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cassert>
+
+#include "Profiler.h"
+#include "imgui.h"
+
+namespace {
+	float getElapsedMs(const FrameProfiler::Clock::time_point& start, const FrameProfiler::Clock::time_point& end) {
+		return std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(end - start).count();
+	}
+
+	// Distinct colors for the zones of the graph
+	ImColor getZoneColor(unsigned int zone_id) {
+		float hue = std::fmod(zone_id * 0.618034f, 1.f);
+		return ImColor::HSV(hue, 0.6f, 0.9f);
+	}
+}
+
+/// FrameProfiler::ScopedZone definitions
+FrameProfiler::ScopedZone::ScopedZone(unsigned int zone_id) : m_zone_id(zone_id),
+															  m_start(Clock::now()) {
+}
+
+FrameProfiler::ScopedZone::~ScopedZone() {
+	Singleton<FrameProfiler>::getInstance().addZoneTime(m_zone_id, getElapsedMs(m_start, Clock::now()));
+}
+
+/// FrameProfiler definitions
+FrameProfiler::FrameProfiler() : m_zone_times(PROFILER_NUM_FRAMES),
+								 m_frame_times(PROFILER_NUM_FRAMES, 0.f),
+								 m_current_frame(0),
+								 m_num_frames(0),
+								 m_keep_history(false),
+								 m_start_frame(Clock::now()),
+								 m_show_overlay(false) {
+	m_zone_times[m_current_frame].fill(0.f);
+}
+
+FrameProfiler::~FrameProfiler() {
+}
+
+unsigned int FrameProfiler::getZoneId(const char* name) {
+	for (unsigned int i = 0; i < m_zone_names.size(); ++i) {
+		if (m_zone_names[i] == name)
+			return i;
+	}
+
+	assert(m_zone_names.size() < PROFILER_MAX_ZONES);
+	m_zone_names.push_back(name);
+	return m_zone_names.size() - 1;
+}
+
+void FrameProfiler::beginFrame() {
+	m_start_frame = Clock::now();
+	m_zone_times[m_current_frame].fill(0.f);
+}
+
+void FrameProfiler::endFrame() {
+	m_frame_times[m_current_frame] = getElapsedMs(m_start_frame, Clock::now());
+	if (m_keep_history) {
+		m_history_zone_times.push_back(m_zone_times[m_current_frame]);
+		m_history_frame_times.push_back(m_frame_times[m_current_frame]);
+	}
+
+	m_current_frame = (m_current_frame + 1) % PROFILER_NUM_FRAMES;
+	if (m_num_frames < PROFILER_NUM_FRAMES)
+		m_num_frames++;
+
+	m_zone_times[m_current_frame].fill(0.f);
+}
+
+void FrameProfiler::addZoneTime(unsigned int zone_id, float time_ms) {
+	// A zone can be entered several times during a frame
+	m_zone_times[m_current_frame][zone_id] += time_ms;
+}
+
+void FrameProfiler::setCounter(const char* name, float value) {
+	for (unsigned int i = 0; i < m_counter_names.size(); ++i) {
+		if (m_counter_names[i] == name) {
+			m_counter_values[i] = value;
+			return;
+		}
+	}
+
+	m_counter_names.push_back(name);
+	m_counter_values.push_back(value);
+}
+
+unsigned int FrameProfiler::getNumFrames() const {
+	return m_num_frames;
+}
+
+unsigned int FrameProfiler::getFrameIndex(unsigned int i) const {
+	return (m_current_frame + PROFILER_NUM_FRAMES - m_num_frames + i) % PROFILER_NUM_FRAMES;
+}
+
+void FrameProfiler::keepHistory(bool keep) {
+	m_keep_history = keep;
+}
+
+void FrameProfiler::toggleOverlay() {
+	m_show_overlay = !m_show_overlay;
+}
+
+void FrameProfiler::drawOverlay() {
+	if (!m_show_overlay)
+		return;
+
+	ImGui::SetNextWindowPos(ImVec2(10.f, 400.f), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Frame profiler", &m_show_overlay, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings);
+
+	/// Stacked graph of the last frames
+	// The graph covers two frame budgets, the budget is drawn as a red line
+	const float bar_width = 2.f;
+	const float graph_height = 150.f;
+	const float max_time_ms = 2.f * PROFILER_FRAME_BUDGET_MS;
+	const ImU32 other_color = IM_COL32(120, 120, 120, 255);
+
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	float graph_width = bar_width * PROFILER_NUM_FRAMES;
+	draw_list->AddRectFilled(origin, ImVec2(origin.x + graph_width, origin.y + graph_height), IM_COL32(20, 20, 20, 200));
+
+	for (unsigned int i = 0; i < m_num_frames; ++i) {
+		unsigned int frame = getFrameIndex(i);
+		float x = origin.x + i * bar_width;
+		float y = origin.y + graph_height;
+
+		float zones_time = 0.f;
+		for (unsigned int z = 0; z < m_zone_names.size(); ++z) {
+			float time = m_zone_times[frame][z];
+			zones_time += time;
+			float height = std::fmin(time / max_time_ms * graph_height, y - origin.y);
+			draw_list->AddRectFilled(ImVec2(x, y - height), ImVec2(x + bar_width, y), getZoneColor(z));
+			y -= height;
+		}
+
+		float other_time = std::fmax(m_frame_times[frame] - zones_time, 0.f);
+		float height = std::fmin(other_time / max_time_ms * graph_height, y - origin.y);
+		draw_list->AddRectFilled(ImVec2(x, y - height), ImVec2(x + bar_width, y), other_color);
+	}
+
+	float budget_y = origin.y + graph_height * (1.f - PROFILER_FRAME_BUDGET_MS / max_time_ms);
+	draw_list->AddLine(ImVec2(origin.x, budget_y), ImVec2(origin.x + graph_width, budget_y), IM_COL32(255, 60, 60, 255));
+	ImGui::Dummy(ImVec2(graph_width, graph_height));
+
+	/// Legend with the last, mean and max times of each zone
+	float sum_frame_times = 0.f;
+	float max_frame_time = 0.f;
+	for (unsigned int i = 0; i < m_num_frames; ++i) {
+		float time = m_frame_times[getFrameIndex(i)];
+		sum_frame_times += time;
+		max_frame_time = std::fmax(max_frame_time, time);
+	}
+	float mean_frame_time = m_num_frames ? sum_frame_times / m_num_frames : 0.f;
+	ImGui::Text("frame : %.3f ms mean, %.3f ms max (%u frames)", mean_frame_time, max_frame_time, m_num_frames);
+
+	float sum_zones_mean = 0.f;
+	for (unsigned int z = 0; z < m_zone_names.size(); ++z) {
+		float sum = 0.f;
+		float max = 0.f;
+		for (unsigned int i = 0; i < m_num_frames; ++i) {
+			float time = m_zone_times[getFrameIndex(i)][z];
+			sum += time;
+			max = std::fmax(max, time);
+		}
+		float mean = m_num_frames ? sum / m_num_frames : 0.f;
+		sum_zones_mean += mean;
+		ImGui::TextColored(getZoneColor(z), "%-16s %7.3f ms mean, %7.3f ms max", m_zone_names[z].c_str(), mean, max);
+	}
+	ImGui::TextColored(ImColor(other_color), "%-16s %7.3f ms mean", "other", std::fmax(mean_frame_time - sum_zones_mean, 0.f));
+
+	for (unsigned int i = 0; i < m_counter_names.size(); ++i) {
+		ImGui::Text("%-16s %7.3f", m_counter_names[i].c_str(), m_counter_values[i]);
+	}
+
+	if (ImGui::Button("Dump CSV")) {
+		dumpCSV("profile.csv");
+	}
+
+	ImGui::End();
+}
+
+bool FrameProfiler::dumpCSV(const std::string& filename) const {
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		std::cout << "Unable to write the profile in " << filename << std::endl;
+		return false;
+	}
+
+	file << "frame,total";
+	for (unsigned int z = 0; z < m_zone_names.size(); ++z) {
+		file << "," << m_zone_names[z];
+	}
+	file << std::endl;
+
+	// The history contains all the frames when it is kept, otherwise the ring buffer is written
+	bool history = !m_history_frame_times.empty();
+	unsigned int num_frames = history ? m_history_frame_times.size() : m_num_frames;
+	for (unsigned int i = 0; i < num_frames; ++i) {
+		unsigned int frame = history ? i : getFrameIndex(i);
+		const std::array<float, PROFILER_MAX_ZONES>& zone_times = history ? m_history_zone_times[frame] : m_zone_times[frame];
+		file << i << "," << (history ? m_history_frame_times[frame] : m_frame_times[frame]);
+		for (unsigned int z = 0; z < m_zone_names.size(); ++z) {
+			file << "," << zone_times[z];
+		}
+		file << std::endl;
+	}
+
+	std::cout << num_frames << " frames of profile written in " << filename << std::endl;
+	return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+
+#include "Singleton.h"
+#include "Trace.h"
+
+// Comment this line to compile out all the profiling zones
+#define ENGINECC_PROFILE
+
+// Number of frames kept in the ring buffer of the profiler
+#define PROFILER_NUM_FRAMES 240
+// Maximum number of zones that can be recorded
+#define PROFILER_MAX_ZONES 32
+// Time budget of one frame at 60 FPS (ms)
+#define PROFILER_FRAME_BUDGET_MS 16.6f
+
+/// Frame profiler
+// Records every frame the time spent in named zones of the main loop (systems updates, input handling, ImGui...).
+// The zones are not expected to overlap so that they can be stacked in the overlay graph.
+// The time of the frame that is not spent in any zone is shown as "other".
+// Use the macros below instead of this class directly so that the zones disappear when ENGINECC_PROFILE is not defined.
+class FrameProfiler {
+public:
+	using Clock = std::chrono::high_resolution_clock;
+
+	// Measures the time between its construction and its destruction and adds it to the zone of the current frame
+	class ScopedZone {
+	public:
+		ScopedZone(unsigned int zone_id);
+		~ScopedZone();
+
+	private:
+		unsigned int m_zone_id;
+		Clock::time_point m_start;
+	};
+
+	FrameProfiler();
+	~FrameProfiler();
+
+	// Returns the id of the zone called name. The zone is created the first time it is asked
+	unsigned int getZoneId(const char* name);
+
+	void beginFrame();
+	void endFrame();
+
+	void addZoneTime(unsigned int zone_id, float time_ms);
+	// Value of the last frame shown under the zones in the overlay (e.g. number of visible entities)
+	void setCounter(const char* name, float value);
+
+	// Draw the stacked graph of the last frames in an ImGui window
+	void drawOverlay();
+	void toggleOverlay();
+
+	// Keep all the frames from now on instead of the last ones only (e.g. for a whole replayed session)
+	void keepHistory(bool keep);
+
+	// Write the recorded frames in a CSV file : one line per frame, one column per zone (ms)
+	// Returns false if the file cannot be opened
+	bool dumpCSV(const std::string& filename) const;
+
+	unsigned int getNumFrames() const;
+
+private:
+	// Index in the ring buffer of the i-th oldest recorded frame
+	unsigned int getFrameIndex(unsigned int i) const;
+
+private:
+	std::vector<std::string> m_zone_names;
+
+	std::vector<std::string> m_counter_names;
+	std::vector<float> m_counter_values;
+
+	// Ring buffer of the frames
+	std::vector<std::array<float, PROFILER_MAX_ZONES>> m_zone_times;
+	std::vector<float> m_frame_times;
+	unsigned int m_current_frame;
+	unsigned int m_num_frames;
+
+	// All the frames since keepHistory has been called
+	bool m_keep_history;
+	std::vector<std::array<float, PROFILER_MAX_ZONES>> m_history_zone_times;
+	std::vector<float> m_history_frame_times;
+
+	Clock::time_point m_start_frame;
+	bool m_show_overlay;
+};
+
+#ifdef ENGINECC_PROFILE
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+// Time the end of the enclosing scope under the zone called name. The zone is also recorded in the trace timeline
+#define PROFILE_SCOPE(name) \
+	TRACE_SCOPE(name); \
+	static const unsigned int PROFILE_CONCAT(profile_zone_, __LINE__) = Singleton<FrameProfiler>::getInstance().getZoneId(name); \
+	FrameProfiler::ScopedZone PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_zone_, __LINE__))
+#define PROFILE_BEGIN_FRAME() Singleton<FrameProfiler>::getInstance().beginFrame()
+#define PROFILE_END_FRAME() Singleton<FrameProfiler>::getInstance().endFrame()
+#define PROFILE_DRAW_OVERLAY() Singleton<FrameProfiler>::getInstance().drawOverlay()
+#define PROFILE_COUNTER(name, value) Singleton<FrameProfiler>::getInstance().setCounter(name, static_cast<float>(value))
+#else
+#define PROFILE_SCOPE(name) TRACE_SCOPE(name)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+#define PROFILE_DRAW_OVERLAY()
+#define PROFILE_COUNTER(name, value)
+#endif
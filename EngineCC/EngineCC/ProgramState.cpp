@@ -2,12 +2,33 @@
 
 #include "InputHandler.h"
 #include "GameProgram.h"
+#include "Profiler.h"
+#include "PhysicSystem.h"
 
 ProgramState::ProgramState(GameProgram& program, InputHandler& input_handler) : m_input_handler(input_handler) {
 	m_commands.insert(std::pair<int, std::function<void()>>(SDLK_ESCAPE, [&program]() {
 		std::cout << "EngineCC closed" << std::endl;
 		program.close();
 	}));
+
+	/// Frame profiler : F1 shows the overlay, F2 writes the recorded frames in profile.csv
+	m_commands.insert(std::pair<int, std::function<void()>>(SDLK_F1, []() {
+		Singleton<FrameProfiler>::getInstance().toggleOverlay();
+	}));
+	m_commands.insert(std::pair<int, std::function<void()>>(SDLK_F2, []() {
+		Singleton<FrameProfiler>::getInstance().dumpCSV("profile.csv");
+	}));
+	/// Trace : F3 captures the timeline of the next 120 frames in trace.json
+	m_commands.insert(std::pair<int, std::function<void()>>(SDLK_F3, []() {
+		Singleton<Tracer>::getInstance().startCapture("trace.json", 120);
+	}));
+	/// Physics debug drawing : F4 cycles through the modes, F5 toggles the frustum filtering
+	m_commands.insert(std::pair<int, std::function<void()>>(SDLK_F4, []() {
+		Singleton<PhysicSystem::BulletDebugDrawer>::getInstance().cycleMode();
+	}));
+	m_commands.insert(std::pair<int, std::function<void()>>(SDLK_F5, []() {
+		Singleton<PhysicSystem::BulletDebugDrawer>::getInstance().toggleFrustumFilter();
+	}));
 }
 
 ProgramState::~ProgramState() {
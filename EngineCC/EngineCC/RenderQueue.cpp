@@ -0,0 +1,306 @@
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "Viewer.h"
+#include "Mesh.h"
+#include "UniformRing.h"
+#include "Trace.h"
+
+namespace {
+	// Positive floats keep their order when their bits are compared as unsigned integers
+	uint32_t quantizeDepth(float depth) {
+		depth = std::max(depth, 0.f);
+		uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(float));
+		return bits >> 8;
+	}
+
+	// Number of instances the instance buffer can hold
+	size_t instance_buffer_capacity = 0;
+
+	// Minimum number of consecutive items to draw them with an instanced draw call
+	const uint32_t min_instances = 2;
+}
+
+/// RenderQueue::DrawItem definitions
+RenderQueue::DrawItem::DrawItem() : drawable(nullptr),
+									lod(0),
+									shader(nullptr),
+									texture(nullptr),
+									model(1.f),
+									tex_factor(1.f),
+									polygon_mode(GL_FILL),
+									pass(OPAQUE_PASS),
+									bones(nullptr),
+									num_bones(0) {
+}
+
+/// RenderQueue definitions
+RenderQueue::RenderQueue() : m_num_draw_calls(0) {
+}
+
+RenderQueue::~RenderQueue() {
+}
+
+GLuint RenderQueue::getInstanceBuffer() {
+	static GLuint instance_buffer = 0;
+	if (instance_buffer == 0) {
+		// The buffer is never empty, the non instanced draws also fetch the attributes of the first instance
+		glCreateBuffers(1, &instance_buffer);
+		instance_buffer_capacity = 1024;
+		glNamedBufferData(instance_buffer, instance_buffer_capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	}
+	return instance_buffer;
+}
+
+void RenderQueue::setInstanceAttributes() {
+	for (GLuint i = 0; i < 4; ++i) {
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_MODEL + i);
+		glVertexAttribFormat(INSTANCE_ATTRIB_MODEL + i, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData, model) + i * sizeof(glm::vec4));
+		glVertexAttribBinding(INSTANCE_ATTRIB_MODEL + i, INSTANCE_BUFFER_BINDING);
+	}
+	glEnableVertexAttribArray(INSTANCE_ATTRIB_TEX_FACTOR);
+	glVertexAttribFormat(INSTANCE_ATTRIB_TEX_FACTOR, 3, GL_FLOAT, GL_FALSE, offsetof(InstanceData, tex_factor));
+	glVertexAttribBinding(INSTANCE_ATTRIB_TEX_FACTOR, INSTANCE_BUFFER_BINDING);
+	glEnableVertexAttribArray(INSTANCE_ATTRIB_BONES_OFFSET);
+	glVertexAttribIFormat(INSTANCE_ATTRIB_BONES_OFFSET, 1, GL_INT, offsetof(InstanceData, bones_offset));
+	glVertexAttribBinding(INSTANCE_ATTRIB_BONES_OFFSET, INSTANCE_BUFFER_BINDING);
+
+	// The buffer keeps its name when it grows, the binding stays valid
+	glBindVertexBuffer(INSTANCE_BUFFER_BINDING, getInstanceBuffer(), 0, sizeof(InstanceData));
+	glVertexBindingDivisor(INSTANCE_BUFFER_BINDING, 1);
+}
+
+void RenderQueue::push(const DrawItem& item) {
+	m_items.push_back(item);
+}
+
+size_t RenderQueue::size() const {
+	return m_items.size();
+}
+
+unsigned int RenderQueue::getNumDrawCalls() const {
+	return m_num_draw_calls;
+}
+
+void RenderQueue::clear() {
+	m_items.clear();
+}
+
+uint64_t RenderQueue::computeKey(const DrawItem& item, float depth) {
+	uint64_t pass = static_cast<uint64_t>(item.pass) & 0x3;
+	uint64_t polygon_mode = (item.polygon_mode == GL_FILL) ? 0 : 1;
+	uint64_t program = item.shader->getProgram() & 0xFF;
+	uint64_t texture = item.texture ? (item.texture->getIndex() & 0xFFF) : 0;
+	uint64_t vao = item.drawable->m_vao & 0x3FFF;
+	uint64_t lod = std::min(item.lod, 3u);
+	uint64_t quantized_depth = quantizeDepth(depth) & 0xFFFFFF;
+
+	if (item.pass == TRANSPARENT_PASS) {
+		// The farthest items are drawn first
+		uint64_t inverted_depth = 0xFFFFFF - quantized_depth;
+		return (pass << 62) | (inverted_depth << 38) | (polygon_mode << 37) | (program << 29) | (texture << 17) | (vao << 3) | (lod << 1);
+	}
+	return (pass << 62) | (polygon_mode << 61) | (program << 53) | (texture << 41) | (vao << 27) | (lod << 25) | (quantized_depth << 1);
+}
+
+bool RenderQueue::canBeInstancedWith(const DrawItem& a, const DrawItem& b) {
+	// The palettes are read from the bones offsets of the instances, animated models are instanced too
+	return a.shader == b.shader && a.texture == b.texture && a.drawable->m_vao == b.drawable->m_vao &&
+		a.lod == b.lod && a.polygon_mode == b.polygon_mode;
+}
+
+void RenderQueue::sort(const glm::mat4& view) {
+	m_keys.resize(m_items.size());
+	m_order.resize(m_items.size());
+	for (uint32_t i = 0; i < m_items.size(); ++i) {
+		// Distance along the view direction of the origin of the item
+		glm::vec4 position = view * m_items[i].model[3];
+		m_keys[i] = computeKey(m_items[i], -position.z);
+		m_order[i] = i;
+	}
+
+	radixSort();
+}
+
+void RenderQueue::radixSort() {
+	const size_t num_keys = m_keys.size();
+	m_tmp_keys.resize(num_keys);
+	m_tmp_order.resize(num_keys);
+
+	for (unsigned int shift = 0; shift < 64; shift += 8) {
+		size_t histogram[256] = { 0 };
+		for (size_t i = 0; i < num_keys; ++i) {
+			histogram[(m_keys[i] >> shift) & 0xFF]++;
+		}
+
+		// Nothing to do if all the keys have the same byte
+		if (num_keys == 0 || histogram[(m_keys[0] >> shift) & 0xFF] == num_keys)
+			continue;
+
+		size_t offset = 0;
+		for (unsigned int b = 0; b < 256; ++b) {
+			size_t count = histogram[b];
+			histogram[b] = offset;
+			offset += count;
+		}
+
+		for (size_t i = 0; i < num_keys; ++i) {
+			size_t dst = histogram[(m_keys[i] >> shift) & 0xFF]++;
+			m_tmp_keys[dst] = m_keys[i];
+			m_tmp_order[dst] = m_order[i];
+		}
+
+		m_keys.swap(m_tmp_keys);
+		m_order.swap(m_tmp_order);
+	}
+}
+
+void RenderQueue::gatherBones() {
+	m_bones.clear();
+	m_palette_offsets.clear();
+	m_bones_offsets.assign(m_items.size(), -1);
+
+	for (uint32_t i = 0; i < m_items.size(); ++i) {
+		const DrawItem& item = m_items[i];
+		if (!item.bones)
+			continue;
+
+		GLint offset = static_cast<GLint>(m_bones.size() / 16);
+		std::pair<std::unordered_map<const GLfloat*, GLint>::iterator, bool> palette = m_palette_offsets.emplace(item.bones, offset);
+		if (palette.second)
+			m_bones.insert(m_bones.end(), item.bones, item.bones + 16 * item.num_bones);
+		m_bones_offsets[i] = palette.first->second;
+	}
+}
+
+void RenderQueue::buildBatches() {
+	m_batches.clear();
+	m_instances.clear();
+
+	uint32_t i = 0;
+	while (i < m_order.size()) {
+		const DrawItem& item = m_items[m_order[i]];
+		uint32_t count = 1;
+		if (item.shader->getInstancedVariant()) {
+			while (i + count < m_order.size() && canBeInstancedWith(item, m_items[m_order[i + count]]))
+				count++;
+		}
+
+		Batch batch;
+		batch.first = i;
+		batch.count = count;
+		batch.base_instance = -1;
+		if (count >= min_instances) {
+			batch.base_instance = static_cast<int>(m_instances.size());
+			for (uint32_t j = i; j < i + count; ++j) {
+				const DrawItem& instance_item = m_items[m_order[j]];
+				InstanceData instance;
+				instance.model = instance_item.model;
+				instance.tex_factor = glm::vec4(instance_item.tex_factor, 0.f);
+				instance.bones_offset = m_bones_offsets[m_order[j]];
+				m_instances.push_back(instance);
+			}
+			m_batches.push_back(batch);
+		}
+		else {
+			// The items that cannot be instanced are drawn one by one
+			batch.count = 1;
+			for (uint32_t j = i; j < i + count; ++j) {
+				batch.first = j;
+				m_batches.push_back(batch);
+			}
+		}
+		i += count;
+	}
+
+	if (m_instances.empty())
+		return;
+
+	// The buffer is orphaned every frame so that the driver does not wait for the draws of the previous one
+	GLuint instance_buffer = getInstanceBuffer();
+	instance_buffer_capacity = std::max(instance_buffer_capacity, m_instances.size());
+	glNamedBufferData(instance_buffer, instance_buffer_capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	glNamedBufferSubData(instance_buffer, 0, m_instances.size() * sizeof(InstanceData), m_instances.data());
+}
+
+void RenderQueue::flush(const Viewer& viewer) {
+	TRACE_SCOPE("RenderQueue::flush");
+	static const UniformId tex_id = Shader::getUniformId("tex");
+
+	const glm::mat4& view = viewer.getViewMatrix();
+	sort(view);
+	gatherBones();
+	buildBatches();
+
+	// The camera and the palettes are bound once for all the programs, the non instanced items bind their own Object block
+	UniformRing& uniform_ring = UniformRing::getInstance();
+	uniform_ring.bindFrameUniforms(view, Viewer::getProjectionMatrix());
+	if (!m_bones.empty())
+		uniform_ring.bindBones(m_bones.data(), static_cast<GLsizei>(m_bones.size() / 16));
+
+	Shader* current_shader = nullptr;
+	const Texture* current_texture = nullptr;
+	GLuint current_vao = 0;
+	GLenum current_polygon_mode = GL_FILL;
+	bool depth_write = true;
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	m_num_draw_calls = 0;
+
+	for (const Batch& batch : m_batches) {
+		const DrawItem& item = m_items[m_order[batch.first]];
+		bool instanced = batch.base_instance >= 0;
+
+		// The transparent items are blended over the opaque ones without hiding each other
+		if (depth_write && item.pass == TRANSPARENT_PASS) {
+			glDepthMask(GL_FALSE);
+			depth_write = false;
+		}
+
+		if (item.polygon_mode != current_polygon_mode) {
+			glPolygonMode(GL_FRONT_AND_BACK, item.polygon_mode);
+			current_polygon_mode = item.polygon_mode;
+		}
+
+		Shader* item_shader = instanced ? item.shader->getInstancedVariant() : item.shader;
+		if (item_shader != current_shader) {
+			item_shader->bind();
+			current_shader = item_shader;
+			// The sampler uniform of the new program has to be set
+			current_texture = nullptr;
+		}
+
+		Shader& shader = *item_shader;
+		if (!instanced) {
+			uniform_ring.bindObjectUniforms(item.model, item.tex_factor, m_bones_offsets[m_order[batch.first]]);
+		}
+
+		if (item.texture && item.texture != current_texture) {
+			item.texture->bind(shader, tex_id);
+			current_texture = item.texture;
+		}
+
+		if (item.drawable->m_vao != current_vao) {
+			glBindVertexArray(item.drawable->m_vao);
+			current_vao = item.drawable->m_vao;
+		}
+
+		if (instanced)
+			item.drawable->drawGeometryInstanced(item.lod, batch.count, batch.base_instance);
+		else
+			item.drawable->drawGeometry(item.lod);
+		m_num_draw_calls++;
+	}
+
+	if (!depth_write)
+		glDepthMask(GL_TRUE);
+	if (current_polygon_mode != GL_FILL)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	clear();
+}
+
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Dependencies\glew\glew.h"
+
+class Shader;
+class Texture;
+class Viewer;
+struct Drawable;
+
+// Vertex buffer binding of the per instance attributes in the vertex arrays of the meshes
+#define INSTANCE_BUFFER_BINDING 15
+// First attribute location of the per instance data. The model matrix takes the locations 6 to 9
+#define INSTANCE_ATTRIB_MODEL 6
+#define INSTANCE_ATTRIB_TEX_FACTOR 10
+#define INSTANCE_ATTRIB_BONES_OFFSET 11
+
+/// Queue of the draws of a frame
+// The renderables submit one item per mesh instead of drawing directly. When the queue is flushed, the items are
+// sorted on a 64 bits key and drawn in this order, so that the program, the texture and the vertex array are only
+// bound when they change from one draw to the next one.
+// Key of an opaque item (front-to-back inside a batch of same state) :
+//   pass (2) | polygon mode (1) | program (8) | texture (12) | vertex array (14) | lod (2) | depth (24)
+// Key of a transparent item (back-to-front) :
+//   pass (2) | inverted depth (24) | polygon mode (1) | program (8) | texture (12) | vertex array (14) | lod (2)
+// The GL names are truncated to fit in their fields. Two objects sharing a field are only drawn
+// less efficiently, the states are compared on the objects themselves.
+// Consecutive items sharing the same program, texture, vertex array and level of details are drawn with one instanced draw call
+// when their program has an instanced variant. Their model matrices and texcoords factors are written in
+// the instance buffer, read by the vertex arrays of the meshes on the INSTANCE_BUFFER_BINDING.
+// The camera and the per object data of the other items are written in the uniform ring and bound by offset (see UniformRing).
+// The bones palettes of the animated items are copied once per flush in one storage block, the items sharing a palette
+// share its copy. Each item reads its palette from its bones offset, so the animated models are instanced as the others.
+class RenderQueue {
+public:
+	enum Pass {
+		OPAQUE_PASS,
+		TRANSPARENT_PASS
+	};
+
+	struct DrawItem {
+		DrawItem();
+
+		const Drawable* drawable;
+		// Level of details of the drawable, clamped to its number of levels when drawn
+		unsigned int lod;
+		Shader* shader;
+		// nullptr if the drawable is not textured
+		const Texture* texture;
+
+		glm::mat4 model;
+		glm::vec3 tex_factor;
+		GLenum polygon_mode;
+		Pass pass;
+
+		// Bones transforms of an animated model (row major), nullptr otherwise.
+		// The palette is copied when the queue is flushed, the items pointing to the same palette share its copy
+		const GLfloat* bones;
+		GLsizei num_bones;
+	};
+
+	// Per instance attributes of an instanced draw
+	struct InstanceData {
+		glm::mat4 model;
+		glm::vec4 tex_factor;
+		// First bone of the palette in the Bones block, -1 if not animated
+		GLint bones_offset;
+	};
+
+	RenderQueue();
+	~RenderQueue();
+
+	// Buffer shared by all the queues, it is attached to the vertex arrays when they are created
+	static GLuint getInstanceBuffer();
+	// Add the per instance attributes to the vertex array currently bound
+	static void setInstanceAttributes();
+
+	// The items must stay valid until the queue is flushed
+	void push(const DrawItem& item);
+
+	// Compute the keys from the view and sort the items
+	void sort(const glm::mat4& view);
+	// Sort and draw all the items, then empty the queue
+	void flush(const Viewer& viewer);
+	void clear();
+
+	size_t size() const;
+	// Number of draw calls issued by the last flush
+	unsigned int getNumDrawCalls() const;
+
+private:
+	struct Batch {
+		// Index of the first item in the sorted order
+		uint32_t first;
+		uint32_t count;
+		// Index of the first instance in the instance buffer if the batch is instanced
+		int base_instance;
+	};
+
+	static uint64_t computeKey(const DrawItem& item, float depth);
+	static bool canBeInstancedWith(const DrawItem& a, const DrawItem& b);
+	// Copy the palettes of the animated items one after the other and compute their bones offsets
+	void gatherBones();
+	// Group the sorted items and fill the instance buffer
+	void buildBatches();
+	// LSD radix sort of the keys, 8 bits at a time. The bytes that are the same for all the keys are skipped
+	void radixSort();
+
+private:
+	std::vector<DrawItem> m_items;
+
+	// Keys and item indexes, sorted in place. The tmp vectors are kept to avoid allocating every frame
+	std::vector<uint64_t> m_keys;
+	std::vector<uint32_t> m_order;
+	std::vector<uint64_t> m_tmp_keys;
+	std::vector<uint32_t> m_tmp_order;
+
+	std::vector<Batch> m_batches;
+	std::vector<InstanceData> m_instances;
+
+	// Palettes of the flush, and bones offset of each item
+	std::vector<GLfloat> m_bones;
+	std::vector<GLint> m_bones_offsets;
+	std::unordered_map<const GLfloat*, GLint> m_palette_offsets;
+
+	unsigned int m_num_draw_calls;
+};
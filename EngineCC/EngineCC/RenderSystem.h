@@ -1,13 +1,22 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
 #include <entityx/entityx.h>
 #include "Components.h"
 #include "Viewer.h"
+#include "RenderQueue.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "Profiler.h"
 
 /// RenderSystem definifion
 class RenderSystem : public entityx::System<RenderSystem> {
 public:
-	RenderSystem(const Viewer& viewer) : m_viewer(viewer) {
+	RenderSystem(const Viewer& viewer) : m_viewer(viewer),
+										 m_frame(0) {
 	}
 
 	LocalTransform btTransformToLocalTransform(const btTransform& bt_tr, const btCollisionShape* collision_shape) const {
@@ -45,10 +54,131 @@ public:
 			//}
 		});
 
+		// Only the renderables whose bounds intersect the frustum are submitted
+		// Each renderable keeps its slot in the culler, its box is only copied again when it has changed
+		m_frame++;
 		es.each<Render>([this](entityx::Entity entity, Render& render) {
-			render->draw(m_viewer);
+			render->updateLoading();
+			updateSlot(entity, render.get());
+		});
+		removeUnseenSlots();
+
+		glm::mat4 view_projection = Viewer::getProjectionMatrix() * m_viewer.getViewMatrix();
+		m_culler.cull(view_projection);
+
+		// The occluders large enough on the screen are rasterized, the renderables in the frustum behind them are not submitted
+		std::chrono::high_resolution_clock::time_point start_occlusion = std::chrono::high_resolution_clock::now();
+		m_occlusion.begin(view_projection);
+		es.each<Render, Occluder>([this](entityx::Entity entity, Render& render, Occluder& occluder) {
+			if (m_occlusion.getScreenArea(render->getWorldBoundingBox()) >= OCCLUSION_MIN_OCCLUDER_AREA)
+				m_occlusion.rasterize(render->getPrimitive(), render->getLocalTransform().getModelMatrix());
 		});
+		m_occlusion.buildHierarchy();
+
+		const std::vector<uint32_t>& visible = m_culler.getVisible();
+		unsigned int num_occluded = 0;
+		for (unsigned int i = 0; i < visible.size(); ++i) {
+			RenderObject* render = m_slots[visible[i]].render;
+			if (!m_occlusion.isVisible(render->getWorldBoundingBox())) {
+				num_occluded++;
+				continue;
+			}
+			render->updateLod(m_viewer.getPosition());
+			render->submit(m_queue);
+		}
+		float occlusion_time = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(std::chrono::high_resolution_clock::now() - start_occlusion).count();
+
+		PROFILE_COUNTER("visible", visible.size() - num_occluded);
+		PROFILE_COUNTER("occluded", num_occluded);
+		PROFILE_COUNTER("renderables", m_culler.size());
+		PROFILE_COUNTER("cull (ms)", m_culler.getCullTime());
+		PROFILE_COUNTER("occlusion (ms)", occlusion_time);
+
+		m_queue.flush(m_viewer);
+	}
+
+	// Draw a renderable that is not an entity (e.g. the grid of the editor) with the entities of the next update
+	// It is never culled
+	void submit(const RenderObject& render) {
+		render.submit(m_queue);
+	}
+
+private:
+	static const uint32_t INVALID_SLOT = UINT32_MAX;
+
+	// Renderable of the index of the culler with the version of the box that was copied in it
+	struct CullSlot {
+		RenderObject* render;
+		entityx::Entity::Id entity;
+		uint32_t bounds_version;
+		// Last frame the entity was iterated, the slots of the destroyed entities are not seen anymore
+		uint32_t last_frame;
+	};
+
+	void updateSlot(entityx::Entity entity, RenderObject* render) {
+		const uint32_t index = entity.id().index();
+		if (index >= m_entity_slots.size())
+			m_entity_slots.resize(index + 1, INVALID_SLOT);
+
+		uint32_t slot = m_entity_slots[index];
+		if (slot != INVALID_SLOT && m_slots[slot].entity == entity.id()) {
+			CullSlot& cull_slot = m_slots[slot];
+			// The render component can be replaced, the new one has its own versions
+			if (cull_slot.render != render || cull_slot.bounds_version != render->getBoundsVersion()) {
+				m_culler.set(slot, render->getWorldBoundingBox());
+				cull_slot.render = render;
+				cull_slot.bounds_version = render->getBoundsVersion();
+			}
+			cull_slot.last_frame = m_frame;
+			return;
+		}
+
+		CullSlot cull_slot;
+		cull_slot.render = render;
+		cull_slot.entity = entity.id();
+		cull_slot.bounds_version = render->getBoundsVersion();
+		cull_slot.last_frame = m_frame;
+		m_entity_slots[index] = m_culler.add(render->getWorldBoundingBox());
+		m_slots.push_back(cull_slot);
 	}
+
+	// The renderables of the slots not seen this frame may be destroyed, they are never dereferenced
+	void removeUnseenSlots() {
+		uint32_t slot = 0;
+		while (slot < m_slots.size()) {
+			if (m_slots[slot].last_frame == m_frame) {
+				slot++;
+				continue;
+			}
+
+			// The slot of an index can already belong to the entity that reused it
+			const uint32_t index = m_slots[slot].entity.index();
+			if (m_entity_slots[index] == slot)
+				m_entity_slots[index] = INVALID_SLOT;
+
+			// The last slot is moved in the removed one, as in the culler
+			const uint32_t last = static_cast<uint32_t>(m_slots.size() - 1);
+			if (slot != last) {
+				m_slots[slot] = m_slots[last];
+				const uint32_t moved_index = m_slots[slot].entity.index();
+				if (m_entity_slots[moved_index] == last)
+					m_entity_slots[moved_index] = slot;
+			}
+			m_slots.pop_back();
+			m_culler.remove(slot);
+		}
+	}
+
 private:
 	const Viewer& m_viewer;
+	RenderQueue m_queue;
+
+	// Bounds of the renderables, the indexes of the culler refer to m_slots.
+	// They are kept from one frame to the next one and the boxes are only copied when they change
+	FrustumCuller m_culler;
+	std::vector<CullSlot> m_slots;
+	// Slot of each entity, by the index of its id
+	std::vector<uint32_t> m_entity_slots;
+	uint32_t m_frame;
+	OcclusionCuller m_occlusion;
 };
\ No newline at end of file
@@ -1,5 +1,21 @@
 #include "Renderable.h"
 
+namespace {
+	// Projected sizes under which the next level of details is used
+	const float lod_screen_sizes[] = { 0.25f, 0.1f, 0.04f };
+	const unsigned int num_lod_screen_sizes = sizeof(lod_screen_sizes) / sizeof(float);
+	// Relative margin around the thresholds
+	const float lod_hysteresis = 0.15f;
+}
 
-
-
+unsigned int RenderObject::selectLod(float screen_size, unsigned int current_lod, unsigned int num_lods) {
+	unsigned int lod = 0;
+	while (lod + 1 < num_lods && lod < num_lod_screen_sizes) {
+		// Going to a finer level than the current one needs a larger size, a coarser one a smaller size
+		float threshold = lod_screen_sizes[lod] * ((lod < current_lod) ? 1.f + lod_hysteresis : 1.f - lod_hysteresis);
+		if (screen_size >= threshold)
+			break;
+		lod++;
+	}
+	return lod;
+}
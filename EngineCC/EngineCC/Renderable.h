@@ -3,6 +3,7 @@
 #include <memory>
 #include <fstream>
 #include <iostream>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -31,10 +32,30 @@ public:
 	virtual void setTexcoordsFactor(const glm::vec3& texcoords_factor) = 0;
 
 	virtual const Primitive& getPrimitive() const = 0;
+	virtual Primitive& getPrimitive() = 0;
+	// Bounds of the primitive transformed by the model matrix, updated when the transform changes
+	virtual const BoundingBox& getWorldBoundingBox() const = 0;
+	// Incremented each time the world box changes, the culling tables copy the box again when it differs from the one they copied
+	virtual uint32_t getBoundsVersion() const = 0;
 
 	virtual void draw(const Viewer& viewer) const = 0;
+	// Deferred draw, the renderable is drawn when the queue is flushed
+	virtual void submit(RenderQueue& queue) const = 0;
+
+	// Transparent renderables are drawn after the opaque ones, from back to front
+	virtual void setTransparent(bool transparent) = 0;
 	
 	virtual void setInvisible(bool visible=false) = 0;
+
+	// Choose the level of details from the size of the renderable on the screen
+	virtual void updateLod(const glm::vec3& viewer_position) = 0;
+
+	// Take the primitive once its asset is loaded, the bounds of the placeholder are replaced
+	virtual void updateLoading() = 0;
+
+	// Level of details for a projected size (ratio of the half height of the screen). The level only changes when the size
+	// passes a threshold by a margin, so that a renderable at the distance of a threshold does not switch every frame
+	static unsigned int selectLod(float screen_size, unsigned int current_lod, unsigned int num_lods);
 };
 
 template<typename T>
@@ -58,8 +79,7 @@ public:
 	}
 
 	// Renderable construction for a model 3D object a.k.a. Renderable<Model>
-	// TODO : Create a manager of textures map<string, std::shared_ptr<Texture>> instead of creating two times the same
-	// TODO : textures for two instances of the same model.
+	// The file is imported once, the other models of the same file share its meshes and textures (see AssetCache)
 	Renderable(const std::weak_ptr<Shader> shader, const std::string& filename) : m_shader(shader) {
 		// Mesh contains all the data of the renderable (vertex, colors, normals, ...)
 		m_render = std::make_unique<T>(filename);
@@ -83,27 +103,67 @@ public:
 		return m_model_mat;
 	}
 
+	// Immediate draw, through a queue of the renderable alone so that it binds the same uniform blocks as the deferred draws
 	void draw(const Viewer& viewer) const {
+		RenderQueue queue;
+		submit(queue);
+		queue.flush(viewer);
+	}
+
+	void submit(RenderQueue& queue) const {
 		if (!m_visible)
 			return;
 
 		if (auto shader_str = m_shader.lock()) {
-			glPolygonMode(GL_FRONT_AND_BACK, m_polygon_mode);
-			shader_str->bind();
-			glUniformMatrix4fv(shader_str->getUniformLocation("model"), 1, false, glm::value_ptr(m_model_mat));
-			glUniformMatrix4fv(shader_str->getUniformLocation("view"), 1, false, glm::value_ptr(viewer.getViewMatrix()));
-			glUniformMatrix4fv(shader_str->getUniformLocation("modelview"), 1, false, glm::value_ptr(viewer.getViewMatrix() * m_model_mat));
-			glUniformMatrix4fv(shader_str->getUniformLocation("projection"), 1, false, glm::value_ptr(Viewer::getProjectionMatrix()));
-
-			glUniform3fv(shader_str->getUniformLocation("tex_factor"), 1, glm::value_ptr(m_texcoords_factor));
+			RenderQueue::DrawItem item;
+			// The shaders are owned by the shader manager and outlive the queue
+			item.shader = shader_str.get();
+			item.model = m_model_mat;
+			item.tex_factor = m_texcoords_factor;
+			item.polygon_mode = m_polygon_mode;
+			item.pass = m_transparent ? RenderQueue::TRANSPARENT_PASS : RenderQueue::OPAQUE_PASS;
+			item.lod = m_lod;
+			m_render->submit(queue, item);
 		}
+	}
 
-		m_render->draw(m_shader);
+	void updateLod(const glm::vec3& viewer_position) {
+		unsigned int num_lods = m_render->getNumLods();
+		if (num_lods <= 1)
+			return;
+
+		// Bounding sphere of the world box
+		glm::vec3 center = 0.5f * (m_world_box.min + m_world_box.max);
+		float radius = 0.5f * glm::length(m_world_box.max - m_world_box.min);
+		float distance = glm::length(center - viewer_position);
+		float screen_size = (distance > radius) ? Viewer::getProjectionMatrix()[1][1] * radius / distance : 1.f;
+
+		m_lod = selectLod(screen_size, m_lod, num_lods);
+	}
+
+	void updateLoading() {
+		if (!m_render->finishLoading())
+			return;
+
+		m_local_box = m_render->getLocalBoundingBox();
+		m_world_box = m_local_box.transform(m_model_mat);
+		m_bounds_version++;
+		m_lod = 0;
+	}
+
+	void setTransparent(bool transparent) {
+		m_transparent = transparent;
 	}
 
 	void setLocalTransform(const LocalTransform& local_tr) {
 		m_transform = local_tr;
-		m_model_mat = local_tr.getModelMatrix();
+		// The bodies at rest are given the same transform every frame, their box stays valid
+		const glm::mat4 model_mat = local_tr.getModelMatrix();
+		if (model_mat == m_model_mat)
+			return;
+		m_model_mat = model_mat;
+		m_world_box = m_local_box.transform(m_model_mat);
+		m_bounds_version++;
 	}
 
 	void setInvisible(bool visible = false) {
@@ -126,12 +186,30 @@ public:
 		return dynamic_cast<Primitive&>(*m_render);
 	}
 
+	Primitive& getPrimitive() {
+		return dynamic_cast<Primitive&>(*m_render);
+	}
+
+	const BoundingBox& getWorldBoundingBox() const {
+		return m_world_box;
+	}
+
+	uint32_t getBoundsVersion() const {
+		return m_bounds_version;
+	}
+
 private:
 	void init() {
 		m_model_mat = glm::mat4(1.f);
 		m_polygon_mode = GL_FILL;
 		m_texcoords_factor = glm::vec3(1);
 		m_visible = true;
+		m_transparent = false;
+		m_lod = 0;
+
+		m_local_box = m_render->getLocalBoundingBox();
+		m_world_box = m_local_box;
+		m_bounds_version = 0;
 	}
 
 private:
@@ -139,6 +217,10 @@ private:
 	glm::vec3 m_texcoords_factor;
 	// The model matrix relative to the renderable
 	glm::mat4 m_model_mat;
+	// Bounds of the primitive, computed once, and moved by the model matrix for the frustum culling
+	BoundingBox m_local_box;
+	BoundingBox m_world_box;
+	uint32_t m_bounds_version;
 	// Shader of the renderable
 	std::weak_ptr<Shader> m_shader;
 
@@ -148,4 +230,7 @@ private:
 	GLuint m_polygon_mode;
 
 	bool m_visible;
+	bool m_transparent;
+	// Current level of details
+	unsigned int m_lod;
 };
\ No newline at end of file
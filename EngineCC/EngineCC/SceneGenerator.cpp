@@ -0,0 +1,272 @@
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+
+#include <glm/glm.hpp>
+
+#include "SceneGenerator.h"
+#include "tinyxml2.h"
+
+using namespace tinyxml2;
+
+/// SceneGenerator::Parameters definitions
+namespace {
+	// The whole value must be a number, otherwise false is returned and the result is not modified
+	bool parseUnsigned(const std::string& value, unsigned int& result) {
+		// strtoul skips the spaces and accepts a minus sign
+		if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0])))
+			return false;
+		char* end = nullptr;
+		errno = 0;
+		unsigned long number = std::strtoul(value.c_str(), &end, 10);
+		if (end != value.c_str() + value.size() || errno == ERANGE || number > std::numeric_limits<unsigned int>::max())
+			return false;
+		result = static_cast<unsigned int>(number);
+		return true;
+	}
+
+	// The values below min are rejected too
+	bool parseFloat(const std::string& value, float min, float& result) {
+		if (value.empty() || std::isspace(static_cast<unsigned char>(value[0])))
+			return false;
+		char* end = nullptr;
+		errno = 0;
+		float number = std::strtof(value.c_str(), &end);
+		if (end != value.c_str() + value.size() || errno == ERANGE || !std::isfinite(number) || number < min)
+			return false;
+		result = number;
+		return true;
+	}
+}
+
+SceneGenerator::Parameters::Parameters() : num_entities(1000),
+										   dynamic_ratio(0.5f),
+										   model_weight(0.1f),
+										   cube_weight(0.8f),
+										   plane_weight(0.1f),
+										   distribution(UNIFORM),
+										   extent(100.f),
+										   hierarchy_depth(0),
+										   seed(1),
+										   model_filename("Content/sword.obj"),
+										   texture_filename("Content/bricks.jpg") {
+}
+
+bool SceneGenerator::Parameters::set(const std::string& key, const std::string& value) {
+	if (key == "entities")
+		return parseUnsigned(value, num_entities);
+	else if (key == "dynamic") {
+		if (!parseFloat(value, 0.f, dynamic_ratio))
+			return false;
+		dynamic_ratio = glm::clamp(dynamic_ratio, 0.f, 1.f);
+	}
+	// A negative weight would skew the choice of the renderables, the area cannot be empty
+	else if (key == "models")
+		return parseFloat(value, 0.f, model_weight);
+	else if (key == "cubes")
+		return parseFloat(value, 0.f, cube_weight);
+	else if (key == "planes")
+		return parseFloat(value, 0.f, plane_weight);
+	else if (key == "extent")
+		return parseFloat(value, std::numeric_limits<float>::min(), extent);
+	else if (key == "depth")
+		return parseUnsigned(value, hierarchy_depth);
+	else if (key == "seed")
+		return parseUnsigned(value, seed);
+	else if (key == "model")
+		model_filename = value;
+	else if (key == "texture")
+		texture_filename = value;
+	else if (key == "distribution") {
+		if (value == "uniform")
+			distribution = UNIFORM;
+		else if (value == "grid")
+			distribution = GRID;
+		else if (value == "clustered")
+			distribution = CLUSTERED;
+		else
+			return false;
+	}
+	else
+		return false;
+
+	return true;
+}
+
+/// SceneGenerator definitions
+std::string SceneGenerator::getKindName(RenderableType renderable_type, bool dynamic) {
+	const char* renderable_names[NUM_RENDERABLE_TYPES] = { "model", "cube", "plane" };
+	return std::string("stress") + renderable_names[renderable_type] + (dynamic ? "dynamic" : "static");
+}
+
+bool SceneGenerator::writeEntityFile(const std::string& filename, const std::string& kind_name, RenderableType renderable_type, bool dynamic, const Parameters& params) {
+	// Same layout as the files saved by the entity creation window
+	XMLDocument doc;
+	XMLNode* root = doc.NewElement("Root");
+	doc.InsertFirstChild(root);
+
+	XMLElement* name_elt = doc.NewElement("Name");
+	name_elt->SetText(kind_name.c_str());
+	root->InsertEndChild(name_elt);
+
+	XMLElement* components = doc.NewElement("Components");
+	root->InsertEndChild(components);
+
+	XMLElement* render_elt = doc.NewElement("Render");
+	if (renderable_type == MODEL) {
+		render_elt->SetAttribute("renderable_type", "model");
+		render_elt->SetAttribute("filename", params.model_filename.c_str());
+	}
+	else {
+		render_elt->SetAttribute("renderable_type", (renderable_type == CUBE) ? "cube" : "plane");
+		render_elt->SetAttribute("texture_path", params.texture_filename.c_str());
+	}
+	components->InsertEndChild(render_elt);
+
+	XMLElement* physic_elt = doc.NewElement("Physics");
+	XMLElement* mass_elt = doc.NewElement("mass");
+	mass_elt->SetText(dynamic ? 1.f : 0.f);
+	physic_elt->InsertEndChild(mass_elt);
+	XMLElement* ang_rot_elt = doc.NewElement("angular_rotation_disabled");
+	ang_rot_elt->SetText(false);
+	physic_elt->InsertEndChild(ang_rot_elt);
+	components->InsertEndChild(physic_elt);
+
+	if (doc.SaveFile(filename.c_str()) != XML_SUCCESS) {
+		std::cout << "Unable to write the entity file " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool SceneGenerator::generate(const std::string& directory, const std::string& scene_name, const Parameters& params) {
+	std::string prefix = directory;
+	if (!prefix.empty() && prefix.back() != '/' && prefix.back() != '\\')
+		prefix += "/";
+
+	/// Component files of the kinds of entity
+	for (unsigned int type = 0; type < NUM_RENDERABLE_TYPES; ++type) {
+		for (unsigned int dynamic = 0; dynamic < 2; ++dynamic) {
+			RenderableType renderable_type = static_cast<RenderableType>(type);
+			const std::string& kind_name = getKindName(renderable_type, dynamic != 0);
+			if (!writeEntityFile(prefix + kind_name + ".xml", kind_name, renderable_type, dynamic != 0, params))
+				return false;
+		}
+	}
+
+	/// Scene file
+	// It is streamed instead of being built as a DOM so that scenes of millions of entities can be written
+	const std::string scene_filename = prefix + scene_name + ".xml";
+	std::ofstream file(scene_filename);
+	if (!file.is_open()) {
+		std::cout << "Unable to write the scene file " << scene_filename << std::endl;
+		return false;
+	}
+
+	std::mt19937 generator(params.seed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::normal_distribution<float> normal(0.f, 1.f);
+
+	float sum_weights = params.model_weight + params.cube_weight + params.plane_weight;
+	if (sum_weights <= 0.f) {
+		std::cout << "The weights of the renderable types must not be all null" << std::endl;
+		return false;
+	}
+
+	// Centers of the clusters
+	const unsigned int num_clusters = 16;
+	std::vector<glm::vec2> clusters;
+	for (unsigned int i = 0; i < num_clusters; ++i) {
+		clusters.push_back(glm::vec2((2.f * unit(generator) - 1.f) * params.extent, (2.f * unit(generator) - 1.f) * params.extent));
+	}
+
+	// The grid distribution places the roots of the chains only
+	const unsigned int chain_length = params.hierarchy_depth + 1;
+	const unsigned int num_roots = (params.num_entities + chain_length - 1) / chain_length;
+	const unsigned int grid_side = std::max(1u, static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(num_roots)))));
+	const float grid_spacing = 2.f * params.extent / grid_side;
+
+	std::string parent_name;
+	glm::vec3 parent_position(0.f);
+	unsigned int num_dynamic = 0;
+
+	file << "<Root>" << std::endl;
+	file << "    <ListEntities>" << std::endl;
+	for (unsigned int i = 0; i < params.num_entities; ++i) {
+		/// Kind of the entity
+		float kind = unit(generator) * sum_weights;
+		RenderableType renderable_type = (kind < params.model_weight) ? MODEL : ((kind < params.model_weight + params.cube_weight) ? CUBE : PLANE);
+		bool dynamic = unit(generator) < params.dynamic_ratio;
+		num_dynamic += dynamic ? 1 : 0;
+
+		std::string name = getKindName(renderable_type, dynamic) + "_" + std::to_string(i);
+
+		/// Transform of the entity
+		glm::vec3 scale(0.5f + 1.5f * unit(generator));
+		if (renderable_type == PLANE)
+			scale = glm::vec3(4.f, 1.f, 4.f);
+		glm::vec3 rotation(0.f, 360.f * unit(generator), 0.f);
+		glm::vec3 texcoords_factor(1.f);
+		if (renderable_type == PLANE)
+			texcoords_factor = glm::vec3(scale.x / 4.f, scale.z / 4.f, 0.f);
+
+		// The first entity of a chain is placed following the distribution. The next ones are its descendants
+		// and are stacked above their parent
+		glm::vec3 position;
+		bool is_root = (i % chain_length) == 0;
+		if (is_root) {
+			glm::vec2 ground;
+			if (params.distribution == GRID) {
+				unsigned int cell = i / chain_length;
+				ground = glm::vec2(-params.extent + (cell % grid_side + 0.5f) * grid_spacing,
+					-params.extent + (cell / grid_side + 0.5f) * grid_spacing);
+			}
+			else if (params.distribution == CLUSTERED) {
+				const glm::vec2& center = clusters[generator() % num_clusters];
+				ground = center + glm::vec2(normal(generator), normal(generator)) * (params.extent / num_clusters);
+			}
+			else {
+				ground = glm::vec2((2.f * unit(generator) - 1.f) * params.extent, (2.f * unit(generator) - 1.f) * params.extent);
+			}
+
+			// The dynamic entities fall from a random height
+			float height = (renderable_type == PLANE) ? 0.f : scale.y / 2.f;
+			if (dynamic)
+				height += 2.f + 20.f * unit(generator);
+			position = glm::vec3(ground.x, height, ground.y);
+		}
+		else {
+			position = parent_position + glm::vec3(0.f, 1.5f * scale.y, 0.f);
+		}
+
+		file << "        <Entity name=\"" << name << "\"";
+		if (!is_root)
+			file << " parent=\"" << parent_name << "\"";
+		file << ">" << std::endl;
+		file << "            <Rotation X=\"" << rotation.x << "\" Y=\"" << rotation.y << "\" Z=\"" << rotation.z << "\"/>" << std::endl;
+		file << "            <Translation X=\"" << position.x << "\" Y=\"" << position.y << "\" Z=\"" << position.z << "\"/>" << std::endl;
+		file << "            <Scale X=\"" << scale.x << "\" Y=\"" << scale.y << "\" Z=\"" << scale.z << "\"/>" << std::endl;
+		file << "            <Texcoords_Factor X=\"" << texcoords_factor.x << "\" Y=\"" << texcoords_factor.y << "\" Z=\"" << texcoords_factor.z << "\"/>" << std::endl;
+		file << "        </Entity>" << std::endl;
+
+		parent_name = name;
+		parent_position = position;
+	}
+	file << "    </ListEntities>" << std::endl;
+	file << "</Root>" << std::endl;
+
+	if (!file.good()) {
+		std::cout << "Error while writing the scene file " << scene_filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Scene " << scene_filename << " generated : " << params.num_entities << " entities ("
+		<< num_dynamic << " dynamic), hierarchy depth " << params.hierarchy_depth << std::endl;
+	return true;
+}
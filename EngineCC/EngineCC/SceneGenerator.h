@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/// Procedural generation of stress scenes
+// Writes a scene file in the format read by the editor (ListEntities/Entity with Rotation, Translation, Scale
+// and Texcoords_Factor) and the component files of its entities in the same directory.
+// The same parameters (seed included) always give the same scene.
+// Run it with : EngineCC --generate-scene <directory> <scene_name> [key=value ...]
+class SceneGenerator {
+public:
+	enum Distribution {
+		// Uniformly on the square area
+		UNIFORM,
+		// On a regular grid covering the area
+		GRID,
+		// Around a few random centers
+		CLUSTERED
+	};
+
+	struct Parameters {
+		Parameters();
+
+		// Set a parameter from its name (entities, dynamic, models, cubes, planes, distribution, extent, depth, seed, model, texture)
+		// Returns false if the name or the value is not valid
+		bool set(const std::string& key, const std::string& value);
+
+		unsigned int num_entities;
+		// Ratio of the entities that have a mass, the other ones are static
+		float dynamic_ratio;
+		// Relative weights of the kinds of renderable
+		float model_weight;
+		float cube_weight;
+		float plane_weight;
+
+		Distribution distribution;
+		// Half size of the square area where the entities are placed
+		float extent;
+		// Number of ancestors of the deepest entity. The entities are grouped in chains of depth + 1 entities
+		// where each one is the parent of the next one. 0 gives a flat scene
+		unsigned int hierarchy_depth;
+		unsigned int seed;
+
+		// Relative to the working directory so that generated scenes can be moved between machines
+		std::string model_filename;
+		std::string texture_filename;
+	};
+
+	// Returns false if one of the files cannot be written
+	static bool generate(const std::string& directory, const std::string& scene_name, const Parameters& params);
+
+private:
+	enum RenderableType {
+		MODEL,
+		CUBE,
+		PLANE,
+		NUM_RENDERABLE_TYPES
+	};
+
+	// Name of the component file of the kind of entity. It must not contain any '_'
+	// because the loaders take the file name as the part of the entity name before the first '_'
+	static std::string getKindName(RenderableType renderable_type, bool dynamic);
+
+	static bool writeEntityFile(const std::string& filename, const std::string& kind_name, RenderableType renderable_type, bool dynamic, const Parameters& params);
+};
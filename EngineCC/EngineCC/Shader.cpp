@@ -1,2 +1,273 @@
 #include "Shader.h"
+#include "BinaryFile.h"
+
+namespace {
+	// Interned uniform names. Ids are given in the order the names are first seen
+	std::unordered_map<std::string, UniformId>& getUniformIds() {
+		static std::unordered_map<std::string, UniformId> uniform_ids;
+		return uniform_ids;
+	}
+
+	// The arrays are reported as "name[0]", they are accessed by their name without the index
+	std::string stripArrayIndex(const GLchar* name) {
+		std::string res(name);
+		size_t bracket = res.find('[');
+		if (bracket != std::string::npos)
+			res.erase(bracket);
+		return res;
+	}
+}
+
+Shader::Shader(const std::string& vertex_obj_filename,
+			   const std::string& fragment_obj_filename) : m_vertex_filename(vertex_obj_filename),
+														   m_fragment_filename(fragment_obj_filename),
+														   m_cache_filename(vertex_obj_filename + "+" + fragment_obj_filename + ".programcache"),
+														   m_cache_key(0),
+														   m_vertex_shader(0),
+														   m_fragment_shader(0),
+														   m_linking(false),
+														   m_from_cache(false) {
+	TRACE_SCOPE("Shader::Shader");
+	// Read the shader object files and store their content in strings
+	std::string vertex_source;
+	std::string fragment_source;
+	read_file(vertex_obj_filename, vertex_source);
+	read_file(fragment_obj_filename, fragment_source);
+	m_cache_key = computeCacheKey(vertex_source, fragment_source);
+
+	// Create shader program
+	m_program = glCreateProgram();
+	if (loadBinary()) {
+		m_from_cache = true;
+		reflect();
+		return;
+	}
+
+	// A program whose binary was rejected is replaced by a new one
+	glDeleteProgram(m_program);
+	m_program = glCreateProgram();
+	glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	m_vertex_shader = attachShader(vertex_source, GL_VERTEX_SHADER);
+	m_fragment_shader = attachShader(fragment_source, GL_FRAGMENT_SHADER);
+
+	// Link the program, its status is only queried by finishLinking so that the driver can compile in the background
+	glLinkProgram(m_program);
+	m_linking = true;
+}
+
+void Shader::finishLinking() {
+	if (!m_linking)
+		return;
+	TRACE_SCOPE("Shader::finishLinking");
+	m_linking = false;
+
+	checkShader(m_vertex_shader, m_vertex_filename);
+	checkShader(m_fragment_shader, m_fragment_filename);
+
+	// Check if the link is ok
+	GLint success;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+	if (success == 0) {
+		GLchar log[1024];
+		glGetProgramInfoLog(m_program, sizeof(log), NULL, log);
+		fprintf(stderr, "Error linking shader program: '%s'\n", log);
+		exit(0);
+	}
+
+	// The binary of the program keeps what it needs from the shader objects
+	glDetachShader(m_program, m_vertex_shader);
+	glDetachShader(m_program, m_fragment_shader);
+	glDeleteShader(m_vertex_shader);
+	glDeleteShader(m_fragment_shader);
+	m_vertex_shader = 0;
+	m_fragment_shader = 0;
+
+	saveBinary();
+	reflect();
+
+	//Validate the program. Do it once after linking
+	glValidateProgram(m_program);
+}
+
+void Shader::enableParallelCompile() {
+	if (GLEW_ARB_parallel_shader_compile) {
+		// As many threads as the driver wants
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+}
+
+void Shader::checkShader(GLuint shader_object, const std::string& filename) const {
+	GLint success;
+	glGetShaderiv(shader_object, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		GLchar log[1024];
+		glGetShaderInfoLog(shader_object, sizeof(log), NULL, log);
+		fprintf(stderr, "Error compiling shader %s: '%s'\n", filename.c_str(), log);
+		exit(0);
+	}
+}
+
+uint64_t Shader::computeCacheKey(const std::string& vertex_source, const std::string& fragment_source) const {
+	// The defines of a variant are part of its sources
+	uint64_t key = hashBytes(vertex_source.data(), vertex_source.size());
+	key = hashBytes(fragment_source.data(), fragment_source.size(), key);
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		const char* value = reinterpret_cast<const char*>(glGetString(name));
+		if (value)
+			key = hashBytes(value, std::strlen(value), key);
+	}
+	return key;
+}
+
+bool Shader::loadBinary() {
+	TRACE_SCOPE("Shader::loadBinary");
+	MappedFile file;
+	if (!file.open(m_cache_filename))
+		return false;
+
+	BinaryReader reader(file.getData(), file.getSize());
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint64_t key = 0;
+	GLenum format = 0;
+	uint32_t size = 0;
+	if (!reader.readValue(magic) || !reader.readValue(version) || !reader.readValue(key) ||
+		magic != PROGRAM_CACHE_MAGIC || version != PROGRAM_CACHE_VERSION || key != m_cache_key || !reader.readValue(format))
+		return false;
+	const unsigned char* binary = reader.readArrayData<unsigned char>(size);
+	if (binary == nullptr)
+		return false;
+
+	glProgramBinary(m_program, format, binary, size);
+	GLint success;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+	if (success == 0) {
+		std::cout << "The driver rejected the program binary " << m_cache_filename << ", the program is compiled" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Shader::saveBinary() const {
+	TRACE_SCOPE("Shader::saveBinary");
+	GLint length = 0;
+	glGetProgramiv(m_program, GL_PROGRAM_BINARY_LENGTH, &length);
+	// The driver may not support any binary format
+	if (length <= 0)
+		return;
+
+	std::vector<unsigned char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(m_program, length, &length, &format, binary.data());
+	binary.resize(length);
+
+	BinaryWriter writer;
+	writer.writeValue<uint32_t>(PROGRAM_CACHE_MAGIC);
+	writer.writeValue<uint32_t>(PROGRAM_CACHE_VERSION);
+	writer.writeValue(m_cache_key);
+	writer.writeValue(format);
+	writer.writeArray(binary);
+	if (!writer.save(m_cache_filename))
+		std::cout << "Unable to write the program binary " << m_cache_filename << std::endl;
+}
+
+UniformId Shader::getUniformId(const std::string& name) {
+	std::unordered_map<std::string, UniformId>& uniform_ids = getUniformIds();
+	auto it = uniform_ids.find(name);
+	if (it != uniform_ids.end())
+		return it->second;
+
+	UniformId id = static_cast<UniformId>(uniform_ids.size());
+	uniform_ids.emplace(name, id);
+	return id;
+}
+
+void Shader::reflect() {
+	GLint max_name_length = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+	GLint max_attribute_length = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_attribute_length);
+	GLint max_block_length = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_block_length);
+	std::vector<GLchar> name(std::max(std::max(max_name_length, max_attribute_length), std::max(max_block_length, 1)));
+
+	/// Uniforms
+	m_uniforms.clear();
+	GLint num_uniforms = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &num_uniforms);
+	for (GLint i = 0; i < num_uniforms; ++i) {
+		Uniform uniform;
+		glGetActiveUniform(m_program, i, name.size(), NULL, &uniform.size, &uniform.type, name.data());
+		uniform.location = glGetUniformLocation(m_program, name.data());
+		// The members of the uniform blocks have no location, they are set through buffers
+		if (uniform.location == -1)
+			continue;
+		uniform.cached = false;
+
+		UniformId id = getUniformId(stripArrayIndex(name.data()));
+		if (id >= m_uniforms.size()) {
+			Uniform unused;
+			unused.location = -1;
+			unused.type = GL_NONE;
+			unused.size = 0;
+			unused.cached = false;
+			m_uniforms.resize(id + 1, unused);
+		}
+		m_uniforms[id] = uniform;
+	}
+
+	/// Attributes
+	m_attributes.clear();
+	GLint num_attributes = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTES, &num_attributes);
+	for (GLint i = 0; i < num_attributes; ++i) {
+		Attribute attribute;
+		GLint size;
+		glGetActiveAttrib(m_program, i, name.size(), NULL, &size, &attribute.type, name.data());
+		attribute.name = name.data();
+		attribute.location = glGetAttribLocation(m_program, name.data());
+		m_attributes.push_back(attribute);
+	}
+
+	/// Uniform blocks
+	m_uniform_blocks.clear();
+	GLint num_blocks = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &num_blocks);
+	for (GLint i = 0; i < num_blocks; ++i) {
+		UniformBlock block;
+		glGetActiveUniformBlockName(m_program, i, name.size(), NULL, name.data());
+		block.name = name.data();
+		block.index = i;
+		glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+		m_uniform_blocks.push_back(block);
+	}
+}
+
+GLint Shader::getAttributeLocation(const std::string& attribute) const {
+	for (const Attribute& attr : m_attributes) {
+		if (attr.name == attribute)
+			return attr.location;
+	}
+	return -1;
+}
+
+GLuint Shader::getUniformBlockIndex(const std::string& block) const {
+	for (const UniformBlock& uniform_block : m_uniform_blocks) {
+		if (uniform_block.name == block)
+			return uniform_block.index;
+	}
+	return GL_INVALID_INDEX;
+}
+
+void Shader::setUniformBlockBinding(const std::string& block, GLuint binding) const {
+	GLuint index = getUniformBlockIndex(block);
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(m_program, index, binding);
+}
+
+void Shader::setStorageBlockBinding(const std::string& block, GLuint binding) const {
+	GLuint index = glGetProgramResourceIndex(m_program, GL_SHADER_STORAGE_BLOCK, block.c_str());
+	if (index != GL_INVALID_INDEX)
+		glShaderStorageBlockBinding(m_program, index, binding);
+}
 
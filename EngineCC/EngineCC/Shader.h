@@ -3,9 +3,30 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
 #include <iostream>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "Dependencies\glew\glew.h"
+#include "Trace.h"
+
+// Dense id of an uniform name, shared by all the programs
+typedef unsigned int UniformId;
+
+/// Program binary cache
+// A linked program is saved with glGetProgramBinary in <vertex>+<fragment>.programcache and loaded back with glProgramBinary
+// on the next launches, nothing is compiled. The driver can reject a binary (e.g. after an update), the program is then compiled.
+// Header : magic number, version, key, binary format, binary. The key is a hash of the sources and of the vendor, renderer
+// and version strings of the driver, so an edited shader or another driver compiles the program again
+#define PROGRAM_CACHE_MAGIC 0x50524345
+#define PROGRAM_CACHE_VERSION 1
 
 class Shader
 {
@@ -21,13 +42,12 @@ public:
 		file.close();
 	}
 
-	void attachShader(const std::string& filemane, GLuint shader_type) {
+	// Compile a shader object and attach it to the program, its status is checked by finishLinking
+	GLuint attachShader(const std::string& content, GLuint shader_type) {
+		TRACE_SCOPE("Shader::attachShader");
 		// Instantiate object shader (e.g. vertex, geometry, fragment)
 		GLuint shader_object = glCreateShader(shader_type);
 
-		// Read the shader object file and store its content in a string
-		std::string content;
-		read_file(filemane, content);
 		const GLchar* p[1];
 		p[0] = content.c_str();
 
@@ -36,58 +56,180 @@ public:
 		glShaderSource(shader_object, 1, p, &length);
 		glCompileShader(shader_object);
 
-		GLint success;
-		glGetShaderiv(shader_object, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			GLchar log[1024];
-			glGetShaderInfoLog(shader_object, sizeof(log), NULL, log);
-			fprintf(stderr, "Error compiling shader type %d: '%s'\n", GL_VERTEX_SHADER, log);
-			exit(0);
-		}
-
 		// Attach the shader object to its program
 		glAttachShader(m_program, shader_object);
+		return shader_object;
 	}
 
-	void linkProgram() {
-		// Link the program and check if all is ok
-		glLinkProgram(m_program);
+	// The program is read from the binary cache when it is valid. Otherwise its shaders are compiled and linked, with
+	// the parallel compile extension the driver does it in the background : finishLinking must be called before
+	// the program is used, after the other programs have been created so that they are compiled together
+	Shader(const std::string& vertex_obj_filename,
+		   const std::string& fragment_obj_filename);
+
+	~Shader() {
 
-		GLint success;
-		glGetProgramiv(m_program, GL_LINK_STATUS, &success);
-		if (success == 0) {
-			GLchar log[1024];
-			glGetProgramInfoLog(m_program, sizeof(log), NULL, log);
-			fprintf(stderr, "Error linking shader program: '%s'\n", log);
-			exit(0);
-		}
 	}
 
-	Shader(const std::string& vertex_obj_filename,
-		   const std::string& fragment_obj_filename) {
-		// Create shader program
-		m_program = glCreateProgram();
-		attachShader(vertex_obj_filename, GL_VERTEX_SHADER);
-		attachShader(fragment_obj_filename, GL_FRAGMENT_SHADER);
+	void bind() const {
+		glUseProgram(m_program);
+	}
+
+	GLuint getProgram() const {
+		return m_program;
+	}
 
-		linkProgram();
+	// Wait for the compilation and the link, report their errors and save the binary of the program
+	void finishLinking();
 
-		//Validate the program. Do it once after linking
-		glValidateProgram(m_program);
+	// True if the program was loaded from the binary cache
+	bool isFromCache() const {
+		return m_from_cache;
 	}
 
-	~Shader() {
+	// Let the driver compile the shaders on its own threads (ARB/KHR_parallel_shader_compile), if it supports it
+	static void enableParallelCompile();
 
+	// Program reading the model matrix and the texcoords factor from the per instance attributes
+	// instead of the uniforms. The render queue uses it to draw identical items in one call
+	void setInstancedVariant(const std::shared_ptr<Shader>& instanced) {
+		m_instanced_variant = instanced;
 	}
 
-	void bind() const {
-		glUseProgram(m_program);
+	Shader* getInstancedVariant() const {
+		return m_instanced_variant.get();
+	}
+
+	// Intern an uniform name. The id is valid for all the programs so it can be kept in a static
+	// by the code drawing with several shaders
+	static UniformId getUniformId(const std::string& name);
+
+	GLint getUniformLocation(UniformId id) const {
+		return (id < m_uniforms.size()) ? m_uniforms[id].location : -1;
+	}
+
+	GLint getUniformLocation(const std::string& uniform) const {
+		return getUniformLocation(getUniformId(uniform));
+	}
+
+	GLint getAttributeLocation(const std::string& attribute) const;
+	// Index of an uniform block, GL_INVALID_INDEX if the program does not use it
+	GLuint getUniformBlockIndex(const std::string& block) const;
+	void setUniformBlockBinding(const std::string& block, GLuint binding) const;
+	// Does nothing if the program does not use the shader storage block
+	void setStorageBlockBinding(const std::string& block, GLuint binding) const;
+
+	/// Typed setters
+	// The values are uploaded with glProgramUniform so the program does not need to be bound.
+	// The last value set is cached and the upload is skipped when it has not changed.
+	// Setting an uniform that the program does not use does nothing
+	void setUniform(UniformId id, const glm::mat4& value) {
+		Uniform* uniform = getUniform(id);
+		if (uniform && updateCache(*uniform, glm::value_ptr(value), sizeof(glm::mat4)))
+			glProgramUniformMatrix4fv(m_program, uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setUniform(UniformId id, const glm::vec4& value) {
+		Uniform* uniform = getUniform(id);
+		if (uniform && updateCache(*uniform, glm::value_ptr(value), sizeof(glm::vec4)))
+			glProgramUniform4fv(m_program, uniform->location, 1, glm::value_ptr(value));
+	}
+
+	void setUniform(UniformId id, const glm::vec3& value) {
+		Uniform* uniform = getUniform(id);
+		if (uniform && updateCache(*uniform, glm::value_ptr(value), sizeof(glm::vec3)))
+			glProgramUniform3fv(m_program, uniform->location, 1, glm::value_ptr(value));
+	}
+
+	void setUniform(UniformId id, float value) {
+		Uniform* uniform = getUniform(id);
+		if (uniform && updateCache(*uniform, &value, sizeof(float)))
+			glProgramUniform1f(m_program, uniform->location, value);
+	}
+
+	// Also used for the samplers and the booleans
+	void setUniform(UniformId id, int value) {
+		Uniform* uniform = getUniform(id);
+		if (uniform && updateCache(*uniform, &value, sizeof(int)))
+			glProgramUniform1i(m_program, uniform->location, value);
+	}
+
+	// Arrays are not cached, comparing them would cost as much as uploading them
+	void setUniformMatrixArray(UniformId id, GLsizei count, const GLfloat* values, GLboolean transpose = GL_FALSE) {
+		Uniform* uniform = getUniform(id);
+		if (uniform)
+			glProgramUniformMatrix4fv(m_program, uniform->location, std::min<GLsizei>(count, uniform->size), transpose, values);
 	}
 
-	GLuint getUniformLocation(const std::string& uniform) const {
-		return glGetUniformLocation(m_program, static_cast<const GLchar*>(uniform.c_str()));
+private:
+	struct Uniform {
+		GLint location;
+		GLenum type;
+		// Number of elements for an array
+		GLint size;
+
+		// Last value uploaded, the biggest cached type is a mat4
+		bool cached;
+		std::array<GLfloat, 16> value;
+	};
+
+	struct Attribute {
+		std::string name;
+		GLint location;
+		GLenum type;
+	};
+
+	struct UniformBlock {
+		std::string name;
+		GLuint index;
+		GLint data_size;
+	};
+
+	// Introspect the active uniforms, attributes and uniform blocks once the program is linked
+	void reflect();
+
+	/// Program binary cache
+	uint64_t computeCacheKey(const std::string& vertex_source, const std::string& fragment_source) const;
+	// Returns false if there is no cache for the key or if the driver rejects the binary
+	bool loadBinary();
+	void saveBinary() const;
+	// Print the log of a shader that failed to compile and exit
+	void checkShader(GLuint shader_object, const std::string& filename) const;
+
+	Uniform* getUniform(UniformId id) {
+		if (id >= m_uniforms.size() || m_uniforms[id].location == -1)
+			return nullptr;
+		return &m_uniforms[id];
+	}
+
+	// Returns true if the value differs from the cached one
+	static bool updateCache(Uniform& uniform, const void* value, size_t size) {
+		if (uniform.cached && std::memcmp(uniform.value.data(), value, size) == 0)
+			return false;
+		std::memcpy(uniform.value.data(), value, size);
+		uniform.cached = true;
+		return true;
 	}
+
 private:
 	GLuint m_program;
+
+	std::string m_vertex_filename;
+	std::string m_fragment_filename;
+	std::string m_cache_filename;
+	uint64_t m_cache_key;
+	// Shaders compiled for the link in progress, 0 when the program was read from the cache
+	GLuint m_vertex_shader;
+	GLuint m_fragment_shader;
+	// Set until finishLinking has checked the link
+	bool m_linking;
+	bool m_from_cache;
+
+	// Indexed by the uniform ids, the ids of the names the program does not use have a -1 location
+	std::vector<Uniform> m_uniforms;
+	std::vector<Attribute> m_attributes;
+	std::vector<UniformBlock> m_uniform_blocks;
+
+	std::shared_ptr<Shader> m_instanced_variant;
 };
 
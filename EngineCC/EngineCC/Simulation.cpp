@@ -0,0 +1,253 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <functional>
+
+#include "Simulation.h"
+
+#include "World.h"
+#include "Singleton.h"
+#include "Components.h"
+#include "Model.h"
+#include "Manager.h"
+#include "EntityHierarchy.h"
+
+#include "PhysicSystem.h"
+#include "ScriptSystem.h"
+#include "AttackSystem.h"
+#include "PhysicConstraintSystem.h"
+#include "MovementSystem.h"
+
+namespace {
+	// Vertices of the unit primitives, i.e. what a Renderable<Cube> and a Renderable<Plane> give to the physics
+	std::vector<glm::vec3> getCubeVertices() {
+		std::vector<glm::vec3> vertices;
+		for (int i = 0; i < 8; ++i) {
+			vertices.push_back(glm::vec3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f));
+		}
+		return vertices;
+	}
+
+	std::vector<glm::vec3> getPlaneVertices() {
+		std::vector<glm::vec3> vertices;
+		vertices.push_back(glm::vec3(-0.5, 0, -0.5));
+		vertices.push_back(glm::vec3(0.5, 0, -0.5));
+		vertices.push_back(glm::vec3(0.5, 0, 0.5));
+		vertices.push_back(glm::vec3(-0.5, 0, 0.5));
+		return vertices;
+	}
+
+	double getPercentile(const std::vector<double>& sorted_values, double percentile) {
+		if (sorted_values.empty())
+			return 0.0;
+		std::size_t index = static_cast<std::size_t>(percentile * (sorted_values.size() - 1));
+		return sorted_values[index];
+	}
+
+	using Clock = std::chrono::high_resolution_clock;
+
+	double getElapsedMs(const Clock::time_point& start, const Clock::time_point& end) {
+		return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start).count();
+	}
+}
+
+Simulation::Simulation() {
+	World& world = Singleton<World>::getInstance();
+
+	/// Set up systems
+	// Same systems as the Game except the ones needing a viewer or the inputs (picking and rendering)
+	// The PhysicConstraintSystem is configured before so that he can accept the AddConstraint events
+	systems.add<PhysicConstraintSystem>();
+	systems.configure();
+
+	systems.add<PhysicSystem>(entities, *(world.dynamic_world), false);
+	systems.add<MovementSystem>();
+	systems.add<AttackSystem>();
+	// There is no player in a headless simulation
+	systems.add<ScriptSystem>(entityx::Entity());
+	systems.configure();
+}
+
+Simulation::~Simulation() {
+	// The hierarchies access the Physics components of their entities when they are deleted
+	EntityHierarchyManager::getInstance().getRessources().clear();
+
+	World& world = Singleton<World>::getInstance();
+	world.free();
+}
+
+bool Simulation::loadScene(const std::string& scene_filename) {
+	std::vector<std::pair<std::string, EditionWindow::Transform>> scene_entities;
+	std::vector<std::string> parents;
+	if (!EntityCreationPanel::readSceneFile(scene_filename, scene_entities, &parents))
+		return false;
+
+	// The entity files are stored next to the scene file
+	std::size_t pos_separator = scene_filename.find_last_of("\\/");
+	std::string directory = (pos_separator == std::string::npos) ? "" : scene_filename.substr(0, pos_separator + 1);
+
+	std::vector<entityx::Entity> scene_entity_handles(scene_entities.size());
+	for (unsigned int i = 0; i < scene_entities.size(); ++i) {
+		const std::string& entity_name = scene_entities[i].first;
+		const std::string& entity_filename = entity_name.substr(0, entity_name.find("_"));
+
+		XMLDocument doc;
+		EntityCreationPanel::ComponentsData data;
+		if (EntityCreationPanel::readEntityFile(doc, directory + entity_filename + ".xml", entity_name, data)) {
+			scene_entity_handles[i] = createEntity(data, scene_entities[i].second);
+		}
+	}
+
+	buildHierarchies(scene_entities, parents, scene_entity_handles);
+
+	std::cout << m_entity_names.size() << " entities loaded from " << scene_filename << std::endl;
+	return true;
+}
+
+void Simulation::buildHierarchies(const std::vector<std::pair<std::string, EditionWindow::Transform>>& scene_entities,
+								  const std::vector<std::string>& parents,
+								  const std::vector<entityx::Entity>& scene_entity_handles) {
+	// Indexes of the children of each entity
+	std::map<std::string, std::vector<unsigned int>> children;
+	for (unsigned int i = 0; i < parents.size(); ++i) {
+		if (!parents[i].empty())
+			children[parents[i]].push_back(i);
+	}
+	if (children.empty())
+		return;
+
+	// The local transform of a node is its transform in the basis of its parent.
+	// The scene file gives the world transforms of the entities
+	std::function<EntityHierarchyPtr(unsigned int, const btTransform&)> buildNode = [&](unsigned int index, const btTransform& parent_transform) {
+		btTransform world_transform = EditionWindow::toBtTransform(scene_entities[index].second);
+		EntityHierarchyPtr node = std::make_unique<EntityHierarchy>(scene_entity_handles[index], parent_transform.inverse() * world_transform);
+
+		std::map<std::string, std::vector<unsigned int>>::const_iterator it = children.find(scene_entities[index].first);
+		if (it != children.end()) {
+			for (unsigned int child : it->second) {
+				if (scene_entity_handles[child].valid())
+					node->addChild(buildNode(child, world_transform));
+			}
+		}
+		return node;
+	};
+
+	EntityHierarchyManager& entityHierarchyManager = EntityHierarchyManager::getInstance();
+	unsigned int num_hierarchies = 0;
+	for (unsigned int i = 0; i < scene_entities.size(); ++i) {
+		bool is_root = parents[i].empty() && children.find(scene_entities[i].first) != children.end();
+		if (is_root && scene_entity_handles[i].valid()) {
+			entityHierarchyManager.insertCopy(scene_entity_handles[i], buildNode(i, btTransform::getIdentity()));
+			num_hierarchies++;
+		}
+	}
+
+	std::cout << num_hierarchies << " entity hierarchies built" << std::endl;
+}
+
+entityx::Entity Simulation::createEntity(const EntityCreationPanel::ComponentsData& data, const EditionWindow::Transform& tr) {
+	std::vector<glm::vec3> vertices;
+	if (data.renderable_type == EntityCreationPanel::ComponentsData::MODEL) {
+		// A model file is shared by many entities, we read it only once
+		static std::map<std::string, std::vector<glm::vec3>> model_vertices;
+		if (model_vertices.find(data.filename) == model_vertices.end()) {
+			model_vertices[data.filename] = Model::readVertices(data.filename);
+		}
+		vertices = model_vertices[data.filename];
+	}
+	else if (data.renderable_type == EntityCreationPanel::ComponentsData::CUBE) {
+		vertices = getCubeVertices();
+	}
+	else {
+		vertices = getPlaneVertices();
+	}
+
+	if (vertices.empty())
+		return entityx::Entity();
+
+	entityx::Entity entity = entities.create();
+	Physics physics = EntityCreationPanel::createPhysicsComponent(data, vertices);
+	entity.assign<Physics>(physics);
+
+	// Place the entity as the editor does
+	physics.rigid_body->setWorldTransform(EditionWindow::toBtTransform(tr));
+	physics.collision_shape->setLocalScaling(btVector3(tr.scale.x, tr.scale.y, tr.scale.z));
+
+	World& world = Singleton<World>::getInstance();
+	world.addEntity(data.name, entity);
+	m_entity_names.push_back(data.name);
+
+	return entity;
+}
+
+void Simulation::run(unsigned int num_frames, bool print_frames) {
+	const entityx::TimeDelta dt = 1.f / 60.f;
+	const char* system_names[] = { "constraints", "physic", "movement", "attack", "script" };
+	const unsigned int num_systems = sizeof(system_names) / sizeof(system_names[0]);
+
+	std::vector<double> frame_times;
+	frame_times.reserve(num_frames);
+	std::vector<double> system_total_times(num_systems, 0.0);
+	double system_times[num_systems];
+
+	Clock::time_point start_run = Clock::now();
+	for (unsigned int i = 0; i < num_frames; ++i) {
+		Clock::time_point start_frame = Clock::now();
+		Clock::time_point start = start_frame;
+		Clock::time_point end;
+
+		// Each system is updated on its own so that we can time it
+		systems.update<PhysicConstraintSystem>(dt);
+		end = Clock::now(); system_times[0] = getElapsedMs(start, end); start = end;
+		systems.update<PhysicSystem>(dt);
+		end = Clock::now(); system_times[1] = getElapsedMs(start, end); start = end;
+		systems.update<MovementSystem>(dt);
+		end = Clock::now(); system_times[2] = getElapsedMs(start, end); start = end;
+		systems.update<AttackSystem>(dt);
+		end = Clock::now(); system_times[3] = getElapsedMs(start, end); start = end;
+		systems.update<ScriptSystem>(dt);
+		end = Clock::now(); system_times[4] = getElapsedMs(start, end);
+
+		double frame_time = getElapsedMs(start_frame, end);
+		frame_times.push_back(frame_time);
+		for (unsigned int k = 0; k < num_systems; ++k) {
+			system_total_times[k] += system_times[k];
+		}
+
+		if (print_frames) {
+			std::cout << "frame " << i << " : " << std::fixed << std::setprecision(3) << frame_time << " ms (";
+			for (unsigned int k = 0; k < num_systems; ++k) {
+				std::cout << system_names[k] << " " << system_times[k] << ((k + 1 < num_systems) ? ", " : ")");
+			}
+			std::cout << std::endl;
+		}
+	}
+	double total_time = getElapsedMs(start_run, Clock::now());
+
+	if (frame_times.empty())
+		return;
+
+	/// Aggregated timings
+	std::vector<double> sorted_frame_times = frame_times;
+	std::sort(sorted_frame_times.begin(), sorted_frame_times.end());
+	double sum_frame_times = 0.0;
+	for (unsigned int i = 0; i < frame_times.size(); ++i) {
+		sum_frame_times += frame_times[i];
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "---- Headless simulation : " << m_entity_names.size() << " entities, " << frame_times.size() << " frames ----" << std::endl;
+	std::cout << "total    : " << total_time << " ms" << std::endl;
+	std::cout << "mean     : " << sum_frame_times / frame_times.size() << " ms/frame" << std::endl;
+	std::cout << "min      : " << sorted_frame_times.front() << " ms" << std::endl;
+	std::cout << "median   : " << getPercentile(sorted_frame_times, 0.5) << " ms" << std::endl;
+	std::cout << "p99      : " << getPercentile(sorted_frame_times, 0.99) << " ms" << std::endl;
+	std::cout << "max      : " << sorted_frame_times.back() << " ms" << std::endl;
+	std::cout << "rate     : " << std::setprecision(1) << 1000.0 * frame_times.size() / total_time << " frames/s" << std::endl;
+	std::cout << std::setprecision(3);
+	for (unsigned int k = 0; k < num_systems; ++k) {
+		std::cout << system_names[k] << " : " << system_total_times[k] / frame_times.size() << " ms/frame" << std::endl;
+	}
+}
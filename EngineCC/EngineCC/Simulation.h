@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <entityx/entityx.h>
+
+#include "EntityEditionPanel.h"
+
+/// Headless simulation of a scene
+// Runs the gameplay systems (physics, movement, scripts, attacks and constraints) without
+// any SDL window nor OpenGL context. The entities of the scene are created with their Physics
+// component only. It is used to measure the simulation throughput apart from the GPU and the vsync.
+class Simulation : public entityx::EntityX {
+public:
+	Simulation();
+	virtual ~Simulation();
+
+	// Load the entities of a scene saved by the editor or written by the SceneGenerator.
+	// The XML files of the entities are searched in the directory of the scene file.
+	// The parents given in the scene file are turned into entity hierarchies.
+	// Returns false if the scene file cannot be read
+	bool loadScene(const std::string& scene_filename);
+
+	// Step the systems num_frames times with a fixed time step as fast as possible
+	// and print the timings of each frame (if print_frames is set) and the aggregated ones
+	void run(unsigned int num_frames, bool print_frames = true);
+
+private:
+	// Returns an invalid entity if its vertices cannot be read
+	entityx::Entity createEntity(const EntityCreationPanel::ComponentsData& data, const EditionWindow::Transform& tr);
+
+	void buildHierarchies(const std::vector<std::pair<std::string, EditionWindow::Transform>>& scene_entities,
+						  const std::vector<std::string>& parents,
+						  const std::vector<entityx::Entity>& scene_entity_handles);
+
+private:
+	std::vector<std::string> m_entity_names;
+};
@@ -1,84 +1,339 @@
 #include <memory>
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include "Texture.h"
+#include "AssetCache.h"
+#include "AssetLoader.h"
+#include "Trace.h"
 
-Texture::Texture(const std::string& filename) : m_filename(filename) {
+namespace {
+	// Texel shown until the file is loaded
+	const unsigned char placeholder_texel[4] = { 128, 128, 128, 255 };
+}
+
+Texture::Texture(const std::string& filename) : m_index(0),
+												m_filename(filename),
+												m_loaded(false) {
 }
 
 Texture::~Texture() {
 	glDeleteTextures(1, &m_index);
 }
 
-/// SimpleTexture function definitions
-SimpleTexture::SimpleTexture(const std::string& filename) : Texture(filename) {
+bool Texture::decode(const std::string& filename, Image& image) {
+	if (readBaked(filename, image))
+		return true;
+	return decodeImage(filename, image);
 }
 
-SimpleTexture::~SimpleTexture() {
-}
+bool Texture::decodeImage(const std::string& filename, Image& image) {
+	TRACE_SCOPE("Texture::decodeImage");
+	SDL_Surface* data = IMG_Load(filename.c_str());
+	if (data == NULL)
+		return false;
 
-bool SimpleTexture::load() {
-	bool res = true;
-	
-	glGenTextures(1, &m_index);
-	glBindTexture(GL_TEXTURE_2D, m_index);
+	// The format is read from the surface, the palettes, 16 bits and padded pixels are converted
+	switch (data->format->format) {
+	case SDL_PIXELFORMAT_RGB24:
+		image.internal_format = GL_RGB8;
+		image.format = GL_RGB;
+		break;
+	case SDL_PIXELFORMAT_BGR24:
+		image.internal_format = GL_RGB8;
+		image.format = GL_BGR;
+		break;
+	case SDL_PIXELFORMAT_BGRA32:
+		image.internal_format = GL_RGBA8;
+		image.format = GL_BGRA;
+		break;
+	default:
+		if (data->format->format != SDL_PIXELFORMAT_RGBA32) {
+			SDL_Surface* converted = SDL_ConvertSurfaceFormat(data, SDL_PIXELFORMAT_RGBA32, 0);
+			SDL_FreeSurface(data);
+			if (converted == NULL)
+				return false;
+			data = converted;
+		}
+		image.internal_format = GL_RGBA8;
+		image.format = GL_RGBA;
+		break;
+	}
+	image.num_channels = data->format->BytesPerPixel;
 
-	SDL_Surface* data = IMG_Load(m_filename.c_str());
-	if (data != NULL) {
-		if (m_filename.find(".png") < m_filename.size()) {
-			glTexImage2D(GL_TEXTURE_2D,
-				0,
-				GL_RGBA8,
-				data->w,
-				data->h,
-				0,
-				GL_RGBA,
-				GL_UNSIGNED_BYTE,
-				data->pixels);
+	// Size of all the levels, the rows of the surface are padded to its pitch
+	size_t size = 0;
+	int width = data->w;
+	int height = data->h;
+	while (true) {
+		Image::Level level = { width, height, size };
+		image.levels.push_back(level);
+		size += static_cast<size_t>(width) * height * image.num_channels;
+		if (width == 1 && height == 1)
+			break;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	image.pixels.resize(size);
+	image.data = image.pixels.data();
+	image.size = image.pixels.size();
+
+	const size_t row_size = static_cast<size_t>(data->w) * image.num_channels;
+	for (int y = 0; y < data->h; ++y) {
+		std::memcpy(&image.pixels[y * row_size], static_cast<const unsigned char*>(data->pixels) + y * data->pitch, row_size);
+	}
+	SDL_FreeSurface(data);
+
+	// Each level is the average of the 2x2 texels of the previous one, the last row or column is repeated for the odd sizes
+	const unsigned int num_channels = image.num_channels;
+	for (unsigned int i = 1; i < image.levels.size(); ++i) {
+		const Image::Level& src = image.levels[i - 1];
+		const Image::Level& dst = image.levels[i];
+		const unsigned char* src_pixels = &image.pixels[src.offset];
+		unsigned char* dst_pixels = &image.pixels[dst.offset];
+		for (int y = 0; y < dst.height; ++y) {
+			int y0 = std::min(2 * y, src.height - 1);
+			int y1 = std::min(2 * y + 1, src.height - 1);
+			for (int x = 0; x < dst.width; ++x) {
+				int x0 = std::min(2 * x, src.width - 1);
+				int x1 = std::min(2 * x + 1, src.width - 1);
+				for (unsigned int c = 0; c < num_channels; ++c) {
+					unsigned int sum = src_pixels[(y0 * src.width + x0) * num_channels + c] +
+						src_pixels[(y0 * src.width + x1) * num_channels + c] +
+						src_pixels[(y1 * src.width + x0) * num_channels + c] +
+						src_pixels[(y1 * src.width + x1) * num_channels + c];
+					dst_pixels[(y * dst.width + x) * num_channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
 		}
-		else if (m_filename.find(".tga") < m_filename.size()) {
-			glTexImage2D(GL_TEXTURE_2D,
-				0,
-				GL_RGB,
-				data->w,
-				data->h,
-				0,
-				GL_BGR,
-				GL_UNSIGNED_BYTE,
-				data->pixels);
+	}
+	return true;
+}
+
+bool Texture::readBaked(const std::string& filename, Image& image) {
+	TRACE_SCOPE("Texture::readBaked");
+	const std::string baked_filename = filename + BAKED_TEXTURE_EXTENSION;
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+	if (!file->open(baked_filename))
+		return false;
+
+	BinaryReader reader(file->getData(), file->getSize());
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint64_t source_size = 0;
+	uint64_t source_time = 0;
+	uint64_t source_hash = 0;
+	uint32_t internal_format = 0;
+	uint32_t format = 0;
+	uint32_t num_channels = 0;
+	uint32_t size = 0;
+	std::vector<Image::Level> levels;
+	if (!reader.readValue(magic) || !reader.readValue(version) || magic != BAKED_TEXTURE_MAGIC || version != BAKED_TEXTURE_VERSION ||
+		!reader.readValue(source_size) || !reader.readValue(source_time) || !reader.readValue(source_hash) || !reader.readValue(internal_format) || !reader.readValue(format) || !reader.readValue(num_channels) ||
+		!reader.readArray(levels)) {
+		std::cout << baked_filename << " is not a baked texture of this version" << std::endl;
+		return false;
+	}
+	const unsigned char* pixels = reader.readArrayData<unsigned char>(size);
+	if (pixels == nullptr || levels.empty())
+		return false;
+
+	// The image has been edited since it was baked. It is only read again when its size is the same but not its time (e.g. a copy)
+	uint64_t size_now = 0;
+	uint64_t time_now = 0;
+	if (getFileStatus(filename, size_now, time_now) && (size_now != source_size || time_now != source_time)) {
+		MappedFile source;
+		if (size_now != source_size || !source.open(filename) || hashBytes(source.getData(), source.getSize()) != source_hash) {
+			std::cout << baked_filename << " is older than " << filename << ", bake it again" << std::endl;
+			return false;
 		}
-		else {
-			glTexImage2D(GL_TEXTURE_2D,
-				0,
-				GL_RGB,
-				data->w,
-				data->h,
-				0,
-				GL_RGB,
-				GL_UNSIGNED_BYTE,
-				data->pixels);
+	}
+
+	// A truncated container would make OpenGL read past the mapping
+	for (const Image::Level& level : levels) {
+		if (level.width <= 0 || level.height <= 0 || level.offset > size ||
+			static_cast<size_t>(level.width) * level.height * num_channels > size - level.offset)
+			return false;
+	}
+
+	// The pages are read now by the worker, not by the upload on the main thread
+	volatile unsigned char sum = 0;
+	for (size_t i = 0; i < size; i += 4096) {
+		sum += pixels[i];
+	}
+
+	image.internal_format = internal_format;
+	image.format = format;
+	image.num_channels = num_channels;
+	image.levels.swap(levels);
+	image.data = pixels;
+	image.size = size;
+	image.baked_file = std::move(file);
+	return true;
+}
+
+bool Texture::bake(const std::string& filename) {
+	TRACE_SCOPE("Texture::bake");
+	Image image;
+	if (!decodeImage(filename, image)) {
+		std::cout << "Unable to read the image " << filename << std::endl;
+		return false;
+	}
+
+	MappedFile source;
+	uint64_t source_size = 0;
+	uint64_t source_time = 0;
+	if (!source.open(filename) || !getFileStatus(filename, source_size, source_time)) {
+		std::cout << "Unable to read the image " << filename << std::endl;
+		return false;
+	}
+
+	BinaryWriter writer;
+	writer.writeValue<uint32_t>(BAKED_TEXTURE_MAGIC);
+	writer.writeValue<uint32_t>(BAKED_TEXTURE_VERSION);
+	writer.writeValue<uint64_t>(source_size);
+	writer.writeValue<uint64_t>(source_time);
+	writer.writeValue<uint64_t>(hashBytes(source.getData(), source.getSize()));
+	writer.writeValue<uint32_t>(image.internal_format);
+	writer.writeValue<uint32_t>(image.format);
+	writer.writeValue<uint32_t>(image.num_channels);
+	writer.writeArray(image.levels);
+	writer.writeArray(image.pixels);
+
+	const std::string baked_filename = filename + BAKED_TEXTURE_EXTENSION;
+	if (!writer.save(baked_filename)) {
+		std::cout << "Unable to write " << baked_filename << std::endl;
+		return false;
+	}
+	std::cout << filename << " baked in " << baked_filename << " : " << image.levels[0].width << "x" << image.levels[0].height << ", "
+		<< image.levels.size() << " levels, " << image.size / 1024 << " KB" << std::endl;
+	return true;
+}
+
+bool Texture::uploadStep(const Image& image, UploadCursor& cursor) {
+	TRACE_SCOPE("Texture::uploadStep");
+	const GLenum target = getTarget();
+	const unsigned int num_faces = getNumFaces();
+	if (image.levels.empty())
+		return true;
+	if (cursor.level < 0) {
+		cursor.level = static_cast<int>(image.levels.size()) - 1;
+		cursor.row = 0;
+	}
+
+	const Image::Level& level = image.levels[cursor.level];
+	glBindTexture(target, m_index);
+	if (cursor.row == 0) {
+		// The storage of the level is allocated before its first band, the staging buffer is not bound yet
+		for (unsigned int face = 0; face < num_faces; ++face) {
+			glTexImage2D(getFaceTarget(face), cursor.level, image.internal_format, level.width, level.height, 0,
+				image.format, GL_UNSIGNED_BYTE, NULL);
 		}
+	}
 
-		SDL_FreeSurface(data);
-		std::cout << "Texture succeded to load at path: " << m_filename.c_str() << std::endl;
+	// The rows are tightly packed, the band is staged once for all the faces
+	const size_t row_size = static_cast<size_t>(level.width) * image.num_channels;
+	const int num_rows = std::min(level.height - cursor.row, std::max(1, static_cast<int>(ASSET_UPLOAD_STEP_BYTES / row_size)));
+	AssetLoader& loader = AssetLoader::getInstance();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	loader.beginPixelUpload(image.data + level.offset + cursor.row * row_size, num_rows * row_size);
+	for (unsigned int face = 0; face < num_faces; ++face) {
+		glTexSubImage2D(getFaceTarget(face), cursor.level, 0, cursor.row, level.width, num_rows, image.format, GL_UNSIGNED_BYTE, (void*)0);
 	}
-	else {
+	loader.endPixelUpload();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	cursor.row += num_rows;
+	if (cursor.row < level.height)
+		return false;
+
+	// The level is complete, the texture is sampled from it down to the smallest one
+	glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, cursor.level);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+	cursor.level--;
+	cursor.row = 0;
+	return cursor.level < 0;
+}
+
+bool Texture::finishLoading(const Image& image, bool decoded, UploadCursor& cursor) {
+	if (!decoded) {
 		std::cout << "Texture failed to load at path: " << m_filename.c_str() << std::endl;
-		res = false;
+		return true;
+	}
+
+	if (!uploadStep(image, cursor))
+		return false;
+	m_loaded = true;
+	std::cout << "Texture succeded to load at path: " << m_filename.c_str() << std::endl;
+	return true;
+}
+
+bool Texture::load() {
+	TRACE_SCOPE("Texture::load");
+	createPlaceholder();
+	Image image;
+	bool decoded = decode(m_filename, image);
+	UploadCursor cursor;
+	while (!finishLoading(image, decoded, cursor)) {
 	}
-	glGenerateMipmap(GL_TEXTURE_2D);
+	return decoded;
+}
+
+void Texture::loadAsync(const std::shared_ptr<Texture>& texture) {
+	texture->createPlaceholder();
+
+	// The texture may be released before its file is decoded
+	std::weak_ptr<Texture> weak_texture = texture;
+	std::string filename = texture->m_filename;
+	std::shared_ptr<Image> image = std::make_shared<Image>();
+	std::shared_ptr<bool> decoded = std::make_shared<bool>(false);
+	std::shared_ptr<UploadCursor> cursor = std::make_shared<UploadCursor>();
+	AssetLoader::getInstance().load([filename, image, decoded]() {
+		*decoded = decode(filename, *image);
+	}, [weak_texture, image, decoded, cursor]() {
+		if (std::shared_ptr<Texture> texture = weak_texture.lock())
+			return texture->finishLoading(*image, *decoded, *cursor);
+		return true;
+	});
+}
+
+/// SimpleTexture function definitions
+SimpleTexture::SimpleTexture(const std::string& filename) : Texture(filename) {
+}
+
+SimpleTexture::~SimpleTexture() {
+}
+
+std::shared_ptr<Texture> SimpleTexture::getShared(const std::string& filename) {
+	AssetCache<std::string, Texture>& textures = AssetCache<std::string, Texture>::getInstance();
+	return textures.get("2d:" + getCanonicalPath(filename), [&filename]() {
+		std::shared_ptr<Texture> texture = std::make_shared<SimpleTexture>(filename);
+		Texture::loadAsync(texture);
+		return texture;
+	});
+}
+
+void SimpleTexture::createPlaceholder() {
+	glGenTextures(1, &m_index);
+	glBindTexture(GL_TEXTURE_2D, m_index);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder_texel);
+
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+	// The placeholder has no mipmaps
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+}
 
-	return res;
+GLenum SimpleTexture::getTarget() const {
+	return GL_TEXTURE_2D;
 }
 
-void SimpleTexture::bind(const std::weak_ptr<Shader> program, const std::string& location) const {
+void SimpleTexture::bind(Shader& program, UniformId location) const {
 	glActiveTexture(GL_TEXTURE0);
-	if(auto program_str = program.lock())
-		glUniform1i(program_str->getUniformLocation(location), 0);
+	program.setUniform(location, 0);
 	glBindTexture(GL_TEXTURE_2D, m_index);
 }
 
@@ -90,45 +345,44 @@ CubeMapTexture::CubeMapTexture(const std::string& filename) : Texture(filename)
 CubeMapTexture::~CubeMapTexture() {
 }
 
-bool CubeMapTexture::load() {
+std::shared_ptr<Texture> CubeMapTexture::getShared(const std::string& filename) {
+	AssetCache<std::string, Texture>& textures = AssetCache<std::string, Texture>::getInstance();
+	return textures.get("cubemap:" + getCanonicalPath(filename), [&filename]() {
+		std::shared_ptr<Texture> texture = std::make_shared<CubeMapTexture>(filename);
+		Texture::loadAsync(texture);
+		return texture;
+	});
+}
+
+void CubeMapTexture::createPlaceholder() {
 	glGenTextures(1, &m_index);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, m_index);
-
-	SDL_Surface* data = IMG_Load(m_filename.c_str());
-	if (data != NULL) {
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGB, data->w, data->h, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, data->pixels);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGB, data->w, data->h, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, data->pixels);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGB, data->w, data->h, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, data->pixels);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGB, data->w, data->h, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, data->pixels);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGB, data->w, data->h, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, data->pixels);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGB, data->w, data->h, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, data->pixels);
-
-		SDL_FreeSurface(data);
-		std::cout << "Texture succeded to load at path: " << m_filename.c_str() << std::endl;
-	}
-	else {
-		std::cout << "Texture failed to load at path: " << m_filename.c_str() << std::endl;
+	for (GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X; face <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z; ++face) {
+		glTexImage2D(face, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder_texel);
 	}
 
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+}
 
-	return true;
+GLenum CubeMapTexture::getTarget() const {
+	return GL_TEXTURE_CUBE_MAP;
+}
+
+unsigned int CubeMapTexture::getNumFaces() const {
+	return 6;
+}
+
+GLenum CubeMapTexture::getFaceTarget(unsigned int face) const {
+	return GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
 }
 
-void CubeMapTexture::bind(const std::weak_ptr<Shader> program, const std::string& location) const {
+void CubeMapTexture::bind(Shader& program, UniformId location) const {
 	glActiveTexture(GL_TEXTURE0);
-	if (auto program_str = program.lock())
-		glUniform1i(program_str->getUniformLocation(location), 0);
+	program.setUniform(location, 0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, m_index);
 }
@@ -1,25 +1,123 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <vector>
 #include <iostream>
 
 #include "Dependencies\glew\glew.h"
 #include <SDL_image.h>
 
 #include "Shader.h"
+#include "BinaryFile.h"
+
+/// Baked textures
+// EngineCC --bake-textures <image>... writes next to each image a <image>.etex container holding its whole mip chain
+// in the internal format given to OpenGL. When it exists, the container is mapped and its levels are uploaded as they are,
+// the image is neither decoded nor filtered. The container keeps the size, the modification time and the hash of the file of the image :
+// the image is only hashed again when its time has changed but not its size. After an edit of the image the container is ignored and
+// the image is decoded until it is baked again. Without the image, the container is used as it is.
+// Header : magic number, version, size, time and hash of the image file, internal format, format, bytes per pixel,
+// levels (width, height, offset), pixels
+#define BAKED_TEXTURE_EXTENSION ".etex"
+#define BAKED_TEXTURE_MAGIC 0x58544345
+#define BAKED_TEXTURE_VERSION 3
 
 class Texture
 {
 public:
+	// Pixels of a file and their mipmaps, decoded without any OpenGL call
+	struct Image {
+		struct Level {
+			int width;
+			int height;
+			// Bytes from the start of the pixels
+			size_t offset;
+		};
+
+		Image() : data(nullptr),
+				  size(0) {
+		}
+
+		GLenum internal_format;
+		GLenum format;
+		// Bytes per pixel, the rows are tightly packed
+		unsigned int num_channels;
+		std::vector<Level> levels;
+
+		// Pixels of all the levels, in pixels for a decoded image or in the mapping of a baked one
+		const unsigned char* data;
+		size_t size;
+		std::vector<unsigned char> pixels;
+		std::unique_ptr<MappedFile> baked_file;
+	};
+
+	// Part of the image already uploaded. The levels are uploaded from the smallest one, by bands of rows
+	struct UploadCursor {
+		UploadCursor() : level(-1),
+						 row(0) {
+		}
+
+		// Level being uploaded, -1 before the first step
+		int level;
+		// First row of the level not uploaded yet
+		int row;
+	};
+
 	Texture(const std::string& filename);
 	~Texture();
 
-	virtual bool load() = 0;
-	virtual void bind(const std::weak_ptr<Shader> program, const std::string& location) const = 0;
+	// Decode and upload the file now
+	bool load();
+	// The texture shows a placeholder until the file is decoded on a worker thread and uploaded by the AssetLoader
+	static void loadAsync(const std::shared_ptr<Texture>& texture);
+
+	virtual void bind(Shader& program, UniformId location) const = 0;
+
+	GLuint getIndex() const {
+		return m_index;
+	}
+
+	// False while the placeholder is shown
+	bool isLoaded() const {
+		return m_loaded;
+	}
+
+	// Decode the image and write its container, returns false if the image cannot be read or the container written
+	static bool bake(const std::string& filename);
+
+protected:
+	// Read the baked container of the file if there is one, otherwise decode the file. Can be called from any thread
+	static bool decode(const std::string& filename, Image& image);
+	// Read the file and compute the mipmaps down to 1x1 with a box filter.
+	// The format is the one of the pixels read, the images that OpenGL cannot read as they are converted to RGBA
+	static bool decodeImage(const std::string& filename, Image& image);
+	// Map the container of the file and check its levels and the status of the file, the pixels are read from the mapping
+	static bool readBaked(const std::string& filename, Image& image);
+
+	// Create the texture with one grey texel, the parameters are set once for the placeholder and the image
+	virtual void createPlaceholder() = 0;
+	// Target the texture is bound to and targets of its faces (the texture itself for a 2D texture, six faces for a cube map)
+	virtual GLenum getTarget() const = 0;
+	virtual unsigned int getNumFaces() const {
+		return 1;
+	}
+	virtual GLenum getFaceTarget(unsigned int face) const {
+		return getTarget();
+	}
+
+	// Upload the next band of rows of the image, at most ASSET_UPLOAD_STEP_BYTES, through the staging buffer of the AssetLoader.
+	// A level is shown once it is complete : the base level of the texture follows the uploaded levels, from the smallest one.
+	// Returns true once the whole image is uploaded
+	bool uploadStep(const Image& image, UploadCursor& cursor);
+
+	// Upload the next part of the image, or keep the placeholder if the file could not be decoded. Returns true once it is done
+	bool finishLoading(const Image& image, bool decoded, UploadCursor& cursor);
 
 protected:
 	GLuint m_index;
 	std::string m_filename;
+	bool m_loaded;
 };
 
 class SimpleTexture : public Texture {
@@ -27,8 +125,14 @@ public:
 	SimpleTexture(const std::string& filename);
 	~SimpleTexture();
 
-	bool load();
-	void bind(const std::weak_ptr<Shader> program, const std::string& location) const;
+	// Texture loaded once and shared by all the renderables using the file, it is loaded asynchronously
+	static std::shared_ptr<Texture> getShared(const std::string& filename);
+
+	void bind(Shader& program, UniformId location) const;
+
+protected:
+	void createPlaceholder();
+	GLenum getTarget() const;
 };
 
 class CubeMapTexture : public Texture {
@@ -36,7 +140,14 @@ public:
 	CubeMapTexture(const std::string& filename);
 	~CubeMapTexture();
 
-	bool load();
-	void bind(const std::weak_ptr<Shader> program, const std::string& location) const;
-};
+	static std::shared_ptr<Texture> getShared(const std::string& filename);
 
+	void bind(Shader& program, UniformId location) const;
+
+protected:
+	void createPlaceholder();
+	GLenum getTarget() const;
+	// The image is given to the six faces
+	unsigned int getNumFaces() const;
+	GLenum getFaceTarget(unsigned int face) const;
+};
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <set>
+
+#include "Trace.h"
+
+/// Tracer::ScopedZone definitions
+Tracer::ScopedZone::ScopedZone(const char* name) : m_name(name),
+												   m_recording(Singleton<Tracer>::getInstance().isCapturing()) {
+	if (m_recording)
+		m_start = Clock::now();
+}
+
+Tracer::ScopedZone::~ScopedZone() {
+	// A zone started before the capture is not recorded
+	if (m_recording)
+		Singleton<Tracer>::getInstance().addZone(m_name, m_start, Clock::now());
+}
+
+/// Tracer definitions
+Tracer::Tracer() : m_num_frames_left(0),
+				   m_capturing(false) {
+	// The tracer is instanciated before main so the main thread gets the id 0
+	getThreadId();
+}
+
+Tracer::~Tracer() {
+}
+
+unsigned int Tracer::getThreadId() {
+	static std::atomic<unsigned int> num_threads(0);
+	thread_local unsigned int thread_id = num_threads.fetch_add(1);
+	return thread_id;
+}
+
+void Tracer::startCapture(const std::string& filename, unsigned int num_frames) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_capturing) {
+		std::cout << "A trace is already being captured in " << m_filename << std::endl;
+		return;
+	}
+
+	m_events.clear();
+	m_filename = filename;
+	m_num_frames_left = num_frames;
+	m_start_capture = Clock::now();
+	m_capturing.store(true, std::memory_order_release);
+
+	std::cout << "Capture of " << num_frames << " frames started" << std::endl;
+}
+
+bool Tracer::isCapturing() const {
+	// The zones out of a capture do not take the lock. addZone checks the flag again under it
+	return m_capturing.load(std::memory_order_acquire);
+}
+
+void Tracer::addZone(const char* name, const Clock::time_point& start, const Clock::time_point& end) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_capturing)
+		return;
+
+	Event event;
+	event.name = name;
+	event.start_us = std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(start - m_start_capture).count();
+	event.duration_us = std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(end - start).count();
+	event.thread_id = getThreadId();
+	m_events.push_back(event);
+}
+
+void Tracer::endFrame() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_capturing)
+			return;
+
+		if (m_num_frames_left > 1) {
+			m_num_frames_left--;
+			return;
+		}
+		m_capturing.store(false, std::memory_order_release);
+	}
+
+	write();
+}
+
+bool Tracer::write() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::ofstream file(m_filename);
+	if (!file.is_open()) {
+		std::cout << "Unable to write the trace in " << m_filename << std::endl;
+		return false;
+	}
+
+	/// Chrome trace-event format
+	// Every zone is a complete event ("X") with its duration. The threads are named with metadata events ("M")
+	std::set<unsigned int> thread_ids;
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+	file << std::fixed;
+	for (unsigned int i = 0; i < m_events.size(); ++i) {
+		const Event& event = m_events[i];
+		thread_ids.insert(event.thread_id);
+
+		file << "{\"name\":\"" << event.name << "\",\"cat\":\"engine\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread_id
+			<< ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us << "}," << std::endl;
+	}
+	for (std::set<unsigned int>::const_iterator it = thread_ids.cbegin(); it != thread_ids.cend(); ++it) {
+		const unsigned int thread_id = *it;
+		std::string thread_name = (thread_id == 0) ? "main" : ("worker " + std::to_string(thread_id));
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread_id
+			<< ",\"args\":{\"name\":\"" << thread_name << "\"}}," << std::endl;
+	}
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"EngineCC\"}}" << std::endl;
+	file << "]}" << std::endl;
+
+	std::cout << m_events.size() << " zones of trace written in " << m_filename << std::endl;
+	return true;
+}
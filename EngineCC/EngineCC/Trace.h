@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "Singleton.h"
+
+// Comment this line to compile out all the trace zones
+#define ENGINECC_TRACE
+
+/// Timeline capture of the engine
+// Records nested zones with their start time, duration and thread, and writes them as a
+// Chrome trace-event JSON file that can be opened in chrome://tracing or in Perfetto.
+// A capture covers a given number of frames, it is written once the last frame has ended.
+// It can start with the program (EngineCC --trace <file.json> [num_frames]) to see the loading,
+// or at any time with F3.
+class Tracer {
+public:
+	using Clock = std::chrono::high_resolution_clock;
+
+	// Records a zone from its construction to its destruction if a capture is running
+	// The name must outlive the capture (e.g. a string literal)
+	class ScopedZone {
+	public:
+		ScopedZone(const char* name);
+		~ScopedZone();
+
+	private:
+		const char* m_name;
+		bool m_recording;
+		Clock::time_point m_start;
+	};
+
+	Tracer();
+	~Tracer();
+
+	// Start recording the zones of the next num_frames frames
+	void startCapture(const std::string& filename, unsigned int num_frames);
+	bool isCapturing() const;
+
+	// Count the frames of the capture and write it after the last one
+	void endFrame();
+
+	void addZone(const char* name, const Clock::time_point& start, const Clock::time_point& end);
+
+	// Small id of the calling thread. The main thread is the first one asking for it
+	static unsigned int getThreadId();
+
+private:
+	bool write() const;
+
+private:
+	struct Event {
+		const char* name;
+		// Microseconds since the start of the capture
+		double start_us;
+		double duration_us;
+		unsigned int thread_id;
+	};
+
+	// Zones can be recorded by other threads than the main one, the mutex is only taken to record them
+	mutable std::mutex m_mutex;
+	std::vector<Event> m_events;
+
+	std::string m_filename;
+	unsigned int m_num_frames_left;
+	// Written under the mutex, read without it by every zone
+	std::atomic<bool> m_capturing;
+	Clock::time_point m_start_capture;
+};
+
+#ifdef ENGINECC_TRACE
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+// Record the end of the enclosing scope as a zone called name in the timeline
+#define TRACE_SCOPE(name) Tracer::ScopedZone TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_END_FRAME() Singleton<Tracer>::getInstance().endFrame()
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_END_FRAME()
+#endif
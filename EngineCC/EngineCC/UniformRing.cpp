@@ -0,0 +1,177 @@
+#include <cstring>
+#include <algorithm>
+
+#include "UniformRing.h"
+#include "Trace.h"
+
+namespace {
+	// Enough for a few thousands draws per frame before growing
+	const GLsizeiptr initial_region_size = 1 << 20;
+	// Timeout of one wait on a fence, in nanoseconds
+	const GLuint64 fence_timeout = 1000000;
+}
+
+/// UniformRing definitions
+UniformRing& UniformRing::getInstance() {
+	static UniformRing ring(initial_region_size);
+	return ring;
+}
+
+UniformRing::UniformRing(GLsizeiptr region_size) : m_buffer(0),
+												   m_data(nullptr),
+												   m_region_size(0),
+												   m_alignment(256),
+												   m_region(0),
+												   m_offset(0),
+												   m_object_bound(false),
+												   m_bones(nullptr),
+												   m_num_bones(0) {
+	m_frame_uniforms.view = glm::mat4(1.f);
+	m_frame_uniforms.projection = glm::mat4(1.f);
+
+	// The blocks and the palettes are bound from the same buffer
+	GLint uniform_alignment = 0;
+	GLint storage_alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+	if (uniform_alignment > 0 || storage_alignment > 0)
+		m_alignment = std::max(uniform_alignment, storage_alignment);
+
+	for (unsigned int i = 0; i < UNIFORM_RING_NUM_FRAMES; ++i) {
+		m_fences[i] = nullptr;
+	}
+	create(region_size);
+}
+
+UniformRing::~UniformRing() {
+	// The ring outlives the GL context, its buffer and fences are released with the context
+}
+
+void UniformRing::create(GLsizeiptr region_size) {
+	m_region_size = (region_size + m_alignment - 1) / m_alignment * m_alignment;
+	m_region = 0;
+	m_offset = 0;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, m_region_size * UNIFORM_RING_NUM_FRAMES, NULL, flags);
+	m_data = static_cast<GLubyte*>(glMapNamedBufferRange(m_buffer, 0, m_region_size * UNIFORM_RING_NUM_FRAMES, flags));
+}
+
+void UniformRing::destroy() {
+	for (unsigned int i = 0; i < UNIFORM_RING_NUM_FRAMES; ++i) {
+		if (m_fences[i]) {
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = nullptr;
+		}
+	}
+
+	if (m_buffer != 0) {
+		// The draws already issued keep the storage alive until they are done
+		glUnmapNamedBuffer(m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+		m_data = nullptr;
+	}
+}
+
+void UniformRing::beginFrame() {
+	TRACE_SCOPE("UniformRing::beginFrame");
+	m_offset = 0;
+
+	GLsync& fence = m_fences[m_region];
+	if (!fence)
+		return;
+
+	// The first wait flushes the commands so that the fence is eventually signaled
+	GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (true) {
+		GLenum status = glClientWaitSync(fence, wait_flags, fence_timeout);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED)
+			break;
+		wait_flags = 0;
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void UniformRing::endFrame() {
+	if (m_fences[m_region])
+		glDeleteSync(m_fences[m_region]);
+	m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_region = (m_region + 1) % UNIFORM_RING_NUM_FRAMES;
+}
+
+GLintptr UniformRing::allocate(GLsizeiptr size) {
+	GLintptr offset = (m_offset + m_alignment - 1) / m_alignment * m_alignment;
+	if (offset + size > m_region_size) {
+		// The storage of a persistent buffer is immutable, a new ring twice as large replaces it.
+		// The regions of the new buffer are not used by any draw, their fences are dropped
+		GLsizeiptr region_size = std::max<GLsizeiptr>(2 * m_region_size,
+			4 * m_alignment + sizeof(FrameUniforms) + sizeof(ObjectUniforms) + m_num_bones * 16 * sizeof(GLfloat) + size);
+		destroy();
+		create(region_size);
+
+		// Deleting the buffer unbound all the blocks of the flush in progress, whatever the order they were bound in.
+		// They are all written again so that the next draw reads the same data
+		std::memcpy(m_data, &m_frame_uniforms, sizeof(FrameUniforms));
+		glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, m_buffer, 0, sizeof(FrameUniforms));
+		offset = (sizeof(FrameUniforms) + m_alignment - 1) / m_alignment * m_alignment;
+		if (m_object_bound) {
+			std::memcpy(m_data + offset, &m_object_uniforms, sizeof(ObjectUniforms));
+			glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORMS_BINDING, m_buffer, offset, sizeof(ObjectUniforms));
+			offset = (offset + sizeof(ObjectUniforms) + m_alignment - 1) / m_alignment * m_alignment;
+		}
+		if (m_bones) {
+			const GLsizeiptr bones_size = m_num_bones * 16 * sizeof(GLfloat);
+			std::memcpy(m_data + offset, m_bones, bones_size);
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BONES_STORAGE_BINDING, m_buffer, offset, bones_size);
+			offset = (offset + bones_size + m_alignment - 1) / m_alignment * m_alignment;
+		}
+	}
+
+	m_offset = offset + size;
+	return m_region * m_region_size + offset;
+}
+
+void UniformRing::bindRange(GLuint binding, const void* data, GLsizeiptr size) {
+	GLintptr offset = allocate(size);
+	std::memcpy(m_data + offset, data, size);
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, offset, size);
+}
+
+void UniformRing::bindFrameUniforms(const glm::mat4& view, const glm::mat4& projection) {
+	m_frame_uniforms.view = view;
+	m_frame_uniforms.projection = projection;
+	// A new flush starts, the Object block and the palettes of the previous one are not used anymore
+	m_object_bound = false;
+	m_bones = nullptr;
+	m_num_bones = 0;
+	bindRange(FRAME_UNIFORMS_BINDING, &m_frame_uniforms, sizeof(FrameUniforms));
+}
+
+void UniformRing::bindObjectUniforms(const glm::mat4& model, const glm::vec3& tex_factor, GLint bones_offset) {
+	ObjectUniforms uniforms;
+	uniforms.model = model;
+	uniforms.tex_factor = glm::vec4(tex_factor, 0.f);
+	uniforms.bones_offset = bones_offset;
+	uniforms.padding[0] = uniforms.padding[1] = uniforms.padding[2] = 0;
+	bindRange(OBJECT_UNIFORMS_BINDING, &uniforms, sizeof(ObjectUniforms));
+	// Kept after the allocation, a growth during it must not bind the previous block over this one
+	m_object_uniforms = uniforms;
+	m_object_bound = true;
+}
+
+void UniformRing::bindBones(const GLfloat* bones, GLsizei num_bones) {
+	const GLsizeiptr size = num_bones * 16 * sizeof(GLfloat);
+	GLintptr offset = allocate(size);
+	std::memcpy(m_data + offset, bones, size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BONES_STORAGE_BINDING, m_buffer, offset, size);
+	m_bones = bones;
+	m_num_bones = num_bones;
+}
+
+GLsizeiptr UniformRing::getFrameSize() const {
+	return m_offset;
+}
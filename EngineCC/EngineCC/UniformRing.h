@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Dependencies\glew\glew.h"
+
+// Binding points of the uniform blocks declared by the shaders
+#define FRAME_UNIFORMS_BINDING 0
+#define OBJECT_UNIFORMS_BINDING 1
+// Binding point of the shader storage block of the bones palettes
+#define BONES_STORAGE_BINDING 0
+// Number of frames the CPU can write ahead of the GPU
+#define UNIFORM_RING_NUM_FRAMES 3
+
+/// Ring buffer of the uniform blocks
+// The buffer is created with glBufferStorage and stays mapped (persistent and coherent mapping). It is split in
+// UNIFORM_RING_NUM_FRAMES regions : a frame writes its blocks one after the other in its region and binds them
+// by offset with glBindBufferRange, no data is uploaded by the driver.
+// A fence is inserted once the draws of a frame are issued. The region is only written again when the fence is signaled,
+// so the CPU never overwrites blocks the GPU has not read yet.
+// The blocks of the shaders :
+//   Frame (binding 0) : view and projection matrices, written once per flush of a render queue
+//   Object (binding 1) : model matrix, texcoords factor and bones offset of a non instanced draw
+// and the shader storage block :
+//   Bones (binding 0) : bones palettes of all the animated models drawn by a flush, row major. A draw reads its palette
+//                       from its bones offset, -1 if it is not animated
+class UniformRing {
+public:
+	// std140 layout of the Frame block
+	struct FrameUniforms {
+		glm::mat4 view;
+		glm::mat4 projection;
+	};
+
+	// std140 layout of the Object block
+	struct ObjectUniforms {
+		glm::mat4 model;
+		glm::vec4 tex_factor;
+		GLint bones_offset;
+		GLint padding[3];
+	};
+
+	// The ring is created with the first GL context using it
+	static UniformRing& getInstance();
+
+	// Wait until the GPU has read the region of the frame, UNIFORM_RING_NUM_FRAMES frames ago
+	void beginFrame();
+	// Fence the draws of the frame and move to the next region
+	void endFrame();
+
+	void bindFrameUniforms(const glm::mat4& view, const glm::mat4& projection);
+	void bindObjectUniforms(const glm::mat4& model, const glm::vec3& tex_factor, GLint bones_offset);
+	// Bind num_bones matrices as the Bones storage block, the palettes have no size limit
+	void bindBones(const GLfloat* bones, GLsizei num_bones);
+
+	// Bytes written in the region of the current frame
+	GLsizeiptr getFrameSize() const;
+
+private:
+	UniformRing(GLsizeiptr region_size);
+	~UniformRing();
+
+	void create(GLsizeiptr region_size);
+	void destroy();
+
+	// Reserve size bytes in the region of the frame and return their offset in the buffer.
+	// When the region is full, the ring is created again with larger regions
+	GLintptr allocate(GLsizeiptr size);
+	void bindRange(GLuint binding, const void* data, GLsizeiptr size);
+
+private:
+	GLuint m_buffer;
+	GLubyte* m_data;
+
+	GLsizeiptr m_region_size;
+	// Largest of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+	GLintptr m_alignment;
+
+	unsigned int m_region;
+	// Offset of the next block in the region of the current frame
+	GLintptr m_offset;
+	GLsync m_fences[UNIFORM_RING_NUM_FRAMES];
+
+	// Last Frame and Object blocks bound, written again when the ring grows
+	FrameUniforms m_frame_uniforms;
+	ObjectUniforms m_object_uniforms;
+	bool m_object_bound;
+	// Palettes bound since the Frame block, owned by the render queue being flushed
+	const GLfloat* m_bones;
+	GLsizei m_num_bones;
+};
@@ -0,0 +1,107 @@
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "WorkerPool.h"
+#include "Trace.h"
+
+/// WorkerPool definitions
+WorkerPool::WorkerPool(unsigned int num_threads) : m_stop(false) {
+	for (unsigned int i = 0; i < num_threads; ++i) {
+		m_threads.push_back(std::thread(&WorkerPool::run, this));
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::run() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+			if (m_stop && m_tasks.empty())
+				return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void WorkerPool::submit(const std::function<void()>& task) {
+	if (m_threads.empty()) {
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(task);
+	}
+	m_condition.notify_one();
+}
+
+void WorkerPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& task) {
+	if (count == 0)
+		return;
+	grain = std::max<size_t>(grain, 1);
+	const size_t num_chunks = (count + grain - 1) / grain;
+	if (m_threads.empty() || num_chunks == 1) {
+		task(0, count);
+		return;
+	}
+
+	// The counters are shared with the helper tasks, which may only start once all the chunks are taken
+	struct Job {
+		std::atomic<size_t> next_chunk;
+		std::atomic<size_t> num_done;
+	};
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->next_chunk = 0;
+	job->num_done = 0;
+
+	const std::function<void(size_t, size_t)>* task_ptr = &task;
+	std::function<void()> work = [job, task_ptr, count, grain, num_chunks]() {
+		size_t chunk;
+		while ((chunk = job->next_chunk.fetch_add(1)) < num_chunks) {
+			size_t begin = chunk * grain;
+			(*task_ptr)(begin, std::min(begin + grain, count));
+			job->num_done.fetch_add(1);
+		}
+	};
+
+	size_t num_helpers = std::min<size_t>(m_threads.size(), num_chunks - 1);
+	for (size_t i = 0; i < num_helpers; ++i) {
+		submit(work);
+	}
+	work();
+
+	// The last chunks may still be running on the workers
+	TRACE_SCOPE("WorkerPool::wait");
+	while (job->num_done.load() < num_chunks) {
+		std::this_thread::yield();
+	}
+}
+
+unsigned int WorkerPool::getNumThreads() const {
+	return static_cast<unsigned int>(m_threads.size());
+}
+
+WorkerPool& WorkerPool::getShared() {
+	static WorkerPool pool;
+	return pool;
+}
+
+unsigned int WorkerPool::getDefaultNumThreads() {
+	return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
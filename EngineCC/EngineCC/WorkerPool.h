@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+/// Pool of worker threads
+// The threads are started once and wait for tasks. parallelFor splits a range in chunks that are taken
+// by the workers and by the calling thread, and returns when all the chunks are done.
+class WorkerPool {
+public:
+	// One thread per core, the calling thread works too
+	WorkerPool(unsigned int num_threads = getDefaultNumThreads());
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Run a task on a worker without waiting for it
+	void submit(const std::function<void()>& task);
+
+	// Call task(begin, end) on the chunks of at most grain elements of [0, count)
+	// The task is called concurrently and must only write the elements of its chunk
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& task);
+
+	unsigned int getNumThreads() const;
+	// Number of cores minus the calling thread, at least one
+	static unsigned int getDefaultNumThreads();
+
+	// Pool of the engine, shared by the animations and the asset loader so that the cores are not oversubscribed.
+	// It is created by its first user and destroyed after the static objects created before it returned
+	static WorkerPool& getShared();
+
+private:
+	void run();
+
+private:
+	std::vector<std::thread> m_threads;
+
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stop;
+};
@@ -36,10 +36,8 @@ public:
 			entityx::Entity entity1 = m_entitiesPerCollisionObject[body1];
 			assert(entity0.valid() && entity1.valid());
 			if (isEntityCarried(entity0, entity1) || isEntityCarried(entity1, entity0)) {
-				std::cout << "lkjlkj" << std::endl;
 				return false;
 			}
-			std::cout << "lzz" << std::endl;
 			return btCollisionDispatcher::needsCollision(body0, body1);
 		}
 
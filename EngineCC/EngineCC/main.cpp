@@ -1,8 +1,122 @@
 #include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <limits>
 #include "GameProgram.h"
+#include "Simulation.h"
+#include "Benchmark.h"
+#include "Trace.h"
+#include "SceneGenerator.h"
+#include "InputRecorder.h"
+#include "Profiler.h"
+#include "Texture.h"
+
+namespace {
+	// The whole argument must be a number (as SceneGenerator::Parameters::set), otherwise false is returned
+	bool parseUnsigned(const char* argument, unsigned int& result) {
+		// strtoul skips the spaces and accepts a minus sign
+		if (!std::isdigit(static_cast<unsigned char>(argument[0])))
+			return false;
+		char* end = nullptr;
+		errno = 0;
+		unsigned long number = std::strtoul(argument, &end, 10);
+		if (*end != '\0' || errno == ERANGE || number > std::numeric_limits<unsigned int>::max())
+			return false;
+		result = static_cast<unsigned int>(number);
+		return true;
+	}
+}
 
 int main(int argc, char* argv[]) {
+	// Headless simulation of a scene without any window :
+	// EngineCC --headless <scene.xml> [num_frames] [--quiet]
+	if (argc >= 3 && std::strcmp(argv[1], "--headless") == 0) {
+		unsigned int num_frames = 1000;
+		bool print_frames = true;
+		for (int i = 3; i < argc; ++i) {
+			if (std::strcmp(argv[i], "--quiet") == 0)
+				print_frames = false;
+			else if (!parseUnsigned(argv[i], num_frames)) {
+				std::cout << "Invalid number of frames : " << argv[i] << std::endl;
+				std::cout << "Usage : EngineCC --headless <scene.xml> [num_frames] [--quiet]" << std::endl;
+				return 1;
+			}
+		}
+
+		Simulation simulation;
+		if (!simulation.loadScene(argv[2]))
+			return 1;
+		simulation.run(num_frames, print_frames);
+
+		return 0;
+	}
+
+	// Generation of a stress scene and of its entity files in a directory :
+	// EngineCC --generate-scene <directory> <scene_name> [entities=1000] [dynamic=0.5] [models=0.1] [cubes=0.8] [planes=0.1]
+	//          [distribution=uniform|grid|clustered] [extent=100] [depth=0] [seed=1] [model=Content/sword.obj] [texture=Content/bricks.jpg]
+	if (argc >= 4 && std::strcmp(argv[1], "--generate-scene") == 0) {
+		SceneGenerator::Parameters params;
+		for (int i = 4; i < argc; ++i) {
+			std::string argument = argv[i];
+			std::size_t pos = argument.find("=");
+			if (pos == std::string::npos || !params.set(argument.substr(0, pos), argument.substr(pos + 1))) {
+				std::cout << "Unknown scene parameter : " << argument << std::endl;
+				return 1;
+			}
+		}
+
+		return SceneGenerator::generate(argv[2], argv[3], params) ? 0 : 1;
+	}
+
+	// Micro-benchmarks of the engine kernels :
+	// EngineCC --bench [filter]
+	if (argc >= 2 && std::strcmp(argv[1], "--bench") == 0) {
+		Benchmark benchmark;
+		benchmark.run(argc >= 3 ? argv[2] : "");
+
+		return 0;
+	}
+
+	// Offline bake of the textures in containers mapped at load time (see Texture) :
+	// EngineCC --bake-textures <image> [image...]
+	if (argc >= 3 && std::strcmp(argv[1], "--bake-textures") == 0) {
+		bool baked = true;
+		for (int i = 2; i < argc; ++i) {
+			baked = Texture::bake(argv[i]) && baked;
+		}
+
+		return baked ? 0 : 1;
+	}
+
+	// Capture of the timeline of the first frames, loading included :
+	// EngineCC --trace <trace.json> [num_frames]
+	if (argc >= 3 && std::strcmp(argv[1], "--trace") == 0) {
+		unsigned int num_frames = 300;
+		if (argc >= 4 && !parseUnsigned(argv[3], num_frames)) {
+			std::cout << "Invalid number of frames : " << argv[3] << std::endl;
+			std::cout << "Usage : EngineCC --trace <trace.json> [num_frames]" << std::endl;
+			return 1;
+		}
+		Singleton<Tracer>::getInstance().startCapture(argv[2], num_frames);
+	}
+
+	// Recording of the inputs of a session or replay of a recorded one :
+	// EngineCC --record <inputs.bin> / EngineCC --replay <inputs.bin>
+	// At the end of a replay, the frame times are written in <inputs.bin>.profile.csv
+	if (argc >= 3 && std::strcmp(argv[1], "--record") == 0) {
+		if (!Singleton<InputRecorder>::getInstance().startRecording(argv[2]))
+			return 1;
+	}
+	else if (argc >= 3 && std::strcmp(argv[1], "--replay") == 0) {
+		if (!Singleton<InputRecorder>::getInstance().startReplay(argv[2]))
+			return 1;
+		Singleton<FrameProfiler>::getInstance().keepHistory(true);
+	}
+
 	GameProgram game;
 
 	return 0;
-}
\ No newline at end of file
+}
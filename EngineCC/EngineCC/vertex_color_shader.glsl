@@ -5,16 +5,23 @@ layout(location = 1) in vec4 in_color;
 layout(location = 2) in vec3 in_normal;
 layout(location = 3) in vec3 in_texcoords;
 
-uniform mat4 modelview;
-uniform mat4 model;
-uniform mat4 projection;
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+};
+
+layout(std140) uniform Object {
+	mat4 model;
+	vec4 tex_factor;
+	int bones_offset;
+};
 
 out vec4 vert_color;
 out vec3 vert_texcoords;
 out vec2 frag_coord;
 
 void main() {
-	gl_Position = projection * modelview * vec4(in_position, 1.0f);
+	gl_Position = projection * view * model * vec4(in_position, 1.0f);
 	vert_color = in_color;
 	vert_texcoords = in_texcoords;
 	frag_coord = (model * vec4(in_position, 1)).xz;
@@ -0,0 +1,26 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec4 in_color;
+layout(location = 2) in vec3 in_normal;
+layout(location = 3) in vec3 in_texcoords;
+
+// Per instance attributes
+layout(location = 6) in mat4 in_model;
+
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+};
+
+out vec4 vert_color;
+out vec3 vert_texcoords;
+out vec2 frag_coord;
+
+void main() {
+	vec4 world_position = in_model * vec4(in_position, 1.0f);
+	gl_Position = projection * view * world_position;
+	vert_color = in_color;
+	vert_texcoords = in_texcoords;
+	frag_coord = world_position.xz;
+}
\ No newline at end of file
@@ -5,16 +5,24 @@ layout(location = 1) in vec4 in_color;
 layout(location = 2) in vec3 in_normal;
 layout(location = 3) in vec3 in_texcoords;
 
-uniform mat4 modelview;
-uniform mat4 projection;
-uniform vec3 tex_factor;
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+};
+
+layout(std140) uniform Object {
+	mat4 model;
+	vec4 tex_factor;
+	int bones_offset;
+};
 
 out vec4 vert_color;
 out vec3 vert_texcoords;
 
 void main() {
-	gl_Position = projection * modelview * vec4(in_position, 1.0f);
+	gl_Position = projection * view * model * vec4(in_position, 1.0f);
 
 	vert_color = in_color;
-	vert_texcoords = in_texcoords * tex_factor;
+	// The cube map is sampled in the direction of the vertex from the center of the cube
+	vert_texcoords = in_position * tex_factor.xyz;
 }
\ No newline at end of file
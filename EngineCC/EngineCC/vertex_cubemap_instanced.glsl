@@ -0,0 +1,26 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec4 in_color;
+layout(location = 2) in vec3 in_normal;
+layout(location = 3) in vec3 in_texcoords;
+
+// Per instance attributes
+layout(location = 6) in mat4 in_model;
+layout(location = 10) in vec3 in_tex_factor;
+
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+};
+
+out vec4 vert_color;
+out vec3 vert_texcoords;
+
+void main() {
+	gl_Position = projection * view * in_model * vec4(in_position, 1.0f);
+
+	vert_color = in_color;
+	// The cube map is sampled in the direction of the vertex from the center of the cube
+	vert_texcoords = in_position * in_tex_factor;
+}
\ No newline at end of file
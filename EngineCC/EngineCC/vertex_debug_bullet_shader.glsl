@@ -3,8 +3,10 @@
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec4 in_color;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+};
 
 out vec4 vert_color;
 
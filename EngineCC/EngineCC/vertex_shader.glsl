@@ -7,26 +7,37 @@ layout(location = 3) in vec3 in_texcoords;
 layout(location = 4) in ivec4 in_id;
 layout(location = 5) in vec4 in_weight;
 
-uniform mat4 modelview;
-uniform mat4 projection;
-uniform vec3 tex_factor;
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+};
 
-uniform mat4 bonesTransform[32];
-uniform bool animated;
+layout(std140) uniform Object {
+	mat4 model;
+	vec4 tex_factor;
+	// First bone of the palette of the model, -1 if it is not animated
+	int bones_offset;
+};
+
+// Palettes of all the animated models of the draws, row major as the assimp matrices
+layout(std430, row_major) readonly buffer Bones {
+	mat4 bonesTransform[];
+};
 
 out vec4 vert_color;
 out vec3 vert_texcoords;
 
 void main() {
 	mat4 transform = mat4(1);
-	if(animated) {
-		transform = bonesTransform[in_id[0]] * in_weight[0] + \
-				bonesTransform[in_id[1]] * in_weight[1] + \
-				bonesTransform[in_id[2]] * in_weight[2] + \
-				bonesTransform[in_id[3]] * in_weight[3];
+	if(bones_offset >= 0) {
+		ivec4 bones = in_id + ivec4(bones_offset);
+		transform = bonesTransform[bones[0]] * in_weight[0] + \
+				bonesTransform[bones[1]] * in_weight[1] + \
+				bonesTransform[bones[2]] * in_weight[2] + \
+				bonesTransform[bones[3]] * in_weight[3];
 	}
-	gl_Position = projection * modelview * transform * vec4(in_position, 1.0f);
+	gl_Position = projection * view * model * transform * vec4(in_position, 1.0f);
 
 	vert_color = in_color;
-	vert_texcoords = in_texcoords * tex_factor;
+	vert_texcoords = in_texcoords * tex_factor.xyz;
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 450 core
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec4 in_color;
+layout(location = 2) in vec3 in_normal;
+layout(location = 3) in vec3 in_texcoords;
+layout(location = 4) in ivec4 in_id;
+layout(location = 5) in vec4 in_weight;
+
+// Per instance attributes
+layout(location = 6) in mat4 in_model;
+layout(location = 10) in vec3 in_tex_factor;
+// First bone of the palette of the instance, -1 if it is not animated
+layout(location = 11) in int in_bones_offset;
+
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+};
+
+// Palettes of all the animated models of the draws, row major as the assimp matrices
+layout(std430, row_major) readonly buffer Bones {
+	mat4 bonesTransform[];
+};
+
+out vec4 vert_color;
+out vec3 vert_texcoords;
+
+void main() {
+	mat4 transform = mat4(1);
+	if(in_bones_offset >= 0) {
+		ivec4 bones = in_id + ivec4(in_bones_offset);
+		transform = bonesTransform[bones[0]] * in_weight[0] + \
+				bonesTransform[bones[1]] * in_weight[1] + \
+				bonesTransform[bones[2]] * in_weight[2] + \
+				bonesTransform[bones[3]] * in_weight[3];
+	}
+	gl_Position = projection * view * in_model * transform * vec4(in_position, 1.0f);
+
+	vert_color = in_color;
+	vert_texcoords = in_texcoords * in_tex_factor;
+}
\ No newline at end of file